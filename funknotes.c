@@ -4,61 +4,928 @@
  * For path do export PATH="$PATH:/path/to/funknotes" the compiled binary
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <ctype.h>
+#include <regex.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include <termios.h>
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
 #include <time.h>
 #include <unistd.h>
 #include <dirent.h>
 
+#ifdef __APPLE__
+#define ST_MTIM(st) ((st).st_mtimespec)
+#else
+#define ST_MTIM(st) ((st).st_mtim)
+#endif
+
 #define MAX_PATH 512
 #define MAX_TEXT 1024
-#define MAX_LINE 2048
+#define MAX_LINE 4096     // room for an item= record with escaped text
 
 typedef struct {
     char home_dir[MAX_PATH];
     char config_file[MAX_PATH];
     char projects_dir[MAX_PATH];
+    char socket_file[MAX_PATH];
 } Config;
 
+/* Point in time: epoch seconds plus the UTC offset that was in effect where it
+ * was recorded, so display can reproduce the original wall-clock time. */
+typedef struct {
+    int64_t epoch;
+    int32_t tz_offset;  // seconds east of UTC
+} Timestamp;
+
+/* Half-open time filter [since, until) used by show/search */
+typedef struct {
+    int64_t since;
+    int64_t until;
+} TimeRange;
+
 // Data structures for project data
 typedef struct Item {
-    char timestamp[64];
+    Timestamp ts;
+    uint64_t hash;      // content hash of the normalized text (see text_hash)
+    uint32_t id;        // stable per-project id, assigned at add time
     char text[MAX_TEXT];
     struct Item *next;
 } Item;
 
 typedef struct HistoryEntry {
     char action[32];
-    char timestamp[64];
+    Timestamp ts;
+    uint32_t id;        // the item the entry is about; 0 in files from before it was kept
     char text[MAX_TEXT];
     struct HistoryEntry *next;
 } HistoryEntry;
 
+/* Replayed history state: the ADD entries (by ordinal) still live after the
+ * first `pos` history entries. Stored every CHECKPOINT_INTERVAL entries. */
+typedef struct Checkpoint {
+    int pos;            // history entries covered, oldest first
+    int adds;           // ADD entries among them
+    Timestamp ts;       // timestamp of the last covered entry
+    int *live;          // live ADD ordinals, ascending
+    int count, cap;
+    char *ranges;       // loaded live= text, expanded into `live` on first use
+    size_t ranges_len;
+    struct Checkpoint *next;  // newest first
+} Checkpoint;
+
+/* Activity rollup of an object, kept current by every mutation and saved in
+ * the header (rollup= lines) so stats never walk the history. Day and week
+ * buckets are counted back from the newest change: [0] is `day` (local day
+ * number) and the week containing it. */
+#define ROLLUP_DAYS 7
+#define ROLLUP_WEEKS 8
+
+typedef struct {
+    int valid;          // loaded from the header or rebuilt from history
+    uint32_t adds, deletes, edits;
+    uint64_t chars;     // text bytes of the live items
+    int64_t first;      // epoch of the oldest counted change (0 = none)
+    int32_t day;
+    uint32_t day_adds[ROLLUP_DAYS], day_deletes[ROLLUP_DAYS];
+    uint32_t week_adds[ROLLUP_WEEKS], week_deletes[ROLLUP_WEEKS];
+} Rollup;
+
+/* Tag postings of an object: for each #tag or @person (stored lowercased
+ * with its sigil) the ids of the items that carry it */
+#define MAX_TAG 64
+
+typedef struct {
+    char tag[MAX_TAG + 1];
+    uint32_t *ids;          // ascending unless merges renumbered out of order
+    int count, cap;
+} TagPosting;
+
+typedef struct TagIndex {
+    TagPosting *postings;   // sorted by tag
+    int count, cap;
+    int changed;            // postings differ from the header they were loaded from
+} TagIndex;
+
 typedef struct Object {
     char name[MAX_TEXT];
     Item *items;
     HistoryEntry *history;
+    int unordered;      // set by the loader if item timestamps are not ascending
+    struct HashSet *hashes;  // item content hashes, built on first use
+    int shard_id;       // directory layout: object file <shard_id>.txt (0 = not yet assigned)
+    int dirty;          // directory layout: object file must be rewritten on save
+    int stub;           // directory layout: listed in the manifest but not loaded
+    Checkpoint *checkpoints;  // history replay checkpoints, newest first
+    struct TermStats *terms;  // ranked search term statistics, built on first use
+    int item_count;     // from the header summary; live for stubs only
+    Timestamp modified; // last mutation, persisted in the header summary
+    Rollup rollup;      // activity counts, persisted in the header
+    TagIndex *tags;     // tag postings, persisted in the header (NULL = not built)
+    int retain_items;   // retention: keep only the newest N items hot (0 = no count limit)
+    int retain_days;    // retention: keep only the last N days hot (0 = no age limit)
+    int cold;           // items moved to the project's cold tier, persisted in the header
+    Item **by_id;       // items sorted by id, built on first lookup
+    int by_id_count;
     struct Object *next;
 } Object;
 
+#define FILTER_BITS 4096
+#define FILTER_SHIFT 12     // log2(FILTER_BITS)
+#define FILTER_HEX (FILTER_BITS / 4)
+
 typedef struct Project {
     char name[MAX_TEXT];
     int index;
+    int next_shard;     // directory layout: next object file id
+    int has_summary;    // header carried objects=/summary= lines
+    uint32_t next_id;   // next item id
+    int has_filter;     // header carried a filter= line (or one was built)
+    int pinned;         // batch: resident until the batch ends; free_project() leaves it
+    int pending;        // batch: saved by a command, written when the batch ends
+    int damaged;        // the loader met a crc= line that did not match its records
+    int cold_folded;    // the cold tier was read back in; the next save rewrites it
+    struct Object *cold_stubs;  // folded: cold sections of objects this load left as stubs
+    uint8_t filter[FILTER_BITS / 8];  // trigram bitmap of item text, see project_may_match
+    struct JournalEntry *journal;  // appended records read by the loader, oldest first
+    int journal_count;  // records in journal
+    int loaded_items;   // items in the non-stub objects once the journal was replayed
     Object *objects;
 } Project;
 
+/* A record appended after the object sections instead of rewriting the
+ * file: tombstone=<id>|<ts> deletes an item, update=<id>|<ts>|<text>
+ * replaces its text. Applied to the loaded items by id. */
+typedef struct JournalEntry {
+    int tombstone;
+    uint32_t id;
+    Timestamp ts;
+    char text[MAX_TEXT];
+    struct JournalEntry *next;
+} JournalEntry;
+
+// ===== Content Hashing ===== //
+
+/* 64-bit FNV-1a of the text after normalization: ASCII lowercased, runs of
+ * whitespace collapsed to one space, leading/trailing whitespace ignored.
+ * Two notes that differ only in case or spacing hash the same. */
+uint64_t text_hash(const char *text) {
+    uint64_t h = 1469598103934665603ULL;
+    const unsigned char *p = (const unsigned char *)text;
+    while (*p && isspace(*p)) p++;
+    int pending_space = 0;
+    for (; *p; p++) {
+        if (isspace(*p)) { pending_space = 1; continue; }
+        if (pending_space) {
+            h ^= ' ';
+            h *= 1099511628211ULL;
+            pending_space = 0;
+        }
+        h ^= (unsigned char)tolower(*p);
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;  // 0 marks an empty slot in HashSet
+}
+
+/* Open-addressing multiset of content hashes (counts allow duplicates that
+ * were added with dedupe off, so deleting one copy keeps the others). */
+typedef struct HashSet {
+    uint64_t *keys;
+    uint32_t *counts;
+    size_t cap;     // power of two
+    size_t len;     // distinct keys
+} HashSet;
+
+static size_t hashset_slot(const HashSet *set, uint64_t key) {
+    size_t mask = set->cap - 1;
+    size_t i = (size_t)(key ^ (key >> 29)) & mask;
+    while (set->keys[i] && set->keys[i] != key) i = (i + 1) & mask;
+    return i;
+}
+
+static int hashset_grow(HashSet *set) {
+    size_t cap = set->cap ? set->cap * 2 : 64;
+    uint64_t *keys = calloc(cap, sizeof(uint64_t));
+    uint32_t *counts = calloc(cap, sizeof(uint32_t));
+    if (!keys || !counts) { free(keys); free(counts); return 0; }
+    HashSet next = { keys, counts, cap, set->len };
+    for (size_t i = 0; i < set->cap; i++) {
+        if (!set->keys[i]) continue;
+        size_t j = hashset_slot(&next, set->keys[i]);
+        keys[j] = set->keys[i];
+        counts[j] = set->counts[i];
+    }
+    free(set->keys);
+    free(set->counts);
+    *set = next;
+    return 1;
+}
+
+int hashset_contains(const HashSet *set, uint64_t key) {
+    if (!set || !set->cap) return 0;
+    return set->keys[hashset_slot(set, key)] == key;
+}
+
+void hashset_add(HashSet *set, uint64_t key) {
+    if ((set->len + 1) * 4 > set->cap * 3 && !hashset_grow(set)) return;
+    size_t i = hashset_slot(set, key);
+    if (!set->keys[i]) { set->keys[i] = key; set->len++; }
+    set->counts[i]++;
+}
+
+/* Drop one occurrence of key. Removing the last copy re-inserts the rest of
+ * its probe cluster so lookups never stop at the hole. */
+void hashset_remove(HashSet *set, uint64_t key) {
+    if (!set || !set->cap) return;
+    size_t mask = set->cap - 1;
+    size_t i = hashset_slot(set, key);
+    if (set->keys[i] != key) return;
+    if (--set->counts[i] > 0) return;
+    set->keys[i] = 0;
+    set->len--;
+    for (size_t j = (i + 1) & mask; set->keys[j]; j = (j + 1) & mask) {
+        uint64_t k = set->keys[j];
+        uint32_t c = set->counts[j];
+        set->keys[j] = 0;
+        set->counts[j] = 0;
+        size_t to = hashset_slot(set, k);
+        set->keys[to] = k;
+        set->counts[to] = c;
+    }
+}
+
+void hashset_free(HashSet *set) {
+    if (!set) return;
+    free(set->keys);
+    free(set->counts);
+    free(set);
+}
+
+/* Copies of key in the set (0 if absent) */
+uint32_t hashset_count(const HashSet *set, uint64_t key) {
+    if (!set || !set->cap) return 0;
+    size_t i = hashset_slot(set, key);
+    return set->keys[i] == key ? set->counts[i] : 0;
+}
+
+/* Term statistics for ranked search: document frequency per word hash (a
+ * HashSet multiset), plus item and word totals. Like the content hash set,
+ * built on first use and kept current by the item mutators. */
+typedef struct TermStats {
+    HashSet df;
+    long docs;
+    long words;
+} TermStats;
+
+#define MAX_ITEM_TERMS (MAX_TEXT / 2)
+#define IS_WORD_CHAR(c) (isalnum(c) || (c) >= 0x80)
+
+/* Hash each word of text (alphanumeric/UTF-8 run, ASCII lowercased) into
+ * out[]. Returns the number of words, at most max. */
+int text_terms(const char *text, uint64_t *out, int max) {
+    int n = 0;
+    const unsigned char *p = (const unsigned char *)text;
+    while (*p && n < max) {
+        while (*p && !IS_WORD_CHAR(*p)) p++;
+        if (!*p) break;
+        uint64_t h = 1469598103934665603ULL;
+        for (; *p && IS_WORD_CHAR(*p); p++) {
+            h ^= (uint64_t)tolower(*p);
+            h *= 1099511628211ULL;
+        }
+        out[n++] = h ? h : 1;
+    }
+    return n;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Count an item's text into (sign > 0) or out of (sign < 0) the stats */
+void termstats_update(TermStats *ts, const char *text, int sign) {
+    if (!ts) return;
+    uint64_t terms[MAX_ITEM_TERMS];
+    int n = text_terms(text, terms, MAX_ITEM_TERMS);
+    qsort(terms, n, sizeof(uint64_t), cmp_u64);
+    for (int i = 0; i < n; i++) {
+        if (i > 0 && terms[i] == terms[i-1]) continue;
+        if (sign > 0) hashset_add(&ts->df, terms[i]);
+        else hashset_remove(&ts->df, terms[i]);
+    }
+    ts->docs += sign > 0 ? 1 : -1;
+    ts->words += sign > 0 ? n : -n;
+}
+
+void termstats_free(TermStats *ts) {
+    if (!ts) return;
+    free(ts->df.keys);
+    free(ts->df.counts);
+    free(ts);
+}
+
+// ===== Checksums ===== //
+// CRC32C (Castagnoli) over each object section and each journal append. A
+// crc=<8 hex> line closes the records it covers: everything since the
+// section's [object NAME] line, the previous crc= line, or the first of a
+// run of journal records, blank lines excluded. Headers (and manifests) of
+// files written this way carry checksums=crc32c, so fsck can tell a section
+// that lost its crc= line from one written before checksums existed. The
+// SSE4.2 / ARMv8 crc32c instruction is used when the CPU has it, a
+// slicing-by-8 table otherwise.
+
+static uint32_t crc32c_table[8][256];
+static int crc32c_hw = -1;  // -1 = not yet probed
+
+static void crc32c_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c >> 1) ^ (0x82F63B78u & (0u - (c & 1)));
+        crc32c_table[0][i] = c;
+    }
+    for (int t = 1; t < 8; t++) {
+        for (int i = 0; i < 256; i++) {
+            uint32_t c = crc32c_table[t - 1][i];
+            crc32c_table[t][i] = (c >> 8) ^ crc32c_table[0][c & 0xff];
+        }
+    }
+#if defined(__x86_64__) && defined(__GNUC__)
+    crc32c_hw = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    crc32c_hw = 1;
+#else
+    crc32c_hw = 0;
+#endif
+}
+
+static uint32_t crc32c_sw(uint32_t c, const unsigned char *p, size_t n) {
+    while (n && ((uintptr_t)p & 7)) { c = (c >> 8) ^ crc32c_table[0][(c ^ *p++) & 0xff]; n--; }
+    while (n >= 8) {
+        uint32_t lo = c ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+        c = crc32c_table[7][lo & 0xff] ^ crc32c_table[6][(lo >> 8) & 0xff] ^
+            crc32c_table[5][(lo >> 16) & 0xff] ^ crc32c_table[4][lo >> 24] ^
+            crc32c_table[3][p[4]] ^ crc32c_table[2][p[5]] ^ crc32c_table[1][p[6]] ^ crc32c_table[0][p[7]];
+        p += 8;
+        n -= 8;
+    }
+    while (n--) c = (c >> 8) ^ crc32c_table[0][(c ^ *p++) & 0xff];
+    return c;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw_update(uint32_t c, const unsigned char *p, size_t n) {
+    uint64_t c64 = c;
+    while (n && ((uintptr_t)p & 7)) { c64 = __builtin_ia32_crc32qi((uint32_t)c64, *p++); n--; }
+    while (n >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c64 = __builtin_ia32_crc32di(c64, v);
+        p += 8;
+        n -= 8;
+    }
+    while (n--) c64 = __builtin_ia32_crc32qi((uint32_t)c64, *p++);
+    return (uint32_t)c64;
+}
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+static uint32_t crc32c_hw_update(uint32_t c, const unsigned char *p, size_t n) {
+    while (n && ((uintptr_t)p & 7)) { c = __crc32cb(c, *p++); n--; }
+    while (n >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = __crc32cd(c, v);
+        p += 8;
+        n -= 8;
+    }
+    while (n--) c = __crc32cb(c, *p++);
+    return c;
+}
+#else
+static uint32_t crc32c_hw_update(uint32_t c, const unsigned char *p, size_t n) {
+    return crc32c_sw(c, p, n);
+}
+#endif
+
+/* Extend a CRC32C (start from 0) with len bytes */
+uint32_t crc32c(uint32_t crc, const void *data, size_t len) {
+    if (crc32c_hw < 0) crc32c_init();
+    uint32_t c = ~crc;
+    c = crc32c_hw ? crc32c_hw_update(c, data, len) : crc32c_sw(c, data, len);
+    return ~c;
+}
+
+/* Is this line (without its newline) a journal record? */
+static int is_journal_line(const char *line) {
+    return strncmp(line, "tombstone=", 10) == 0 || strncmp(line, "update=", 7) == 0;
+}
+
+// ===== Text Escaping ===== //
+// Item, history and journal text follows the '|' that ends a record's fields
+// as-is unless it holds a newline. Such text is stored with \\ and \n
+// escapes and flagged by a '\' right before that '|', where the generated
+// fields never put one, so files from before escaping read unchanged and
+// plain text costs one memchr() on save and a memcpy() on load.
+
+/* Longest escaped form of a text buffer's contents */
+#define MAX_ESCAPED (2 * (MAX_TEXT - 1))
+
+static inline int text_needs_escape(const char *text, size_t len) {
+    return memchr(text, '\n', len) != NULL;
+}
+
+/* Escape text (NUL-terminated, len bytes) into out, MAX_ESCAPED + 1 bytes;
+ * returns the escaped length */
+static size_t escape_text(const char *text, size_t len, char *out) {
+    const char *end = text + len;
+    size_t n = 0;
+    while (text < end) {
+        size_t run = strcspn(text, "\\\n");
+        memcpy(out + n, text, run);
+        n += run;
+        text += run;
+        if (text >= end) break;
+        out[n++] = '\\';
+        out[n++] = *text++ == '\n' ? 'n' : '\\';
+    }
+    out[n] = '\0';
+    return n;
+}
+
+/* Undo escape_text() on len bytes of src into out (cap bytes, cut to fit);
+ * returns the text length */
+static size_t unescape_text(const char *src, size_t len, char *out, size_t cap) {
+    const char *end = src + len;
+    size_t n = 0;
+    while (src < end) {
+        const char *bs = memchr(src, '\\', (size_t)(end - src));
+        size_t run = (size_t)((bs ? bs : end) - src);
+        if (run > cap - 1 - n) run = cap - 1 - n;
+        memcpy(out + n, src, run);
+        n += run;
+        if (!bs || n == cap - 1) break;
+        // \n is a newline, any other escaped byte stands for itself
+        src = bs + 1;
+        if (src == end) {
+            out[n++] = '\\';
+            break;
+        }
+        out[n++] = *src == 'n' ? '\n' : *src;
+        src++;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+/* Copy the text after sep (the record ends at end) into out, MAX_TEXT bytes,
+ * unescaping it if the '\' flag precedes sep; returns the text length */
+static size_t read_text_field(const char *sep, const char *end, char *out) {
+    size_t len = (size_t)(end - sep - 1);
+    if (sep[-1] == '\\') return unescape_text(sep + 1, len, out, MAX_TEXT);
+    if (len > MAX_TEXT - 1) len = MAX_TEXT - 1;
+    memcpy(out, sep + 1, len);
+    out[len] = '\0';
+    return len;
+}
+
+/* For snprintf() writers: the flag to print before text's '|' ("" or "\\"),
+ * pointing *text at its escaped copy in buf (MAX_ESCAPED + 1 bytes) if needed */
+static const char *text_flag(const char **text, char *buf) {
+    size_t len = strlen(*text);
+    if (!text_needs_escape(*text, len)) return "";
+    escape_text(*text, len, buf);
+    *text = buf;
+    return "\\";
+}
+
+// ===== Project Writer ===== //
+// Saves format records by hand into a 64 KB buffer (digits converted
+// directly, text copied by length) and pass it on in block-sized fwrite()s,
+// so even compressed streams see whole blocks. A checksummed run's CRC is
+// folded in per block too, not per line.
+
+#define WRITER_BUF (64 * 1024)
+
+typedef struct {
+    FILE *f;
+    size_t len;
+    size_t crc_from;    // buffered bytes not yet folded into crc
+    uint32_t crc;
+    int crc_on;         // inside a checksummed run
+    int ok;
+    char buf[WRITER_BUF];
+} Writer;
+
+static void writer_init(Writer *w, FILE *f) {
+    w->f = f;
+    w->len = w->crc_from = 0;
+    w->crc = 0;
+    w->crc_on = 0;
+    w->ok = 1;
+}
+
+static void writer_flush(Writer *w) {
+    if (w->crc_on) w->crc = crc32c(w->crc, w->buf + w->crc_from, w->len - w->crc_from);
+    if (w->len && fwrite(w->buf, 1, w->len, w->f) != w->len) w->ok = 0;
+    w->len = w->crc_from = 0;
+}
+
+/* Flush what is left; returns 0 if any write failed */
+static int writer_finish(Writer *w) {
+    writer_flush(w);
+    return w->ok;
+}
+
+static void w_bytes(Writer *w, const char *s, size_t n) {
+    if (n > WRITER_BUF - w->len) {
+        writer_flush(w);
+        if (n > WRITER_BUF) {
+            if (w->crc_on) w->crc = crc32c(w->crc, s, n);
+            if (fwrite(s, 1, n, w->f) != n) w->ok = 0;
+            return;
+        }
+    }
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+}
+
+static inline void w_str(Writer *w, const char *s) {
+    w_bytes(w, s, strlen(s));
+}
+
+static inline void w_char(Writer *w, char c) {
+    if (w->len == WRITER_BUF) writer_flush(w);
+    w->buf[w->len++] = c;
+}
+
+/* '|' and the text after it, flagged and escaped if it holds a newline */
+static void w_text(Writer *w, const char *text) {
+    size_t len = strlen(text);
+    if (!text_needs_escape(text, len)) {
+        w_char(w, '|');
+        w_bytes(w, text, len);
+        return;
+    }
+    char esc[MAX_ESCAPED + 1];
+    w_bytes(w, "\\|", 2);
+    w_bytes(w, esc, escape_text(text, len, esc));
+}
+
+/* Decimal digits of v into dst (at least 21 bytes); returns the length */
+static size_t format_int(char *dst, long long v) {
+    char tmp[24];
+    int i = sizeof(tmp);
+    unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    do { tmp[--i] = (char)('0' + u % 10); u /= 10; } while (u);
+    if (v < 0) tmp[--i] = '-';
+    memcpy(dst, tmp + i, sizeof(tmp) - i);
+    return sizeof(tmp) - i;
+}
+
+static void w_int(Writer *w, long long v) {
+    char tmp[24];
+    w_bytes(w, tmp, format_int(tmp, v));
+}
+
+/* `digits` lowercase hex digits of v, zero-padded */
+static void w_hex(Writer *w, uint64_t v, int digits) {
+    static const char hex[] = "0123456789abcdef";
+    char tmp[16];
+    for (int i = digits - 1; i >= 0; i--) {
+        tmp[i] = hex[v & 15];
+        v >>= 4;
+    }
+    w_bytes(w, tmp, (size_t)digits);
+}
+
+/* A timestamp as write_timestamp_field() formats it: <epoch>±HHMM */
+static void w_timestamp(Writer *w, const Timestamp *ts) {
+    int32_t off = ts->tz_offset;
+    char zone[5] = {'+'};
+    if (off < 0) { zone[0] = '-'; off = -off; }
+    int h = off / 3600, m = (off % 3600) / 60;
+    w_int(w, ts->epoch);
+    if (h > 99) {
+        // Never written by us; keep printf's wider field
+        char tmp[16];
+        w_bytes(w, tmp, (size_t)snprintf(tmp, sizeof(tmp), "%c%02d%02d", zone[0], h, m));
+        return;
+    }
+    zone[1] = (char)('0' + h / 10);
+    zone[2] = (char)('0' + h % 10);
+    zone[3] = (char)('0' + m / 10);
+    zone[4] = (char)('0' + m % 10);
+    w_bytes(w, zone, 5);
+}
+
+/* Start a checksummed run of records */
+static void w_crc_begin(Writer *w) {
+    w->crc = 0;
+    w->crc_from = w->len;
+    w->crc_on = 1;
+}
+
+/* Close the run with its crc= line */
+static void w_crc_end(Writer *w) {
+    w->crc = crc32c(w->crc, w->buf + w->crc_from, w->len - w->crc_from);
+    w->crc_on = 0;
+    w_bytes(w, "crc=", 4);
+    w_hex(w, w->crc, 8);
+    w_char(w, '\n');
+}
+
+// ===== Trigram Filter ===== //
+// Every project header carries a bitmap of the lowercased trigrams in its
+// item text (filter=<hex>), so search --all can rule a project out before
+// parsing it. Partial writes only ever add bits; a full save rebuilds the
+// map, which drops those of deleted items.
+
+static unsigned trigram_bit(const unsigned char *p) {
+    uint32_t t = (uint32_t)tolower(p[0]) | (uint32_t)tolower(p[1]) << 8 | (uint32_t)tolower(p[2]) << 16;
+    return (t * 2654435761u) >> (32 - FILTER_SHIFT);
+}
+
+static void filter_add_text(uint8_t *filter, const char *text) {
+    const unsigned char *p = (const unsigned char *)text;
+    for (; p[0] && p[1] && p[2]; p++) {
+        unsigned bit = trigram_bit(p);
+        filter[bit >> 3] |= (uint8_t)(1u << (bit & 7));
+    }
+}
+
+/* Could some item contain `needle` (case-insensitively)? Needles shorter
+ * than a trigram always might. */
+static int filter_may_contain(const uint8_t *filter, const char *needle) {
+    const unsigned char *p = (const unsigned char *)needle;
+    for (; p[0] && p[1] && p[2]; p++) {
+        unsigned bit = trigram_bit(p);
+        if (!(filter[bit >> 3] & (1u << (bit & 7)))) return 0;
+    }
+    return 1;
+}
+
+/* Bring proj->filter up to date before a save. With every object loaded the
+ * map is rebuilt; a partial load can only add the text it holds, and only to
+ * a map read from disk (otherwise none is written). */
+static void update_project_filter(Project *proj) {
+    int partial = 0;
+    for (Object *obj = proj->objects; obj; obj = obj->next) partial |= obj->stub;
+    if (partial && !proj->has_filter) return;
+    if (!partial) memset(proj->filter, 0, sizeof(proj->filter));
+    for (Object *obj = proj->objects; obj; obj = obj->next) {
+        for (Item *item = obj->items; item; item = item->next) filter_add_text(proj->filter, item->text);
+    }
+    proj->has_filter = 1;
+}
+
+static void format_filter(const Project *proj, char *hex) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < FILTER_BITS / 8; i++) {
+        hex[2*i] = digits[proj->filter[i] >> 4];
+        hex[2*i + 1] = digits[proj->filter[i] & 15];
+    }
+    hex[FILTER_HEX] = '\0';
+}
+
+static void write_filter(Writer *w, const Project *proj) {
+    if (!proj->has_filter) return;
+    char hex[FILTER_HEX + 1];
+    format_filter(proj, hex);
+    w_bytes(w, "filter=", 7);
+    w_bytes(w, hex, FILTER_HEX);
+    w_char(w, '\n');
+}
+
+/* Parse a filter= value; anything malformed leaves the project unfiltered */
+static void parse_filter(Project *proj, const char *value) {
+    if (strlen(value) != FILTER_HEX) return;
+    for (int i = 0; i < FILTER_HEX; i++) {
+        int c = tolower((unsigned char)value[i]);
+        int v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (v < 0) return;
+        if (i % 2 == 0) proj->filter[i / 2] = (uint8_t)(v << 4);
+        else proj->filter[i / 2] |= (uint8_t)v;
+    }
+    proj->has_filter = 1;
+}
+
 // ===== Helper Functions ===== //
 // ============================ //
 
-/* Get current timestamp as string */
-void get_timestamp(char *buf, size_t size) {
+static int g_batch_active = 0;    // inside funknotes batch: projects stay resident, saves are deferred
+static int g_assume_yes = 0;      // batch --yes: confirmations answer themselves
+static int g_command_failed = 0;  // set by print_error(); batch checks it after each command
+
+/* printf for messages that mean the command failed */
+__attribute__((format(printf, 1, 2)))
+void print_error(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    g_command_failed = 1;
+}
+
+static int g_in_daemon = 0;
+
+/* Can a confirmation be asked (or, under batch --yes, assumed)? Commands
+ * run by funknotesd never ask, so no client's prompt holds up the rest. */
+int can_confirm(void) {
+    return g_assume_yes || (!g_in_daemon && isatty(STDIN_FILENO));
+}
+
+/* Read the answer to a y/N (default_yes = 0) or Y/n question just printed */
+int read_answer(int default_yes) {
+    if (g_assume_yes) {
+        printf("y\n");
+        return 1;
+    }
+    char resp[8];
+    if (!fgets(resp, sizeof(resp), stdin)) return default_yes;
+    if (resp[0] == 'y' || resp[0] == 'Y') return 1;
+    if (resp[0] == 'n' || resp[0] == 'N') return 0;
+    return default_yes;
+}
+
+/* Get current time with the local UTC offset */
+void get_timestamp(Timestamp *ts) {
+    time_t now = time(NULL);
+    struct tm t;
+    localtime_r(&now, &t);
+    ts->epoch = (int64_t)now;
+    ts->tz_offset = (int32_t)t.tm_gmtoff;
+}
+
+/* Format timestamp for display as YYYY-MM-DD HH:MM:SS in its recorded zone */
+void format_timestamp(const Timestamp *ts, char *buf, size_t size) {
+    time_t shifted = (time_t)(ts->epoch + ts->tz_offset);
+    struct tm t;
+    gmtime_r(&shifted, &t);
+    strftime(buf, size, "%Y-%m-%d %H:%M:%S", &t);
+}
+
+/* Serialize timestamp for the project file: <epoch>+HHMM (or -HHMM) */
+void write_timestamp_field(const Timestamp *ts, char *buf, size_t size) {
+    int32_t off = ts->tz_offset;
+    char sign = '+';
+    if (off < 0) { sign = '-'; off = -off; }
+    snprintf(buf, size, "%lld%c%02d%02d", (long long)ts->epoch, sign,
+             (int)(off / 3600), (int)((off % 3600) / 60));
+}
+
+/* Convert a local-time broken-down date to a Timestamp (uses system zone rules) */
+static int local_tm_to_timestamp(struct tm *t, Timestamp *ts) {
+    t->tm_isdst = -1;
+    time_t when = mktime(t);
+    if (when == (time_t)-1) return 0;
+    struct tm check;
+    localtime_r(&when, &check);
+    ts->epoch = (int64_t)when;
+    ts->tz_offset = (int32_t)check.tm_gmtoff;
+    return 1;
+}
+
+/* Parse a timestamp field from a project file. Accepts the current
+ * <epoch>+HHMM form and the legacy "YYYY-MM-DD HH:MM:SS" local-time form.
+ * Returns 1 on success, 0 if the field is malformed.
+ */
+int parse_timestamp_field(const char *s, Timestamp *ts) {
+    if (strlen(s) >= 19 && s[4] == '-' && s[7] == '-' && s[10] == ' ') {
+        struct tm t;
+        memset(&t, 0, sizeof(t));
+        if (sscanf(s, "%d-%d-%d %d:%d:%d", &t.tm_year, &t.tm_mon, &t.tm_mday,
+                   &t.tm_hour, &t.tm_min, &t.tm_sec) != 6) return 0;
+        t.tm_year -= 1900;
+        t.tm_mon -= 1;
+        return local_tm_to_timestamp(&t, ts);
+    }
+
+    char *end;
+    long long epoch = strtoll(s, &end, 10);
+    if (end == s) return 0;
+    ts->epoch = (int64_t)epoch;
+    ts->tz_offset = 0;
+    if ((*end == '+' || *end == '-') && strlen(end) >= 5) {
+        int hh = (end[1] - '0') * 10 + (end[2] - '0');
+        int mm = (end[3] - '0') * 10 + (end[4] - '0');
+        ts->tz_offset = (hh * 3600 + mm * 60) * (*end == '-' ? -1 : 1);
+    }
+    return 1;
+}
+
+/* Parse a user-supplied time bound for --since/--until. Accepted forms:
+ *   YYYY-MM-DD, "YYYY-MM-DD HH:MM[:SS]", YYYY-MM-DDTHH:MM[:SS] (local time)
+ *   @<epoch>, today, yesterday, and relative ages like 30m, 12h, 3d, 2w.
+ * For --until a date without a time means the end of that day.
+ * Returns 1 on success and stores epoch seconds in *out.
+ */
+int parse_time_arg(const char *s, int is_until, int64_t *out) {
+    if (s[0] == '@') {
+        char *end;
+        long long v = strtoll(s + 1, &end, 10);
+        if (end == s + 1 || *end) return 0;
+        *out = (int64_t)v;
+        return 1;
+    }
+
     time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    strftime(buf, size, "%Y-%m-%d %H:%M:%S", t);
+    if (strcmp(s, "today") == 0 || strcmp(s, "yesterday") == 0) {
+        struct tm t;
+        localtime_r(&now, &t);
+        t.tm_hour = t.tm_min = t.tm_sec = 0;
+        if (strcmp(s, "yesterday") == 0) t.tm_mday -= 1;
+        if (is_until) t.tm_mday += 1;
+        Timestamp ts;
+        if (!local_tm_to_timestamp(&t, &ts)) return 0;
+        *out = ts.epoch;
+        return 1;
+    }
+
+    // Relative age: <n><unit>
+    char *end;
+    long n = strtol(s, &end, 10);
+    if (end != s && end[0] && !end[1] && n >= 0) {
+        int64_t unit = 0;
+        switch (end[0]) {
+            case 'm': unit = 60; break;
+            case 'h': unit = 3600; break;
+            case 'd': unit = 86400; break;
+            case 'w': unit = 7 * 86400; break;
+        }
+        if (unit) {
+            *out = (int64_t)now - (int64_t)n * unit;
+            return 1;
+        }
+    }
+
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    int parsed = sscanf(s, "%d-%d-%d%*1[ T]%d:%d:%d", &t.tm_year, &t.tm_mon, &t.tm_mday,
+                        &t.tm_hour, &t.tm_min, &t.tm_sec);
+    if (parsed != 3 && parsed < 5) return 0;
+    t.tm_year -= 1900;
+    t.tm_mon -= 1;
+    if (parsed == 3 && is_until) t.tm_mday += 1;
+    Timestamp ts;
+    if (!local_tm_to_timestamp(&t, &ts)) return 0;
+    *out = ts.epoch;
+    return 1;
+}
+
+/* Reset a time range to match everything */
+void time_range_all(TimeRange *range) {
+    range->since = INT64_MIN;
+    range->until = INT64_MAX;
+}
+
+/* Strip --since/--until <time> options from argv in place.
+ * Returns 1 on success (argc updated), 0 if an option value is missing or invalid.
+ */
+int extract_time_range(int *argc, char **argv, TimeRange *range) {
+    time_range_all(range);
+    int out = 0;
+    for (int i = 0; i < *argc; i++) {
+        int is_since = strcmp(argv[i], "--since") == 0;
+        int is_until = strcmp(argv[i], "--until") == 0;
+        if (!is_since && !is_until) {
+            argv[out++] = argv[i];
+            continue;
+        }
+        if (i + 1 >= *argc) {
+            printf("Missing value for %s\n", argv[i]);
+            return 0;
+        }
+        int64_t v;
+        if (!parse_time_arg(argv[i + 1], is_until, &v)) {
+            print_error("Invalid time '%s' (use YYYY-MM-DD[ HH:MM[:SS]], @epoch, today, yesterday or 3d/12h/30m/2w)\n", argv[i + 1]);
+            return 0;
+        }
+        if (is_since) range->since = v; else range->until = v;
+        i++;
+    }
+    *argc = out;
+    argv[out] = NULL;
+    return 1;
 }
 
 /* Read from stdin if available */
@@ -77,6 +944,12 @@ char* read_stdin() {
     }
     buffer[len] = '\0';
 
+    // Nothing piped in (e.g. stdin is /dev/null): let callers use their arguments
+    if (len == 0) {
+        free(buffer);
+        return NULL;
+    }
+
     // Trim trailing newline
     if (len > 0 && buffer[len-1] == '\n') {
         buffer[len-1] = '\0';
@@ -85,12 +958,19 @@ char* read_stdin() {
     return buffer;
 }
 
-/* Initialize configuration paths */
-void init_config(Config *cfg) {
-    const char *home = getenv("HOME");
-    snprintf(cfg->home_dir, MAX_PATH, "%s/.funknotes", home);
+/* Point cfg at a funknotes directory (~/.funknotes, or another home's) */
+void config_paths(Config *cfg, const char *home_dir) {
+    snprintf(cfg->home_dir, MAX_PATH, "%s", home_dir);
     snprintf(cfg->config_file, MAX_PATH, "%s/config.txt", cfg->home_dir);
     snprintf(cfg->projects_dir, MAX_PATH, "%s/projects", cfg->home_dir);
+    snprintf(cfg->socket_file, MAX_PATH, "%s/funknotesd.sock", cfg->home_dir);
+}
+
+/* Initialize configuration paths */
+void init_config(Config *cfg) {
+    char home_dir[MAX_PATH];
+    snprintf(home_dir, MAX_PATH, "%s/.funknotes", getenv("HOME"));
+    config_paths(cfg, home_dir);
     
     mkdir(cfg->home_dir, 0755);
     mkdir(cfg->projects_dir, 0755);
@@ -152,1378 +1032,8339 @@ void save_config_data(Config *cfg, int primary_project, int project_counter) {
     }
 }
 
-// ===== Project File I/O Functions ===== //
+// ===== Compression ===== //
+// Archived projects (<index>_<name>.fnz) are the normal text format run
+// through a small built-in LZ77 codec in independent 64 KiB blocks:
+//   "FNZ1" then per block: u32 raw_len, u32 stored_len, data
+// (stored_len == raw_len means the block is stored uncompressed), ending
+// with raw_len == 0. Blocks are exposed as a FILE* stream so the line
+// parser and the writer don't know whether a file is compressed.
+//
+// Block encoding is a sequence of: token byte (high nibble literal count,
+// low nibble match length - 4; 15 means "more length bytes follow", each
+// adding up to 255), the literals, then a 16-bit little-endian match offset
+// and any extra match length bytes. The final sequence has literals only.
+
+#define FNZ_MAGIC "FNZ1"
+#define FNZ_BLOCK 65536
+#define FNZ_BOUND(n) ((n) + (n) / 255 + 16)
+#define LZ_HASH_BITS 13
+#define LZ_MIN_MATCH 4
+
+static uint32_t read_u32le(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
 
-/* Free project memory */
-void free_project(Project *proj) {
-    if (!proj) return;
-    Object *obj = proj->objects;
-    while (obj) {
-        Object *next_obj = obj->next;
-        Item *item = obj->items;
-        while (item) {
-            Item *next_item = item->next;
-            free(item);
-            item = next_item;
+static void write_u32le(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static uint8_t *lz_put_length(uint8_t *op, size_t len) {
+    while (len >= 255) { *op++ = 255; len -= 255; }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+/* Compress n bytes into dst (capacity FNZ_BOUND(n)). Returns the encoded size. */
+size_t lz_compress(const uint8_t *src, size_t n, uint8_t *dst) {
+    int32_t table[1 << LZ_HASH_BITS];
+    memset(table, 0xff, sizeof(table));
+    uint8_t *op = dst;
+    size_t ip = 0, anchor = 0;
+
+    // Leave the last bytes as literals so match extension never overruns
+    while (n >= 12 && ip + 12 <= n) {
+        uint32_t seq = read_u32le(src + ip);
+        uint32_t h = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+        int32_t ref = table[h];
+        table[h] = (int32_t)ip;
+        if (ref < 0 || ip - (size_t)ref > 65535 || read_u32le(src + ref) != seq) {
+            ip++;
+            continue;
         }
-        HistoryEntry *hist = obj->history;
-        while (hist) {
-            HistoryEntry *next_hist = hist->next;
-            free(hist);
-            hist = next_hist;
+
+        size_t mlen = LZ_MIN_MATCH;
+        while (ip + mlen < n - 5 && src[ref + mlen] == src[ip + mlen]) mlen++;
+
+        size_t lit = ip - anchor;
+        size_t ml = mlen - LZ_MIN_MATCH;
+        *op++ = (uint8_t)(((lit < 15 ? lit : 15) << 4) | (ml < 15 ? ml : 15));
+        if (lit >= 15) op = lz_put_length(op, lit - 15);
+        memcpy(op, src + anchor, lit);
+        op += lit;
+        size_t off = ip - (size_t)ref;
+        *op++ = (uint8_t)off;
+        *op++ = (uint8_t)(off >> 8);
+        if (ml >= 15) op = lz_put_length(op, ml - 15);
+
+        ip += mlen;
+        anchor = ip;
+    }
+
+    size_t lit = n - anchor;
+    *op++ = (uint8_t)((lit < 15 ? lit : 15) << 4);
+    if (lit >= 15) op = lz_put_length(op, lit - 15);
+    memcpy(op, src + anchor, lit);
+    op += lit;
+    return (size_t)(op - dst);
+}
+
+/* Decompress into dst (capacity cap). Returns the decoded size or -1 if the
+ * input is malformed. */
+long lz_decompress(const uint8_t *src, size_t n, uint8_t *dst, size_t cap) {
+    const uint8_t *ip = src, *end = src + n;
+    uint8_t *op = dst, *oend = dst + cap;
+
+    while (ip < end) {
+        uint8_t token = *ip++;
+        size_t lit = token >> 4;
+        if (lit == 15) {
+            uint8_t b;
+            do {
+                if (ip >= end) return -1;
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
         }
-        free(obj);
-        obj = next_obj;
+        if ((size_t)(end - ip) < lit || (size_t)(oend - op) < lit) return -1;
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+        if (ip == end) break;
+
+        if (end - ip < 2) return -1;
+        size_t off = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        size_t mlen = (token & 15);
+        if (mlen == 15) {
+            uint8_t b;
+            do {
+                if (ip >= end) return -1;
+                b = *ip++;
+                mlen += b;
+            } while (b == 255);
+        }
+        mlen += LZ_MIN_MATCH;
+        if (off == 0 || off > (size_t)(op - dst) || (size_t)(oend - op) < mlen) return -1;
+        const uint8_t *ref = op - off;
+        if (off >= mlen) {
+            memcpy(op, ref, mlen);
+        } else {
+            // Overlapping match repeats the preceding bytes
+            for (size_t i = 0; i < mlen; i++) op[i] = ref[i];
+        }
+        op += mlen;
     }
-    free(proj);
+    return (long)(op - dst);
 }
 
-/* Load project from text file */
-Project* load_project_file(const char *filename) {
-    FILE *f = fopen(filename, "r");
-    if (!f) return NULL;
-    
-    Project *proj = calloc(1, sizeof(Project));
-    if (!proj) { fclose(f); return NULL; }
-    
-    proj->index = -1;
-    Object *current_obj = NULL;
-    char line[MAX_LINE];
-    
-    while (fgets(line, sizeof(line), f)) {
-        // Remove newline
-        size_t len = strlen(line);
-        if (len > 0 && line[len-1] == '\n') line[len-1] = '\0';
-        
-        // Skip empty lines
-        if (line[0] == '\0') continue;
-        
-        // Check for object section header
-        if (line[0] == '[' && strncmp(line, "[object ", 8) == 0) {
-            char *obj_name_start = line + 8;
-            char *obj_name_end = strchr(obj_name_start, ']');
-            if (obj_name_end) {
-                *obj_name_end = '\0';
-                
-                // Create new object
-                Object *obj = calloc(1, sizeof(Object));
-                strncpy(obj->name, obj_name_start, MAX_TEXT - 1);
-                obj->name[MAX_TEXT - 1] = '\0';
-                obj->next = proj->objects;
-                proj->objects = obj;
-                current_obj = obj;
+typedef struct {
+    FILE *f;
+    uint8_t *raw;
+    uint8_t *packed;
+    size_t raw_len;
+    size_t raw_pos;
+    int done;
+} FnzStream;
+
+static ssize_t fnz_read(void *cookie, char *buf, size_t size) {
+    FnzStream *z = cookie;
+    size_t copied = 0;
+    while (copied < size) {
+        if (z->raw_pos == z->raw_len) {
+            if (z->done) break;
+            uint8_t hdr[8];
+            if (fread(hdr, 1, 8, z->f) != 8) { z->done = 1; break; }
+            uint32_t raw_len = read_u32le(hdr), stored = read_u32le(hdr + 4);
+            if (raw_len == 0) { z->done = 1; break; }
+            if (raw_len > FNZ_BLOCK || stored > raw_len || fread(z->packed, 1, stored, z->f) != stored) {
+                z->done = 1;
+                return copied ? (ssize_t)copied : -1;
             }
-            continue;
+            if (stored == raw_len) {
+                memcpy(z->raw, z->packed, raw_len);
+            } else if (lz_decompress(z->packed, stored, z->raw, raw_len) != (long)raw_len) {
+                z->done = 1;
+                return copied ? (ssize_t)copied : -1;
+            }
+            z->raw_len = raw_len;
+            z->raw_pos = 0;
         }
-        
-        // Parse key=value lines
+        size_t take = z->raw_len - z->raw_pos;
+        if (take > size - copied) take = size - copied;
+        memcpy(buf + copied, z->raw + z->raw_pos, take);
+        z->raw_pos += take;
+        copied += take;
+    }
+    return (ssize_t)copied;
+}
+
+static int fnz_flush_block(FnzStream *z) {
+    if (z->raw_len == 0) return 1;
+    size_t stored = lz_compress(z->raw, z->raw_len, z->packed);
+    const uint8_t *data = z->packed;
+    if (stored >= z->raw_len) { stored = z->raw_len; data = z->raw; }
+    uint8_t hdr[8];
+    write_u32le(hdr, (uint32_t)z->raw_len);
+    write_u32le(hdr + 4, (uint32_t)stored);
+    z->raw_len = 0;
+    return fwrite(hdr, 1, 8, z->f) == 8 && fwrite(data, 1, stored, z->f) == stored;
+}
+
+static ssize_t fnz_write(void *cookie, const char *buf, size_t size) {
+    FnzStream *z = cookie;
+    size_t done = 0;
+    while (done < size) {
+        size_t take = FNZ_BLOCK - z->raw_len;
+        if (take > size - done) take = size - done;
+        memcpy(z->raw + z->raw_len, buf + done, take);
+        z->raw_len += take;
+        done += take;
+        if (z->raw_len == FNZ_BLOCK && !fnz_flush_block(z)) return -1;
+    }
+    return (ssize_t)size;
+}
+
+static int fnz_close(void *cookie) {
+    FnzStream *z = cookie;
+    int ok = 1;
+    if (z->done == 2) {  // writer: last partial block plus terminator
+        uint8_t end[8] = { 0 };
+        ok = fnz_flush_block(z) && fwrite(end, 1, 8, z->f) == 8;
+    }
+    if (fclose(z->f) != 0) ok = 0;
+    free(z->raw);
+    free(z->packed);
+    free(z);
+    return ok ? 0 : -1;
+}
+
+#ifdef __APPLE__
+static int fnz_read_bsd(void *c, char *b, int n) { return (int)fnz_read(c, b, (size_t)n); }
+static int fnz_write_bsd(void *c, const char *b, int n) { return (int)fnz_write(c, b, (size_t)n); }
+#endif
+
+/* Wrap an open file (positioned after the magic for reading) in a
+ * compressing or decompressing stream. Takes ownership of f. */
+static FILE *fnz_open(FILE *f, int writing) {
+    FnzStream *z = calloc(1, sizeof(FnzStream));
+    if (z) {
+        z->raw = malloc(FNZ_BLOCK);
+        z->packed = malloc(FNZ_BOUND(FNZ_BLOCK));
+    }
+    if (!z || !z->raw || !z->packed) {
+        if (z) { free(z->raw); free(z->packed); free(z); }
+        fclose(f);
+        return NULL;
+    }
+    z->f = f;
+    z->done = writing ? 2 : 0;
+#ifdef __APPLE__
+    FILE *stream = funopen(z, writing ? NULL : fnz_read_bsd, writing ? fnz_write_bsd : NULL, NULL, fnz_close);
+#else
+    cookie_io_functions_t io = { writing ? NULL : fnz_read, writing ? fnz_write : NULL, NULL, fnz_close };
+    FILE *stream = fopencookie(z, writing ? "w" : "r", io);
+#endif
+    if (!stream) {
+        fnz_close(z);
+        return NULL;
+    }
+    setvbuf(stream, NULL, _IOFBF, FNZ_BLOCK);
+    return stream;
+}
+
+/* Does the path name a compressed (archived) project file? */
+int is_compressed_path(const char *path) {
+    size_t len = strlen(path);
+    return len > 4 && strcmp(path + len - 4, ".fnz") == 0;
+}
+
+/* Is a directory entry a project file (plain .txt or archived .fnz)?
+ * Dotfiles are temporaries and never count. */
+int is_project_filename(const char *name) {
+    size_t len = strlen(name);
+    return len > 4 && name[0] != '.' && (strcmp(name + len - 4, ".txt") == 0 || strcmp(name + len - 4, ".fnz") == 0);
+}
+
+/* Size of a file in bytes, or -1 */
+static long file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+/* Wait out a journal append that is still patching the file; the shared
+ * lock lasts until f is closed (see journal_append) */
+static void lock_for_read(FILE *f) {
+    while (flock(fileno(f), LOCK_SH) != 0 && errno == EINTR) {}
+}
+
+/* Open a project file for reading, transparently decompressing archives */
+FILE *open_project_read(const char *filename) {
+    FILE *f = fopen(filename, "rb");
+    if (!f) return NULL;
+    lock_for_read(f);
+    char magic[4];
+    if (fread(magic, 1, 4, f) == 4 && memcmp(magic, FNZ_MAGIC, 4) == 0) {
+        return fnz_open(f, 0);
+    }
+    rewind(f);
+    return f;
+}
+
+/* Open a project file for writing; .fnz paths are written compressed */
+FILE *open_project_write(const char *filename) {
+    FILE *f = fopen(filename, "wb");
+    if (!f || !is_compressed_path(filename)) return f;
+    if (fwrite(FNZ_MAGIC, 1, 4, f) != 4) { fclose(f); return NULL; }
+    return fnz_open(f, 1);
+}
+
+/* Read a whole project file into memory, decompressing archives */
+static char* read_project_bytes(const char *path, size_t *len) {
+    *len = 0;
+    FILE *f = open_project_read(path);
+    if (!f) return NULL;
+    size_t cap = 1 << 16;
+    char *buf = malloc(cap);
+    size_t n;
+    while (buf && (n = fread(buf + *len, 1, cap - *len, f)) > 0) {
+        *len += n;
+        if (*len == cap) {
+            char *grown = realloc(buf, cap * 2);
+            if (!grown) { free(buf); buf = NULL; break; }
+            buf = grown;
+            cap *= 2;
+        }
+    }
+    fclose(f);
+    return buf;
+}
+
+// ===== Buffered Output ===== //
+// Listings (show, search, projects) format items straight into one large
+// buffer that goes out with a single write() per flush, instead of a printf
+// and strftime per item. A closed pipe (`| head`) marks the buffer broken
+// and the listing loops stop early.
+
+#define OUT_BUF_SIZE (64 * 1024)
+
+typedef struct {
+    char buf[OUT_BUF_SIZE];
+    size_t len;
+    int broken;         // write failed (EPIPE); further output is dropped
+    uint64_t written;   // bytes handed to write() since out_begin()
+    int64_t day;        // date of the last formatted timestamp, cached
+    char date[16];
+} OutBuffer;
+
+static OutBuffer g_out = { .day = INT64_MIN };
+
+/* Start a buffered listing; earlier printf output is flushed first so the
+ * two streams stay in order. SIGPIPE is ignored so a closed pipe shows up
+ * as EPIPE instead of killing the process (or the daemon). */
+void out_begin(void) {
+    signal(SIGPIPE, SIG_IGN);
+    fflush(stdout);
+    g_out.len = 0;
+    g_out.broken = 0;
+    g_out.written = 0;
+}
+
+/* Write out the buffer. Returns 0 once the consumer has gone away. */
+int out_flush(void) {
+    size_t off = 0;
+    while (off < g_out.len && !g_out.broken) {
+        ssize_t n = write(STDOUT_FILENO, g_out.buf + off, g_out.len - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) g_out.broken = 1;
+        else off += (size_t)n;
+    }
+    g_out.written += off;
+    g_out.len = 0;
+    return !g_out.broken;
+}
+
+static inline int out_ok(void) {
+    return !g_out.broken;
+}
+
+void out_bytes(const char *s, size_t n) {
+    if (g_out.len + n > OUT_BUF_SIZE) {
+        out_flush();
+        if (n > OUT_BUF_SIZE) {
+            // Larger than the buffer: write through
+            size_t saved = g_out.len;
+            while (n > 0 && !g_out.broken) {
+                size_t chunk = n < OUT_BUF_SIZE ? n : OUT_BUF_SIZE;
+                memcpy(g_out.buf, s, chunk);
+                g_out.len = chunk;
+                out_flush();
+                s += chunk;
+                n -= chunk;
+            }
+            g_out.len = saved;
+            return;
+        }
+    }
+    memcpy(g_out.buf + g_out.len, s, n);
+    g_out.len += n;
+}
+
+static inline void out_str(const char *s) {
+    out_bytes(s, strlen(s));
+}
+
+static inline void out_char(char c) {
+    if (g_out.len == OUT_BUF_SIZE) out_flush();
+    g_out.buf[g_out.len++] = c;
+}
+
+void out_int(long long v) {
+    char tmp[24];
+    int i = sizeof(tmp);
+    unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    do { tmp[--i] = (char)('0' + u % 10); u /= 10; } while (u);
+    if (v < 0) tmp[--i] = '-';
+    out_bytes(tmp + i, sizeof(tmp) - i);
+}
+
+/* Days since 1970-01-01 to a proleptic Gregorian date (H. Hinnant's
+ * civil_from_days) */
+static void civil_from_days(int64_t z, int *year, int *month, int *day) {
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned)(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    *day = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *year = (int)(yoe + era * 400 + (*month <= 2));
+}
+
+static inline void put2(char *p, int v) {
+    p[0] = (char)('0' + v / 10);
+    p[1] = (char)('0' + v % 10);
+}
+
+/* Same text as format_timestamp() ("YYYY-MM-DD HH:MM:SS", in the recorded
+ * offset) without gmtime/strftime; the date part is cached per day. */
+void out_timestamp(const Timestamp *ts) {
+    int64_t shifted = ts->epoch + ts->tz_offset;
+    int64_t day = shifted >= 0 ? shifted / 86400 : -((-shifted + 86399) / 86400);
+    int secs = (int)(shifted - day * 86400);
+    if (day != g_out.day) {
+        int y, m, d;
+        civil_from_days(day, &y, &m, &d);
+        snprintf(g_out.date, sizeof(g_out.date), "%04d-%02d-%02d ", y, m, d);
+        g_out.day = day;
+    }
+    char clock[8];
+    put2(clock, secs / 3600);
+    clock[2] = ':';
+    put2(clock + 3, secs / 60 % 60);
+    clock[5] = ':';
+    put2(clock + 6, secs % 60);
+    out_str(g_out.date);
+    out_bytes(clock, 8);
+}
+
+// ===== Project File I/O Functions ===== //
+
+/* Free a list of checkpoints */
+void free_checkpoints(Checkpoint *cp) {
+    while (cp) {
+        Checkpoint *next = cp->next;
+        free(cp->live);
+        free(cp->ranges);
+        free(cp);
+        cp = next;
+    }
+}
+
+static void tags_free(TagIndex *idx);
+
+/* Free a list of objects with their items and history */
+void free_project_objects(Object *obj) {
+    while (obj) {
+        Object *next_obj = obj->next;
+        Item *item = obj->items;
+        while (item) {
+            Item *next_item = item->next;
+            free(item);
+            item = next_item;
+        }
+        HistoryEntry *hist = obj->history;
+        while (hist) {
+            HistoryEntry *next_hist = hist->next;
+            free(hist);
+            hist = next_hist;
+        }
+        hashset_free(obj->hashes);
+        termstats_free(obj->terms);
+        tags_free(obj->tags);
+        free_checkpoints(obj->checkpoints);
+        free(obj->by_id);
+        free(obj);
+        obj = next_obj;
+    }
+}
+
+/* Free project memory (batch-resident projects are freed when the batch ends) */
+void free_project(Project *proj) {
+    if (!proj || proj->pinned) return;
+    free_project_objects(proj->objects);
+    free_project_objects(proj->cold_stubs);
+    while (proj->journal) {
+        JournalEntry *next = proj->journal->next;
+        free(proj->journal);
+        proj->journal = next;
+    }
+    free(proj);
+}
+
+/* Record a mutation: the object must be written and its summary updated.
+ * The id lookup array is rebuilt on the next lookup. */
+void touch_object(Object *obj) {
+    obj->dirty = 1;
+    get_timestamp(&obj->modified);
+    free(obj->by_id);
+    obj->by_id = NULL;
+}
+
+// ===== Activity Rollups ===== //
+// The commands that add, delete, edit or merge items also count the change
+// into the object's rollup, which is saved as a fixed-width rollup= line
+// after its summary. `stats` therefore reads only headers, and a journal
+// append patches the line in place like the summary. Objects from files
+// written before rollups are counted once from their history.
+
+enum { ROLLUP_ADD, ROLLUP_DELETE, ROLLUP_EDIT };
+
+/* "%010u|%010u|%010u|%012llu|%011lld|%06d|" then day and week buckets as
+ * "%07u:%07u" pairs separated by commas */
+#define ROLLUP_FIELDS_LEN (65 + (ROLLUP_DAYS + ROLLUP_WEEKS) * 16 - 1)
+#define ROLLUP_BUCKET_MAX 9999999u
+
+/* Local day number of ts: days since 1970-01-01 on its own wall clock */
+static int32_t local_day(const Timestamp *ts) {
+    int64_t t = ts->epoch + ts->tz_offset;
+    return t > 0 ? (int32_t)(t / 86400) : 0;
+}
+
+/* Week number of a day, weeks starting on Monday (day 0 was a Thursday) */
+static int32_t day_week(int32_t day) {
+    return (day + 3) / 7;
+}
+
+/* Move r's buckets forward so [0] is `day`; buckets that fall out of the
+ * window are dropped. Earlier days leave r as it is. */
+static void rollup_advance(Rollup *r, int32_t day) {
+    if (day <= r->day) return;
+    int64_t shift = (int64_t)day - r->day;
+    for (int i = ROLLUP_DAYS - 1; i >= 0; i--) {
+        r->day_adds[i] = i >= shift ? r->day_adds[i - shift] : 0;
+        r->day_deletes[i] = i >= shift ? r->day_deletes[i - shift] : 0;
+    }
+    shift = (int64_t)day_week(day) - day_week(r->day);
+    for (int i = ROLLUP_WEEKS - 1; i >= 0; i--) {
+        r->week_adds[i] = i >= shift ? r->week_adds[i - shift] : 0;
+        r->week_deletes[i] = i >= shift ? r->week_deletes[i - shift] : 0;
+    }
+    r->day = day;
+}
+
+/* Count one change made at ts */
+static void rollup_count(Rollup *r, const Timestamp *ts, int action) {
+    if (!r->first || ts->epoch < r->first) r->first = ts->epoch;
+    if (action == ROLLUP_EDIT) {
+        r->edits++;
+        return;
+    }
+    int32_t day = local_day(ts);
+    rollup_advance(r, day);
+    int adds = action == ROLLUP_ADD;
+    if (adds) r->adds++;
+    else r->deletes++;
+    int64_t i = (int64_t)r->day - day;
+    if (i < ROLLUP_DAYS) {
+        r->day_adds[i] += adds;
+        r->day_deletes[i] += !adds;
+    }
+    i = (int64_t)day_week(r->day) - day_week(day);
+    if (i < ROLLUP_WEEKS) {
+        r->week_adds[i] += adds;
+        r->week_deletes[i] += !adds;
+    }
+}
+
+/* Fold src's counts (live text included) into dst, aligning the buckets */
+void rollup_merge(Rollup *dst, const Rollup *src) {
+    dst->adds += src->adds;
+    dst->deletes += src->deletes;
+    dst->edits += src->edits;
+    dst->chars += src->chars;
+    if (src->first && (!dst->first || src->first < dst->first)) dst->first = src->first;
+    rollup_advance(dst, src->day);
+    for (int i = 0; i < ROLLUP_DAYS; i++) {
+        int64_t k = (int64_t)dst->day - src->day + i;
+        if (k >= ROLLUP_DAYS) break;
+        dst->day_adds[k] += src->day_adds[i];
+        dst->day_deletes[k] += src->day_deletes[i];
+    }
+    for (int i = 0; i < ROLLUP_WEEKS; i++) {
+        int64_t k = (int64_t)day_week(dst->day) - day_week(src->day) + i;
+        if (k >= ROLLUP_WEEKS) break;
+        dst->week_adds[k] += src->week_adds[i];
+        dst->week_deletes[k] += src->week_deletes[i];
+    }
+}
+
+/* An item was added to obj */
+void rollup_added(Object *obj, const Item *item) {
+    rollup_count(&obj->rollup, &item->ts, ROLLUP_ADD);
+    obj->rollup.chars += strlen(item->text);
+}
+
+/* An item with `text` was deleted from obj at ts */
+void rollup_deleted(Object *obj, const char *text, const Timestamp *ts) {
+    rollup_count(&obj->rollup, ts, ROLLUP_DELETE);
+    size_t len = strlen(text);
+    obj->rollup.chars -= len < obj->rollup.chars ? len : obj->rollup.chars;
+}
+
+/* An item's text is about to change from old_text to new_text */
+void rollup_edited(Object *obj, const char *old_text, const char *new_text, const Timestamp *ts) {
+    rollup_count(&obj->rollup, ts, ROLLUP_EDIT);
+    size_t old_len = strlen(old_text), new_len = strnlen(new_text, MAX_TEXT - 1);
+    obj->rollup.chars += new_len;
+    obj->rollup.chars -= old_len < obj->rollup.chars ? old_len : obj->rollup.chars;
+}
+
+/* Count obj's rollup from its history and items, for objects loaded from
+ * files without one. Edits are stored as DELETE_ITEM of the old text
+ * followed by EDIT; that delete is not counted as one. */
+void rollup_rebuild(Object *obj) {
+    Rollup *r = &obj->rollup;
+    memset(r, 0, sizeof(*r));
+    const HistoryEntry *edit = NULL;
+    for (const HistoryEntry *h = obj->history; h; h = h->next) {
+        if (strcmp(h->action, "ADD") == 0) {
+            rollup_count(r, &h->ts, ROLLUP_ADD);
+        } else if (strcmp(h->action, "EDIT") == 0) {
+            rollup_count(r, &h->ts, ROLLUP_EDIT);
+            edit = h;
+            continue;
+        } else if (strcmp(h->action, "DELETE_ITEM") == 0 && !(edit && edit->ts.epoch == h->ts.epoch)) {
+            rollup_count(r, &h->ts, ROLLUP_DELETE);
+        }
+        edit = NULL;
+    }
+    for (const Item *item = obj->items; item; item = item->next) r->chars += strlen(item->text);
+    r->valid = 1;
+}
+
+static void format_rollup_fields(const Rollup *r, char *buf) {
+    unsigned long long chars = r->chars < 999999999999ULL ? r->chars : 999999999999ULL;
+    int day = r->day < 999999 ? r->day : 999999;
+    int n = snprintf(buf, ROLLUP_FIELDS_LEN + 1, "%010u|%010u|%010u|%012llu|%011lld|%06d|",
+                     r->adds, r->deletes, r->edits, chars, (long long)r->first, day);
+    for (int i = 0; i < ROLLUP_DAYS + ROLLUP_WEEKS; i++) {
+        uint32_t adds = i < ROLLUP_DAYS ? r->day_adds[i] : r->week_adds[i - ROLLUP_DAYS];
+        uint32_t deletes = i < ROLLUP_DAYS ? r->day_deletes[i] : r->week_deletes[i - ROLLUP_DAYS];
+        n += snprintf(buf + n, ROLLUP_FIELDS_LEN + 1 - n, "%s%07u:%07u", i ? "," : "",
+                      adds < ROLLUP_BUCKET_MAX ? adds : ROLLUP_BUCKET_MAX,
+                      deletes < ROLLUP_BUCKET_MAX ? deletes : ROLLUP_BUCKET_MAX);
+    }
+}
+
+/* Apply a rollup= line (fields|name) to the object it names */
+static void apply_rollup(Project *proj, const char *value) {
+    if (strlen(value) <= ROLLUP_FIELDS_LEN || value[ROLLUP_FIELDS_LEN] != '|') return;
+    const char *name = value + ROLLUP_FIELDS_LEN + 1;
+    Object *obj = proj->objects;
+    while (obj && strcmp(obj->name, name) != 0) obj = obj->next;
+    if (!obj) return;
+
+    Rollup *r = &obj->rollup;
+    char *p = (char *)value;
+    unsigned long long v[6];
+    for (int i = 0; i < 6; i++) {
+        v[i] = strtoull(p, &p, 10);
+        p++;
+    }
+    r->adds = (uint32_t)v[0];
+    r->deletes = (uint32_t)v[1];
+    r->edits = (uint32_t)v[2];
+    r->chars = v[3];
+    r->first = (int64_t)v[4];
+    r->day = (int32_t)v[5];
+    for (int i = 0; i < ROLLUP_DAYS + ROLLUP_WEEKS; i++) {
+        uint32_t adds = (uint32_t)strtoul(p, &p, 10);
+        uint32_t deletes = (uint32_t)strtoul(p + 1, &p, 10);
+        p++;
+        if (i < ROLLUP_DAYS) {
+            r->day_adds[i] = adds;
+            r->day_deletes[i] = deletes;
+        } else {
+            r->week_adds[i - ROLLUP_DAYS] = adds;
+            r->week_deletes[i - ROLLUP_DAYS] = deletes;
+        }
+    }
+    r->valid = 1;
+}
+
+// ===== Tag Index ===== //
+// #tag and @person words are pulled out of item text when an item is added,
+// imported, merged or edited, and each object keeps the ids of the items
+// carrying every tag. The postings are saved in the header after the
+// object's rollup (tags=<count>|<name>, then tag=<tag>|<id>,<id>...|<name>,
+// at most TAG_LINE_IDS ids a line), so tags and show --tag are answered
+// without reading item text.
+
+#define TAG_LINE_IDS 64
+
+Item** get_items_array(Object *obj, int *count);
+
+static int tag_char(unsigned char c) {
+    return isalnum(c) || c == '_' || c == '-' || c == '/' || c == '.' || c >= 0x80;
+}
+
+/* Find the next #tag or @person at or after *p: the sigil must start a word
+ * and be followed by a letter (so "#12" and "a@b.com" are not tags). Writes
+ * the sigil and the lowercased name to tag and moves *p past it. */
+static int next_tag(const char **p, const char *start, char *tag) {
+    for (const char *s = *p; *s; s++) {
+        if (*s != '#' && *s != '@') continue;
+        unsigned char first = (unsigned char)s[1];
+        if ((s > start && tag_char((unsigned char)s[-1])) || !(isalpha(first) || first == '_' || first >= 0x80)) continue;
+        size_t len = 1;
+        tag[0] = *s;
+        for (const char *c = s + 1; tag_char((unsigned char)*c) && len < MAX_TAG; c++) {
+            tag[len++] = (char)tolower((unsigned char)*c);
+        }
+        while (tag[len - 1] == '-' || tag[len - 1] == '/' || tag[len - 1] == '.') len--;
+        tag[len] = '\0';
+        *p = s + 1;
+        while (tag_char((unsigned char)**p)) (*p)++;
+        return 1;
+    }
+    return 0;
+}
+
+/* The posting for tag (created in sorted position if asked), or NULL */
+static TagPosting* tag_posting(TagIndex *idx, const char *tag, int create) {
+    int lo = 0, hi = idx->count - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        int c = strcmp(idx->postings[mid].tag, tag);
+        if (c == 0) return &idx->postings[mid];
+        if (c < 0) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    if (!create) return NULL;
+    if (idx->count == idx->cap) {
+        int cap = idx->cap ? idx->cap * 2 : 8;
+        TagPosting *grown = realloc(idx->postings, sizeof(TagPosting) * cap);
+        if (!grown) return NULL;
+        idx->postings = grown;
+        idx->cap = cap;
+    }
+    memmove(&idx->postings[lo + 1], &idx->postings[lo], sizeof(TagPosting) * (idx->count - lo));
+    idx->count++;
+    TagPosting *tp = &idx->postings[lo];
+    memset(tp, 0, sizeof(*tp));
+    snprintf(tp->tag, sizeof(tp->tag), "%s", tag);
+    return tp;
+}
+
+static void tag_posting_add(TagPosting *tp, uint32_t id) {
+    if (tp->count && tp->ids[tp->count - 1] == id) return;  // same tag twice in one item
+    if (tp->count == tp->cap) {
+        int cap = tp->cap ? tp->cap * 2 : 4;
+        uint32_t *grown = realloc(tp->ids, sizeof(uint32_t) * cap);
+        if (!grown) return;
+        tp->ids = grown;
+        tp->cap = cap;
+    }
+    tp->ids[tp->count++] = id;
+}
+
+static void tags_free(TagIndex *idx) {
+    if (!idx) return;
+    for (int i = 0; i < idx->count; i++) free(idx->postings[i].ids);
+    free(idx->postings);
+    free(idx);
+}
+
+/* Add (sign > 0) or remove an item's id under every tag in its text. A
+ * no-op until the object's index has been loaded or built. */
+static void tags_update(Object *obj, const char *text, uint32_t id, int sign) {
+    TagIndex *idx = obj->tags;
+    char tag[MAX_TAG + 1];
+    const char *p = text;
+    while (idx && next_tag(&p, text, tag)) {
+        TagPosting *tp = tag_posting(idx, tag, sign > 0);
+        if (!tp) continue;
+        idx->changed = 1;
+        if (sign > 0) {
+            tag_posting_add(tp, id);
+            continue;
+        }
+        for (int i = 0; i < tp->count; i++) {
+            if (tp->ids[i] != id) continue;
+            memmove(&tp->ids[i], &tp->ids[i + 1], sizeof(uint32_t) * (tp->count - i - 1));
+            tp->count--;
+            break;
+        }
+        if (tp->count == 0) {
+            free(tp->ids);
+            int at = (int)(tp - idx->postings);
+            memmove(tp, tp + 1, sizeof(TagPosting) * (idx->count - at - 1));
+            idx->count--;
+        }
+    }
+}
+
+/* Extract the tags of every item of a loaded object */
+static void tags_rebuild(Object *obj) {
+    tags_free(obj->tags);
+    obj->tags = calloc(1, sizeof(TagIndex));
+    if (!obj->tags) return;
+    obj->tags->changed = 1;
+    int count;
+    Item **items = get_items_array(obj, &count);
+    for (int i = 0; i < count; i++) tags_update(obj, items[i]->text, items[i]->id, 1);
+    free(items);
+}
+
+/* The object a tags=/tag= line names: usually the one whose summary= line
+ * came just before, at the head of the list */
+static Object* header_object(Project *proj, const char *name) {
+    Object *obj = proj->objects;
+    while (obj && strcmp(obj->name, name) != 0) obj = obj->next;
+    return obj;
+}
+
+/* Apply a tags= line (count|name): the object's index follows */
+static void apply_tags(Project *proj, const char *value) {
+    const char *pipe = strchr(value, '|');
+    Object *obj = pipe ? header_object(proj, pipe + 1) : NULL;
+    if (!obj) return;
+    tags_free(obj->tags);
+    obj->tags = calloc(1, sizeof(TagIndex));
+}
+
+/* Apply a tag= line (tag|ids|name) to the named object's index */
+static void apply_tag(Project *proj, const char *value) {
+    const char *pipe1 = strchr(value, '|');
+    const char *pipe2 = pipe1 ? strchr(pipe1 + 1, '|') : NULL;
+    if (!pipe2 || pipe1 - value > MAX_TAG) return;
+    Object *obj = header_object(proj, pipe2 + 1);
+    if (!obj || !obj->tags) return;
+    char tag[MAX_TAG + 1];
+    memcpy(tag, value, (size_t)(pipe1 - value));
+    tag[pipe1 - value] = '\0';
+    TagPosting *tp = tag_posting(obj->tags, tag, 1);
+    for (const char *p = pipe1 + 1; tp && p < pipe2; p++) {
+        char *end;
+        unsigned long id = strtoul(p, &end, 10);
+        if (end == p) break;
+        tag_posting_add(tp, (uint32_t)id);
+        p = end;
+    }
+}
+
+// ===== Retention ===== //
+// An object may keep only its newest N items, or only those of the last N
+// days, in the project file (the hot tier). Saves move the rest, with the
+// history from before the oldest item kept, to the project's cold tier (see
+// Cold Tier), which commands read only when --cold asks for it. The policy
+// and the number of cold items are kept in the header after the rollup:
+// retain=<N>i|<cold>|<name> or retain=<N>d|<cold>|<name>.
+
+static int g_cold = 0;  // --cold: loads fold each project's cold tier back in
+
+/* Format an object's retain= value without the name; 0 if it has none */
+static int format_retain_fields(const Object *obj, char *buf, size_t size) {
+    if (!obj->retain_items && !obj->retain_days && !obj->cold) return 0;
+    if (obj->retain_items) return snprintf(buf, size, "%di|%d", obj->retain_items, obj->cold);
+    if (obj->retain_days) return snprintf(buf, size, "%dd|%d", obj->retain_days, obj->cold);
+    return snprintf(buf, size, "0|%d", obj->cold);
+}
+
+/* Apply a retain= line (policy|cold|name) to the named object */
+static void apply_retain(Project *proj, const char *value) {
+    char *end;
+    long n = strtol(value, &end, 10);
+    char unit = *end == 'i' || *end == 'd' ? *end++ : 0;
+    if (*end != '|') return;
+    long cold = strtol(end + 1, &end, 10);
+    Object *obj = *end == '|' ? header_object(proj, end + 1) : NULL;
+    if (!obj) return;
+    obj->retain_items = unit == 'i' ? (int)n : 0;
+    obj->retain_days = unit == 'd' ? (int)n : 0;
+    obj->cold = (int)cold;
+}
+
+// ===== History Replay ===== //
+// An object's state at any time is the ADD entries not yet matched by a
+// DELETE_ITEM. Checkpoints of that state are written with the history every
+// CHECKPOINT_INTERVAL entries, so a point-in-time query replays at most one
+// interval of entries on top of the nearest checkpoint.
+
+#define CHECKPOINT_INTERVAL 128
+
+/* ADD and EDIT (the new text of an edited item) both bring an item to life;
+ * an edit is recorded as DELETE_ITEM of the old text followed by EDIT. */
+static int history_is_add(const HistoryEntry *h) {
+    return strcmp(h->action, "ADD") == 0 || strcmp(h->action, "EDIT") == 0;
+}
+
+/* History entries oldest first. Caller frees. */
+static HistoryEntry** history_array(Object *obj, int *count) {
+    *count = 0;
+    for (HistoryEntry *h = obj->history; h; h = h->next) (*count)++;
+    if (*count == 0) return NULL;
+    HistoryEntry **hists = malloc(sizeof(HistoryEntry*) * (*count));
+    int i = *count;
+    for (HistoryEntry *h = obj->history; h; h = h->next) hists[--i] = h;
+    return hists;
+}
+
+/* ADD/EDIT entries of an oldest-first history array, indexed by ordinal. Caller frees. */
+static HistoryEntry** history_adds(HistoryEntry **hists, int n, int *count) {
+    HistoryEntry **adds = malloc(sizeof(HistoryEntry*) * (n ? n : 1));
+    *count = 0;
+    for (int i = 0; i < n; i++) {
+        if (history_is_add(hists[i])) adds[(*count)++] = hists[i];
+    }
+    return adds;
+}
+
+static void checkpoint_push(Checkpoint *cp, int ordinal) {
+    if (cp->count == cp->cap) {
+        cp->cap = cp->cap ? cp->cap * 2 : 16;
+        cp->live = realloc(cp->live, sizeof(int) * cp->cap);
+    }
+    cp->live[cp->count++] = ordinal;
+}
+
+/* Turn loaded live= ranges ("0-41,43") into the ordinal list */
+static void checkpoint_expand(Checkpoint *cp) {
+    if (!cp->ranges) return;
+    const char *p = cp->ranges;
+    while (*p) {
+        char *end;
+        long a = strtol(p, &end, 10);
+        if (end == p) break;
+        long b = a;
+        if (*end == '-') b = strtol(end + 1, &end, 10);
+        for (long k = a; k <= b; k++) checkpoint_push(cp, (int)k);
+        p = *end == ',' ? end + 1 : end;
+    }
+    free(cp->ranges);
+    cp->ranges = NULL;
+    cp->ranges_len = 0;
+}
+
+static Checkpoint* checkpoint_copy(Checkpoint *src) {
+    checkpoint_expand(src);
+    Checkpoint *cp = calloc(1, sizeof(Checkpoint));
+    *cp = *src;
+    cp->next = NULL;
+    cp->cap = src->count;
+    cp->live = src->count ? malloc(sizeof(int) * src->count) : NULL;
+    if (src->count) memcpy(cp->live, src->live, sizeof(int) * src->count);
+    return cp;
+}
+
+/* Apply history entries [state->pos, to) to the live set in `state`, skipping
+ * entries at or after `until`. With ordered history the first such entry
+ * ends the replay. A DELETE_ITEM removes the oldest live ADD with its text.
+ */
+static void replay_history(HistoryEntry **hists, int to, HistoryEntry **adds,
+                           int64_t until, int ordered, Checkpoint *state) {
+    for (; state->pos < to; state->pos++) {
+        HistoryEntry *h = hists[state->pos];
+        int is_add = history_is_add(h);
+        if (h->ts.epoch >= until) {
+            if (ordered) break;
+            if (is_add) state->adds++;
+            continue;
+        }
+        state->ts = h->ts;
+        if (is_add) {
+            checkpoint_push(state, state->adds++);
+        } else if (strcmp(h->action, "DELETE_ITEM") == 0) {
+            for (int k = 0; k < state->count; k++) {
+                if (strcmp(adds[state->live[k]]->text, h->text) != 0) continue;
+                memmove(state->live + k, state->live + k + 1, sizeof(int) * (state->count - k - 1));
+                state->count--;
+                break;
+            }
+        }
+    }
+}
+
+/* Extend obj's checkpoints to cover its history; called before it is saved.
+ * Checkpoints past the end of the history (edited files) are dropped. The
+ * history is only gathered into an array when a new checkpoint is due.
+ */
+static void update_checkpoints(Object *obj) {
+    int n = 0, add_count = 0;
+    for (HistoryEntry *h = obj->history; h; h = h->next) {
+        n++;
+        add_count += history_is_add(h);
+    }
+    while (obj->checkpoints && (obj->checkpoints->pos > n || obj->checkpoints->adds > add_count)) {
+        Checkpoint *stale = obj->checkpoints;
+        obj->checkpoints = stale->next;
+        stale->next = NULL;
+        free_checkpoints(stale);
+    }
+    int base = obj->checkpoints ? obj->checkpoints->pos : 0;
+    if (n - base < CHECKPOINT_INTERVAL) return;
+
+    HistoryEntry **hists = history_array(obj, &n);
+    HistoryEntry **adds = history_adds(hists, n, &add_count);
+    Checkpoint state;
+    memset(&state, 0, sizeof(state));
+    if (obj->checkpoints) {
+        Checkpoint *start = checkpoint_copy(obj->checkpoints);
+        state = *start;
+        free(start);
+    }
+    while (n - state.pos >= CHECKPOINT_INTERVAL) {
+        replay_history(hists, state.pos + CHECKPOINT_INTERVAL, adds, INT64_MAX, 1, &state);
+        Checkpoint *cp = checkpoint_copy(&state);
+        cp->next = obj->checkpoints;
+        obj->checkpoints = cp;
+    }
+    free(state.live);
+    free(adds);
+    free(hists);
+}
+
+/* Items live in obj just before `until`, as ADD ordinals (ascending) into
+ * *adds_out. Replays from the newest usable checkpoint; history that is not
+ * in time order (after some merges) is replayed in full. Caller frees both.
+ */
+static int* object_state_at(Object *obj, int64_t until, HistoryEntry ***adds_out, int *count) {
+    int n, add_count;
+    HistoryEntry **hists = history_array(obj, &n);
+    HistoryEntry **adds = history_adds(hists, n, &add_count);
+    int ordered = 1;
+    for (int i = 1; i < n && ordered; i++) ordered = hists[i]->ts.epoch >= hists[i-1]->ts.epoch;
+
+    Checkpoint state;
+    memset(&state, 0, sizeof(state));
+    for (Checkpoint *cp = ordered ? obj->checkpoints : NULL; cp; cp = cp->next) {
+        if (cp->pos <= n && cp->adds <= add_count && cp->ts.epoch < until) {
+            Checkpoint *start = checkpoint_copy(cp);
+            state = *start;
+            free(start);
+            break;
+        }
+    }
+    replay_history(hists, n, adds, until, ordered, &state);
+    free(hists);
+
+    *adds_out = adds;
+    *count = state.count;
+    return state.live;
+}
+
+/* Write checkpoints oldest first: a checkpoint= header, then live= lines of
+ * ordinal ranges ("0-41,43,45-60") short enough for the line reader. */
+static void write_checkpoints(Writer *w, Checkpoint *cp) {
+    if (!cp) return;
+    write_checkpoints(w, cp->next);
+    w_bytes(w, "checkpoint=", 11);
+    w_int(w, cp->pos);
+    w_char(w, '|');
+    w_int(w, cp->adds);
+    w_char(w, '|');
+    w_timestamp(w, &cp->ts);
+    w_char(w, '\n');
+    // Still as loaded: the same ranges, wrapped the same way (anything no
+    // range of ours could be is rebuilt from the expanded list instead)
+    for (const char *p = cp->ranges; p && *p; ) {
+        size_t n = strcspn(p, ",");
+        if (n > 32) checkpoint_expand(cp);
+        p = n > 32 ? NULL : p + n + (p[n] == ',');
+    }
+    size_t line_len = 0;
+    if (cp->ranges) {
+        for (const char *p = cp->ranges; *p; ) {
+            const char *comma = strchr(p, ',');
+            size_t n = comma ? (size_t)(comma - p) : strlen(p);
+            if (line_len == 0) { w_bytes(w, "live=", 5); line_len = 5; }
+            else { w_char(w, ','); line_len++; }
+            w_bytes(w, p, n);
+            line_len += n;
+            if (line_len > 1000) {
+                w_char(w, '\n');
+                line_len = 0;
+            }
+            p = comma ? comma + 1 : p + n;
+        }
+        if (line_len) w_char(w, '\n');
+        return;
+    }
+    for (int i = 0; i < cp->count; ) {
+        int j = i;
+        while (j + 1 < cp->count && cp->live[j + 1] == cp->live[j] + 1) j++;
+        char range[48];
+        size_t n = format_int(range, cp->live[i]);
+        if (j > i) {
+            range[n++] = '-';
+            n += format_int(range + n, cp->live[j]);
+        }
+        if (line_len == 0) { w_bytes(w, "live=", 5); line_len = 5; }
+        else { w_char(w, ','); line_len++; }
+        w_bytes(w, range, n);
+        line_len += n;
+        if (line_len > 1000) {
+            w_char(w, '\n');
+            line_len = 0;
+        }
+        i = j + 1;
+    }
+    if (line_len) w_char(w, '\n');
+}
+
+/* Keep a live= value ("0-41,43") as text until the checkpoint is used: a
+ * project with many items would otherwise expand every checkpoint on load */
+static void parse_live_ranges(Checkpoint *cp, const char *value) {
+    size_t have = cp->ranges_len, len = strlen(value);
+    char *grown = realloc(cp->ranges, have + len + 2);
+    if (!grown) return;
+    cp->ranges = grown;
+    if (have) grown[have++] = ',';
+    memcpy(grown + have, value, len + 1);
+    cp->ranges_len = have + len;
+}
+
+/* Summary fields are fixed width ("%010d|%011lld+HHMM") so an append-only
+ * update can patch them in place */
+#define SUMMARY_FIELDS_LEN 27
+
+static void format_summary_fields(const Object *obj, char *buf) {
+    int32_t off = obj->modified.tz_offset;
+    char sign = '+';
+    if (off < 0) { sign = '-'; off = -off; }
+    snprintf(buf, SUMMARY_FIELDS_LEN + 1, "%010d|%011lld%c%02d%02d", obj->item_count,
+             (long long)obj->modified.epoch, sign, (int)(off / 3600), (int)((off % 3600) / 60));
+}
+
+/* Reverse a list in place. Lists are kept newest first; writers flip one
+ * to walk it oldest first without building an array, then flip it back. */
+static Item* reverse_items(Item *head) {
+    Item *prev = NULL;
+    while (head) {
+        Item *next = head->next;
+        head->next = prev;
+        prev = head;
+        head = next;
+    }
+    return prev;
+}
+
+static HistoryEntry* reverse_history(HistoryEntry *head) {
+    HistoryEntry *prev = NULL;
+    while (head) {
+        HistoryEntry *next = head->next;
+        head->next = prev;
+        prev = head;
+        head = next;
+    }
+    return prev;
+}
+
+static Object* reverse_objects(Object *head) {
+    Object *prev = NULL;
+    while (head) {
+        Object *next = head->next;
+        head->next = prev;
+        prev = head;
+        head = next;
+    }
+    return prev;
+}
+
+/* Write an object's tags= and tag= lines (see Tag Index) */
+static void write_tags(Writer *w, Object *obj) {
+    if (!obj->stub && !obj->tags) tags_rebuild(obj);
+    if (!obj->tags) return;
+    w_bytes(w, "tags=", 5);
+    w_int(w, obj->tags->count);
+    w_char(w, '|');
+    w_str(w, obj->name);
+    w_char(w, '\n');
+    for (int i = 0; i < obj->tags->count; i++) {
+        const TagPosting *tp = &obj->tags->postings[i];
+        for (int j = 0; j < tp->count; j++) {
+            if (j % TAG_LINE_IDS == 0) {
+                w_bytes(w, "tag=", 4);
+                w_str(w, tp->tag);
+                w_char(w, '|');
+            } else {
+                w_char(w, ',');
+            }
+            w_int(w, (long long)tp->ids[j]);
+            if (j % TAG_LINE_IDS == TAG_LINE_IDS - 1 || j == tp->count - 1) {
+                w_char(w, '|');
+                w_str(w, obj->name);
+                w_char(w, '\n');
+            }
+        }
+    }
+}
+
+/* Write the header summary: per-object item count and last modification,
+ * each followed by the object's rollup, so listings and stats need not
+ * parse the object sections. `objs` is the object list flipped oldest
+ * first. */
+static void write_summaries(Writer *w, Object *objs) {
+    for (Object *obj = objs; obj; obj = obj->next) {
+        if (!obj->stub) {
+            int n = 0;
+            for (Item *item = obj->items; item; item = item->next) n++;
+            obj->item_count = n;
+        }
+        if (!obj->modified.epoch) {
+            // Files from before summaries: the newest history entry will do
+            if (obj->history) obj->modified = obj->history->ts;
+            else if (obj->items) obj->modified = obj->items->ts;
+        }
+        char fields[SUMMARY_FIELDS_LEN + 1];
+        format_summary_fields(obj, fields);
+        w_bytes(w, "summary=", 8);
+        w_bytes(w, fields, SUMMARY_FIELDS_LEN);
+        w_char(w, '|');
+        w_str(w, obj->name);
+        w_char(w, '\n');
+        if (!obj->stub && !obj->rollup.valid) rollup_rebuild(obj);
+        if (obj->rollup.valid) {
+            char rollup[ROLLUP_FIELDS_LEN + 1];
+            format_rollup_fields(&obj->rollup, rollup);
+            w_bytes(w, "rollup=", 7);
+            w_bytes(w, rollup, ROLLUP_FIELDS_LEN);
+            w_char(w, '|');
+            w_str(w, obj->name);
+            w_char(w, '\n');
+        }
+        char retain[48];
+        int retain_len = format_retain_fields(obj, retain, sizeof(retain));
+        if (retain_len) {
+            w_bytes(w, "retain=", 7);
+            w_bytes(w, retain, (size_t)retain_len);
+            w_char(w, '|');
+            w_str(w, obj->name);
+            w_char(w, '\n');
+        }
+        write_tags(w, obj);
+    }
+}
+
+/* Apply a summary= value (count|timestamp|name) to the named object,
+ * creating a stub for it if asked */
+static void apply_summary(Project *proj, char *value, int create) {
+    char *pipe1 = strchr(value, '|');
+    char *pipe2 = pipe1 ? strchr(pipe1 + 1, '|') : NULL;
+    if (!pipe2) return;
+    *pipe2 = '\0';
+    const char *name = pipe2 + 1;
+    Object *obj = proj->objects;
+    while (obj && strcmp(obj->name, name) != 0) obj = obj->next;
+    if (!obj && create) {
+        obj = calloc(1, sizeof(Object));
+        if (!obj) return;
+        snprintf(obj->name, MAX_TEXT, "%s", name);
+        obj->stub = 1;
+        obj->next = proj->objects;
+        proj->objects = obj;
+    }
+    if (!obj) return;
+    obj->item_count = atoi(value);
+    parse_timestamp_field(pipe1 + 1, &obj->modified);
+}
+
+#define PARSE_BLOCK (256 * 1024)
+
+/* Key of a key=value record, matched by length first */
+#define KEY_IS(k) (key_len == sizeof(k) - 1 && memcmp(key, k, sizeof(k) - 1) == 0)
+
+/* Parse one key=value record (line NUL-terminated, no newline) */
+static void parse_record(Project *proj, Object **current, char *line, size_t len) {
+    char *eq = memchr(line, '=', len);
+    if (!eq) return;
+    *eq = '\0';
+    char *key = line;
+    char *value = eq + 1;
+    char *line_end = line + len;
+    
+    // Trim whitespace
+    while (*key == ' ' || *key == '\t') key++;
+    while (*value == ' ' || *value == '\t') value++;
+    size_t key_len = (size_t)(eq - key);
+    
+    switch (key[0]) {
+    case 'i':
+        if (KEY_IS("item") && *current) {
+            // Format: timestamp#hash@id|text
+            char *pipe = memchr(value, '|', (size_t)(line_end - value));
+            if (!pipe) return;
+            *pipe = '\0';
+            // Every field is set below, so the 1 KB text buffer is not cleared first
+            Item *item = malloc(sizeof(Item));
+            if (!item) return;
+            if (!parse_timestamp_field(value, &item->ts)) {
+                free(item);
+                return;
+            }
+            read_text_field(pipe, line_end, item->text);
+            // Stored content hash follows the timestamp as #<hex>, the id as @<n>
+            char *hash = memchr(value, '#', (size_t)(pipe - value));
+            item->hash = hash ? strtoull(hash + 1, NULL, 16) : 0;
+            char *id = memchr(value, '@', (size_t)(pipe - value));
+            item->id = id ? (uint32_t)strtoul(id + 1, NULL, 10) : 0;
+            if (!item->hash) item->hash = text_hash(item->text);
+            // Items are appended in time order; remember if that ever breaks
+            if ((*current)->items && item->ts.epoch < (*current)->items->ts.epoch) {
+                (*current)->unordered = 1;
+            }
+            item->next = (*current)->items;
+            (*current)->items = item;
+        } else if (KEY_IS("index")) {
+            proj->index = atoi(value);
+        }
+        return;
+    case 'h':
+        if (KEY_IS("history") && *current) {
+            // Format: timestamp@id|action|text (no @id before ids were kept)
+            char *pipe1 = memchr(value, '|', (size_t)(line_end - value));
+            if (!pipe1) return;
+            *pipe1 = '\0';
+            char *pipe2 = memchr(pipe1 + 1, '|', (size_t)(line_end - pipe1 - 1));
+            if (!pipe2) return;
+            *pipe2 = '\0';
+            HistoryEntry *hist = malloc(sizeof(HistoryEntry));
+            if (!hist) return;
+            if (!parse_timestamp_field(value, &hist->ts)) {
+                free(hist);
+                return;
+            }
+            char *id = memchr(value, '@', (size_t)(pipe1 - value));
+            hist->id = id ? (uint32_t)strtoul(id + 1, NULL, 10) : 0;
+            size_t action_len = (size_t)(pipe2 - pipe1 - 1) - (pipe2[-1] == '\\');
+            if (action_len > 31) action_len = 31;
+            memcpy(hist->action, pipe1 + 1, action_len);
+            hist->action[action_len] = '\0';
+            read_text_field(pipe2, line_end, hist->text);
+            hist->next = (*current)->history;
+            (*current)->history = hist;
+        }
+        return;
+    case 'n':
+        if (KEY_IS("name")) {
+            snprintf(proj->name, MAX_TEXT, "%s", value);
+        } else if (KEY_IS("next_id") && !*current) {
+            proj->next_id = (uint32_t)strtoul(value, NULL, 10);
+        }
+        return;
+    case 'o':
+        if (KEY_IS("objects") && !*current) proj->has_summary = 1;
+        return;
+    case 'f':
+        if (KEY_IS("filter") && !*current) parse_filter(proj, value);
+        return;
+    case 's':
+        if (KEY_IS("summary") && !*current) apply_summary(proj, value, 1);
+        return;
+    case 'r':
+        if (KEY_IS("rollup") && !*current) apply_rollup(proj, value);
+        else if (KEY_IS("retain") && !*current) apply_retain(proj, value);
+        return;
+    case 't':
+        if (KEY_IS("tag") && !*current) {
+            apply_tag(proj, value);
+            return;
+        }
+        if (KEY_IS("tags") && !*current) {
+            apply_tags(proj, value);
+            return;
+        }
+        // fall through
+    case 'u':
+        if (KEY_IS("tombstone") || KEY_IS("update")) {
+            // Format: id|timestamp[|text]
+            JournalEntry *entry = calloc(1, sizeof(JournalEntry));
+            char *pipe1 = strchr(value, '|');
+            char *pipe2 = pipe1 ? strchr(pipe1 + 1, '|') : NULL;
+            entry->tombstone = key[0] == 't';
+            if (!pipe1 || (!entry->tombstone && !pipe2)) { free(entry); return; }
+            if (pipe2) *pipe2 = '\0';
+            entry->id = (uint32_t)strtoul(value, NULL, 10);
+            if (!parse_timestamp_field(pipe1 + 1, &entry->ts)) { free(entry); return; }
+            if (pipe2) read_text_field(pipe2, line_end, entry->text);
+            JournalEntry **tail = &proj->journal;
+            while (*tail) tail = &(*tail)->next;
+            *tail = entry;
+        }
+        return;
+    case 'c':
+        if (KEY_IS("checkpoint") && *current) {
+            // Format: pos|adds|timestamp, followed by live= lines
+            Checkpoint *cp = calloc(1, sizeof(Checkpoint));
+            char ts[32];
+            if (sscanf(value, "%d|%d|%31s", &cp->pos, &cp->adds, ts) != 3 ||
+                !parse_timestamp_field(ts, &cp->ts)) {
+                free(cp);
+                return;
+            }
+            cp->next = (*current)->checkpoints;
+            (*current)->checkpoints = cp;
+        }
+        return;
+    case 'l':
+        if (KEY_IS("live") && *current && (*current)->checkpoints) {
+            parse_live_ranges((*current)->checkpoints, value);
+        }
+        return;
+    }
+}
+
+/* Parse project-format lines from f into proj. Object sections are created
+ * as their [object NAME] headers appear; *current is the open section.
+ * Input is read PARSE_BLOCK bytes at a time and split with memchr; a line
+ * longer than MAX_LINE - 1 bytes is cut into pieces of that size.
+ */
+static void parse_project_lines(FILE *f, Project *proj, Object **current, int header_only) {
+    char *buf = malloc(PARSE_BLOCK + 1);
+    if (!buf) return;
+    size_t start = 0, end = 0;
+    int eof = 0;
+    uint32_t crc = 0;       // records since the last crc= boundary
+    int in_journal = 0;
+    
+    for (;;) {
+        char *line = buf + start;
+        size_t avail = end - start;
+        char *nl = memchr(line, '\n', avail);
+        if (!nl && avail < MAX_LINE - 1 && !eof) {
+            // Refill behind the partial line
+            memmove(buf, line, avail);
+            start = 0;
+            end = avail;
+            size_t n = fread(buf + end, 1, PARSE_BLOCK - end, f);
+            if (n == 0) eof = 1;
+            end += n;
+            continue;
+        }
+        if (avail == 0) break;
+        size_t len = nl ? (size_t)(nl - line) + 1 : avail;
+        if (len > MAX_LINE - 1) len = MAX_LINE - 1;
+        start += len;
+        
+        // Skip empty lines
+        if (line[0] == '\n') continue;
+        
+        // Verify checksummed runs of records; a journal run starts a new one
+        if (len >= 4 && memcmp(line, "crc=", 4) == 0) {
+            if ((uint32_t)strtoul(line + 4, NULL, 16) != crc) proj->damaged = 1;
+            crc = 0;
+            continue;
+        }
+        int journal = (len >= 10 && memcmp(line, "tombstone=", 10) == 0) ||
+                      (len >= 7 && memcmp(line, "update=", 7) == 0);
+        int section = len >= 8 && memcmp(line, "[object ", 8) == 0;
+        if ((journal && !in_journal) || section) crc = 0;
+        in_journal = journal;
+        crc = crc32c(crc, line, len);
+        
+        // Terminate the record in place (the byte after it is put back)
+        size_t text_len = line[len - 1] == '\n' ? len - 1 : len;
+        char saved = line[text_len];
+        line[text_len] = '\0';
+        
+        // Check for object section header
+        if (section) {
+            if (header_only) break;
+            char *obj_name_start = line + 8;
+            char *obj_name_end = strchr(obj_name_start, ']');
+            if (obj_name_end) {
+                *obj_name_end = '\0';
+                
+                // Fill the stub from the header summary, or create the object
+                Object *obj = proj->objects;
+                while (obj && !(obj->stub && strcmp(obj->name, obj_name_start) == 0)) obj = obj->next;
+                if (obj) {
+                    obj->stub = 0;
+                } else {
+                    obj = calloc(1, sizeof(Object));
+                    snprintf(obj->name, MAX_TEXT, "%s", obj_name_start);
+                    obj->next = proj->objects;
+                    proj->objects = obj;
+                }
+                *current = obj;
+            }
+        } else {
+            parse_record(proj, current, line, text_len);
+        }
+        line[text_len] = saved;
+    }
+    free(buf);
+}
+
+/* Write one object section: header, items and history (oldest first), its
+ * replay checkpoints if asked, crc= line, blank line */
+static void write_object_section(Writer *w, Object *obj, int checkpoints) {
+    w_crc_begin(w);
+    w_bytes(w, "[object ", 8);
+    w_str(w, obj->name);
+    w_bytes(w, "]\n", 2);
+    
+    obj->items = reverse_items(obj->items);
+    for (Item *item = obj->items; item; item = item->next) {
+        w_bytes(w, "item=", 5);
+        w_timestamp(w, &item->ts);
+        w_char(w, '#');
+        w_hex(w, item->hash, 16);
+        w_char(w, '@');
+        w_int(w, item->id);
+        w_text(w, item->text);
+        w_char(w, '\n');
+    }
+    obj->items = reverse_items(obj->items);
+    
+    // History, then its replay checkpoints
+    obj->history = reverse_history(obj->history);
+    for (HistoryEntry *h = obj->history; h; h = h->next) {
+        w_bytes(w, "history=", 8);
+        w_timestamp(w, &h->ts);
+        if (h->id) {
+            w_char(w, '@');
+            w_int(w, h->id);
+        }
+        w_char(w, '|');
+        w_str(w, h->action);
+        w_text(w, h->text);
+        w_char(w, '\n');
+    }
+    obj->history = reverse_history(obj->history);
+    if (checkpoints) {
+        update_checkpoints(obj);
+        write_checkpoints(w, obj->checkpoints);
+    }
+    
+    w_crc_end(w);
+    w_char(w, '\n');
+}
+
+/* Objects in file order (the list is kept newest-first). Caller frees. */
+static Object** objects_in_order(Project *proj, int *count) {
+    *count = 0;
+    for (Object *o = proj->objects; o; o = o->next) (*count)++;
+    if (*count == 0) return NULL;
+    Object **objs = malloc(sizeof(Object*) * (*count));
+    int i = *count;
+    for (Object *o = proj->objects; o; o = o->next) objs[--i] = o;
+    return objs;
+}
+
+int is_directory(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// ===== Item IDs & Journal ===== //
+// Every item carries a stable id (item=<ts>#<hash>@<id>|text), handed out
+// from the project's next_id. Deletes and edits by id append one journal
+// line (tombstone=/update=) to the file instead of rewriting it; the loader
+// replays those lines onto the items, and the next full save folds them in.
+// No id index is stored: a lookup parses the object (the whole file in the
+// single-file layout) and searches its items in memory.
+
+static int cmp_item_id(const void *a, const void *b) {
+    uint32_t x = (*(Item * const *)a)->id, y = (*(Item * const *)b)->id;
+    return x < y ? -1 : x > y;
+}
+
+/* Binary search obj's items by id. Items are appended in id order, so the
+ * lookup array is usually just the oldest-first array; merges can break the
+ * order, in which case it is sorted once. Built per load, not persisted. */
+Item* find_item_by_id(Object *obj, uint32_t id) {
+    if (!obj->by_id) {
+        obj->by_id = get_items_array(obj, &obj->by_id_count);
+        if (!obj->by_id) return NULL;
+        for (int i = 1; i < obj->by_id_count; i++) {
+            if (obj->by_id[i]->id < obj->by_id[i-1]->id) {
+                qsort(obj->by_id, obj->by_id_count, sizeof(Item*), cmp_item_id);
+                break;
+            }
+        }
+    }
+    int lo = 0, hi = obj->by_id_count - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        uint32_t mid_id = obj->by_id[mid]->id;
+        if (mid_id == id) return obj->by_id[mid];
+        if (mid_id < id) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return NULL;
+}
+
+/* Parse "#<id>" (or a bare number after '#'). Returns 0 if arg is not one. */
+int parse_item_id(const char *arg, uint32_t *id) {
+    if (arg[0] != '#' || !isdigit((unsigned char)arg[1])) return 0;
+    char *end;
+    unsigned long v = strtoul(arg + 1, &end, 10);
+    if (*end || v == 0 || v > UINT32_MAX) return 0;
+    *id = (uint32_t)v;
+    return 1;
+}
+
+static void add_history(Object *obj, const char *action, const Timestamp *ts, const char *text, uint32_t id) {
+    HistoryEntry *hist = calloc(1, sizeof(HistoryEntry));
+    if (!hist) return;
+    snprintf(hist->action, sizeof(hist->action), "%s", action);
+    hist->ts = *ts;
+    hist->id = id;
+    snprintf(hist->text, MAX_TEXT, "%s", text);
+    hist->next = obj->history;
+    obj->history = hist;
+}
+
+/* Replace an item's text, recording DELETE_ITEM of the old text and EDIT of
+ * the new one so history replay sees the change */
+void edit_item_text(Object *obj, Item *item, const char *text, const Timestamp *ts) {
+    add_history(obj, "DELETE_ITEM", ts, item->text, item->id);
+    hashset_remove(obj->hashes, item->hash);
+    termstats_update(obj->terms, item->text, -1);
+    tags_update(obj, item->text, item->id, -1);
+    snprintf(item->text, MAX_TEXT, "%s", text);
+    item->hash = text_hash(item->text);
+    if (obj->hashes) hashset_add(obj->hashes, item->hash);
+    termstats_update(obj->terms, item->text, 1);
+    tags_update(obj, item->text, item->id, 1);
+    add_history(obj, "EDIT", ts, item->text, item->id);
+}
+
+/* Unlink and free the items whose ids are in `dead` (keys are id + 1) */
+static void remove_items_by_id(Object *obj, const HashSet *dead) {
+    Item **link = &obj->items;
+    int removed = 0;
+    while (*link) {
+        Item *item = *link;
+        if (!hashset_contains(dead, (uint64_t)item->id + 1)) { link = &item->next; continue; }
+        *link = item->next;
+        hashset_remove(obj->hashes, item->hash);
+        termstats_update(obj->terms, item->text, -1);
+        tags_update(obj, item->text, item->id, -1);
+        free(item);
+        removed++;
+    }
+    if (removed) {
+        free(obj->by_id);
+        obj->by_id = NULL;
+    }
+}
+
+/* After a load: give ids to items stored without one (files from before
+ * ids, numbered in file order), then replay the journal. */
+static void finish_load(Project *proj) {
+    int count;
+    Object **objs = objects_in_order(proj, &count);
+    uint32_t max_id = 0;
+    proj->loaded_items = 0;
+    for (int i = 0; i < count; i++) {
+        for (Item *item = objs[i]->items; item; item = item->next) {
+            if (item->id > max_id) max_id = item->id;
+            proj->loaded_items++;
+        }
+    }
+    if (proj->next_id <= max_id) proj->next_id = max_id + 1;
+    for (int i = 0; i < count; i++) {
+        int n;
+        Item **items = get_items_array(objs[i], &n);
+        for (int j = 0; j < n; j++) {
+            if (!items[j]->id) items[j]->id = proj->next_id++;
+        }
+        free(items);
+    }
+
+    HashSet dead;
+    memset(&dead, 0, sizeof(dead));
+    proj->journal_count = 0;
+    for (JournalEntry *entry = proj->journal; entry; entry = entry->next) {
+        proj->journal_count++;
+        if (hashset_contains(&dead, (uint64_t)entry->id + 1)) continue;
+        Item *item = NULL;
+        Object *obj = NULL;
+        for (int i = 0; i < count && !item; i++) {
+            if (objs[i]->stub) continue;
+            obj = objs[i];
+            item = find_item_by_id(obj, entry->id);
+        }
+        if (!item) continue;  // in an object that was not loaded
+        if (entry->tombstone) {
+            add_history(obj, "DELETE_ITEM", &entry->ts, item->text, item->id);
+            hashset_add(&dead, (uint64_t)entry->id + 1);
+        } else {
+            edit_item_text(obj, item, entry->text, &entry->ts);
+        }
+    }
+    if (dead.len) {
+        for (int i = 0; i < count; i++) remove_items_by_id(objs[i], &dead);
+        proj->loaded_items -= (int)dead.len;
+    }
+    free(dead.keys);
+    free(dead.counts);
+    free(objs);
+
+    if (proj->damaged) {
+        fprintf(stderr, "Warning: project '%s' has records that fail their checksum; "
+                "run 'funknotes fsck %s'\n", proj->name, proj->name);
+    }
+}
+
+// ===== Directory Layout ===== //
+// projects/<index>_<name>/ holds manifest.txt (name, index, object list)
+// and one <id>.txt per object containing that object's section. Writers
+// only rewrite the objects they marked dirty, so adding to one object never
+// touches the others, and deleting an object just unlinks its file.
+
+#define MANIFEST_FILE "manifest.txt"
+
+/* Write a file via a hidden temp name in the same directory, then rename */
+static int write_file_atomic(const char *dir, const char *name, void (*emit)(FILE *, void *), void *arg) {
+    char path[MAX_PATH], tmp[MAX_PATH];
+    snprintf(path, MAX_PATH, "%s/%s", dir, name);
+    snprintf(tmp, MAX_PATH, "%s/.%s.tmp", dir, name);
+    FILE *f = fopen(tmp, "w");
+    if (!f) return 0;
+    emit(f, arg);
+    if (fclose(f) != 0 || rename(tmp, path) != 0) {
+        remove(tmp);
+        return 0;
+    }
+    return 1;
+}
+
+static void emit_object(FILE *f, void *arg) {
+    Writer w;
+    writer_init(&w, f);
+    write_object_section(&w, arg, 1);
+    writer_finish(&w);
+}
+
+static void emit_manifest(FILE *f, void *arg) {
+    Project *proj = arg;
+    Writer w;
+    writer_init(&w, f);
+    w_bytes(&w, "name=", 5);
+    w_str(&w, proj->name);
+    w_bytes(&w, "\nindex=", 7);
+    w_int(&w, proj->index);
+    w_bytes(&w, "\nlayout=dir\nnext_object=", 24);
+    w_int(&w, proj->next_shard);
+    w_bytes(&w, "\nnext_id=", 9);
+    w_int(&w, proj->next_id);
+    w_bytes(&w, "\nchecksums=crc32c\n", 18);
+    write_filter(&w, proj);
+    proj->objects = reverse_objects(proj->objects);
+    for (Object *obj = proj->objects; obj; obj = obj->next) {
+        w_bytes(&w, "object=", 7);
+        w_int(&w, obj->shard_id);
+        w_char(&w, '|');
+        w_str(&w, obj->name);
+        w_char(&w, '\n');
+    }
+    write_summaries(&w, proj->objects);
+    proj->objects = reverse_objects(proj->objects);
+    writer_finish(&w);
+}
+
+/* Load a directory-layout project. With only_object set, the other objects
+ * are listed but their files are not read (stubs that are never saved).
+ */
+static Project* load_project_dir(const char *dir, const char *only_object) {
+    char path[MAX_PATH];
+    snprintf(path, MAX_PATH, "%s/" MANIFEST_FILE, dir);
+    FILE *m = fopen(path, "r");
+    if (!m) return NULL;
+
+    Project *proj = calloc(1, sizeof(Project));
+    if (!proj) { fclose(m); return NULL; }
+    proj->index = -1;
+    proj->next_shard = 1;
+
+    char line[MAX_LINE];
+    while (fgets(line, sizeof(line), m)) {
+        size_t len = strlen(line);
+        if (len > 0 && line[len-1] == '\n') line[--len] = '\0';
         char *eq = strchr(line, '=');
         if (!eq) continue;
         *eq = '\0';
-        char *key = line;
         char *value = eq + 1;
+        if (strcmp(line, "name") == 0) {
+            snprintf(proj->name, MAX_TEXT, "%s", value);
+        } else if (strcmp(line, "index") == 0) {
+            proj->index = atoi(value);
+        } else if (strcmp(line, "next_object") == 0) {
+            proj->next_shard = atoi(value);
+        } else if (strcmp(line, "next_id") == 0) {
+            proj->next_id = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(line, "filter") == 0) {
+            parse_filter(proj, value);
+        } else if (strcmp(line, "summary") == 0) {
+            proj->has_summary = 1;
+            apply_summary(proj, value, 0);
+        } else if (strcmp(line, "rollup") == 0) {
+            apply_rollup(proj, value);
+        } else if (strcmp(line, "retain") == 0) {
+            apply_retain(proj, value);
+        } else if (strcmp(line, "tags") == 0) {
+            apply_tags(proj, value);
+        } else if (strcmp(line, "tag") == 0) {
+            apply_tag(proj, value);
+        } else if (strcmp(line, "object") == 0) {
+            char *pipe = strchr(value, '|');
+            if (!pipe) continue;
+            int id = atoi(value);
+            const char *name = pipe + 1;
+
+            Object *obj = NULL;
+            if (!only_object || strcmp(name, only_object) == 0) {
+                snprintf(path, MAX_PATH, "%s/%d.txt", dir, id);
+                FILE *f = fopen(path, "r");
+                if (f) {
+                    lock_for_read(f);
+                    Project scratch;
+                    memset(&scratch, 0, sizeof(scratch));
+                    Object *current = NULL;
+                    parse_project_lines(f, &scratch, &current, 0);
+                    fclose(f);
+                    obj = scratch.objects;
+                    if (obj) {
+                        // One section per file; drop anything extra
+                        scratch.objects = obj->next;
+                        obj->next = NULL;
+                        free_project_objects(scratch.objects);
+                    }
+                    proj->damaged |= scratch.damaged;
+                    // Journal records appended to this object's file
+                    JournalEntry **tail = &proj->journal;
+                    while (*tail) tail = &(*tail)->next;
+                    *tail = scratch.journal;
+                }
+            }
+            if (!obj) {
+                obj = calloc(1, sizeof(Object));
+                if (!obj) continue;
+                obj->stub = only_object != NULL;
+            }
+            snprintf(obj->name, MAX_TEXT, "%s", name);
+            obj->shard_id = id;
+            if (id >= proj->next_shard) proj->next_shard = id + 1;
+            obj->next = proj->objects;
+            proj->objects = obj;
+        }
+    }
+    fclose(m);
+    finish_load(proj);
+    return proj;
+}
+
+static int apply_retention(const char *project_file, Project *proj);
+static void fold_cold_tier(const char *project_file, Project *proj);
+
+/* Save a directory-layout project: dirty (or, with all set, every loaded)
+ * object file, then the manifest; files of removed objects are unlinked.
+ */
+int save_project_dir(const char *dir, Project *proj, int all) {
+    mkdir(dir, 0755);
+    if (!apply_retention(dir, proj)) return 0;
+    if (proj->next_shard < 1) proj->next_shard = 1;
+
+    int count;
+    Object **objs = objects_in_order(proj, &count);
+    for (int i = 0; i < count; i++) {
+        if (objs[i]->shard_id <= 0) {
+            objs[i]->shard_id = proj->next_shard++;
+            objs[i]->dirty = 1;
+        } else if (objs[i]->shard_id >= proj->next_shard) {
+            proj->next_shard = objs[i]->shard_id + 1;
+        }
+    }
+
+    int ok = 1;
+    for (int i = 0; i < count && ok; i++) {
+        Object *obj = objs[i];
+        if (obj->stub || (!all && !obj->dirty)) continue;
+        char name[32];
+        snprintf(name, sizeof(name), "%d.txt", obj->shard_id);
+        ok = write_file_atomic(dir, name, emit_object, obj);
+        if (ok) obj->dirty = 0;
+    }
+    update_project_filter(proj);
+    ok = ok && write_file_atomic(dir, MANIFEST_FILE, emit_manifest, proj);
+
+    // Unlink object files no longer listed in the manifest
+    DIR *d = ok ? opendir(dir) : NULL;
+    struct dirent *entry;
+    while (d && (entry = readdir(d)) != NULL) {
+        char *end;
+        long id = strtol(entry->d_name, &end, 10);
+        if (end == entry->d_name || strcmp(end, ".txt") != 0) continue;
+        int listed = 0;
+        for (int i = 0; i < count && !listed; i++) listed = objs[i]->shard_id == id;
+        if (!listed) {
+            char path[MAX_PATH];
+            snprintf(path, MAX_PATH, "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+    }
+    if (d) closedir(d);
+    free(objs);
+    return ok;
+}
+
+/* Remove a project from disk, whichever layout it uses */
+int remove_project_path(const char *path) {
+    if (!is_directory(path)) return remove(path);
+    DIR *d = opendir(path);
+    if (!d) return -1;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        char file[MAX_PATH];
+        snprintf(file, MAX_PATH, "%s/%s", path, entry->d_name);
+        unlink(file);
+    }
+    closedir(d);
+    return rmdir(path);
+}
+
+/* Is a projects/ entry a project (plain .txt, archived .fnz or a directory
+ * with a manifest)? */
+int is_project_entry(const char *projects_dir, const char *name) {
+    if (is_project_filename(name)) return 1;
+    if (name[0] == '.' || strchr(name, '.')) return 0;
+    char manifest[MAX_PATH];
+    snprintf(manifest, MAX_PATH, "%s/%s/" MANIFEST_FILE, projects_dir, name);
+    return access(manifest, F_OK) == 0;
+}
+
+/* Parse a whole single-file project from f */
+static Project* read_project_stream(FILE *f) {
+    Project *proj = calloc(1, sizeof(Project));
+    if (!proj) return NULL;
+    
+    proj->index = -1;
+    Object *current_obj = NULL;
+    parse_project_lines(f, proj, &current_obj, 0);
+
+    // Summaries without a section (hand-edited files) are dropped
+    Object **link = &proj->objects;
+    while (*link) {
+        Object *obj = *link;
+        if (!obj->stub) { link = &obj->next; continue; }
+        *link = obj->next;
+        free(obj);
+    }
+    finish_load(proj);
+    return proj;
+}
+
+/* Load project from text file (archived .fnz files are decompressed as they
+ * are read) or from a directory-layout project */
+static Project* load_project_disk(const char *filename) {
+    if (is_directory(filename)) return load_project_dir(filename, NULL);
+
+    FILE *f = open_project_read(filename);
+    if (!f) return NULL;
+    Project *proj = read_project_stream(f);
+    fclose(f);
+    return proj;
+}
+
+static Project* batch_project(const char *filename);
+
+/* Load a project in full. Inside a batch this is the resident copy. */
+Project* load_project_file(const char *filename) {
+    if (g_batch_active) return batch_project(filename);
+    Project *proj = load_project_disk(filename);
+    if (proj && g_cold) fold_cold_tier(filename, proj);
+    return proj;
+}
+
+/* Load only the header: name, index and the per-object summaries (objects
+ * come back as stubs with item_count set). Files written before summaries
+ * existed are loaded in full. */
+Project* load_project_header(const char *filename) {
+    if (g_batch_active) return batch_project(filename);
+    Project *proj;
+    if (is_directory(filename)) {
+        proj = load_project_dir(filename, "");
+    } else {
+        FILE *f = open_project_read(filename);
+        if (!f) return NULL;
+        proj = calloc(1, sizeof(Project));
+        if (!proj) { fclose(f); return NULL; }
+        proj->index = -1;
+        Object *current_obj = NULL;
+        parse_project_lines(f, proj, &current_obj, 1);
+        fclose(f);
+    }
+    if (proj && !proj->has_summary) {
+        free_project(proj);
+        proj = load_project_file(filename);
+    }
+    return proj;
+}
+
+/* Load a project for a command that only reads or changes one object. In the
+ * directory layout only that object's file is parsed; single-file projects
+ * are loaded whole. */
+Project* load_project_for_object(const char *filename, const char *object_name) {
+    if (g_batch_active) return batch_project(filename);
+    if (is_directory(filename) && !g_cold) return load_project_dir(filename, object_name);
+    return load_project_file(filename);
+}
+
+/* Write a whole project in the single-file format; returns 0 if a write failed */
+static int write_project(FILE *f, Project *proj) {
+    Writer w;
+    writer_init(&w, f);
+    w_bytes(&w, "name=", 5);
+    w_str(&w, proj->name);
+    w_bytes(&w, "\nindex=", 7);
+    w_int(&w, proj->index);
+    w_bytes(&w, "\nnext_id=", 9);
+    w_int(&w, proj->next_id);
+    w_bytes(&w, "\nchecksums=crc32c\n", 18);
+    update_project_filter(proj);
+    write_filter(&w, proj);
+    
+    // Header summary, then objects in original order
+    int obj_count = 0;
+    for (Object *obj = proj->objects; obj; obj = obj->next) obj_count++;
+    w_bytes(&w, "objects=", 8);
+    w_int(&w, obj_count);
+    w_char(&w, '\n');
+    proj->objects = reverse_objects(proj->objects);
+    write_summaries(&w, proj->objects);
+    w_char(&w, '\n');
+    for (Object *obj = proj->objects; obj; obj = obj->next) {
+        write_object_section(&w, obj, 1);
+    }
+    proj->objects = reverse_objects(proj->objects);
+    return writer_finish(&w);
+}
+
+/* Hidden sibling a project file is written under before it is renamed into
+ * place; project scans skip dotfiles */
+static void project_temp_path(const char *path, char *tmp) {
+    const char *slash = strrchr(path, '/');
+    size_t dir_len = slash ? (size_t)(slash - path) + 1 : 0;
+    snprintf(tmp, MAX_PATH, "%.*s.%s", (int)dir_len, path, path + dir_len);
+}
+
+/* Save project to text file (compressed when the path is an archived .fnz).
+ * The file is written under a hidden name and renamed over the old one, so
+ * a reader sees the whole old or the whole new project. Directory-layout
+ * projects rewrite only their changed objects. */
+int save_project_file(const char *filename, Project *proj) {
+    if (g_batch_active && proj->pinned) {
+        proj->pending = 1;  // written once, when the batch ends
+        return 1;
+    }
+    if (is_directory(filename)) return save_project_dir(filename, proj, 0);
+
+    // A header-only or partial load must never overwrite the full file
+    for (Object *obj = proj->objects; obj; obj = obj->next) {
+        if (obj->stub) return 0;
+    }
+    if (!apply_retention(filename, proj)) return 0;
+
+    char tmp[MAX_PATH];
+    project_temp_path(filename, tmp);
+    FILE *f = open_project_write(tmp);
+    if (!f) return 0;
+    int ok = write_project(f, proj);
+    if (fclose(f) != 0 || !ok || rename(tmp, filename) != 0) {
+        remove(tmp);
+        return 0;
+    }
+    return 1;
+}
+
+// ===== Cold Tier ===== //
+// Items a retention policy moves out of the project file are appended, as
+// [object NAME] sections in the project format, to projects/<index>.cold.
+// The file is keyed by index so it follows the project through migrate,
+// archive and batch staging. A load with the tier folded back in
+// (--cold, sync, merges, retain) puts each object's cold items and history
+// behind its hot ones; saving such a project applies the policies exactly
+// and rewrites the tier, so a looser policy brings items back.
+
+Object* find_object(Project *proj, const char *object_name);
+int count_items(Object *obj);
+
+/* projects/<index>.cold for a project file or directory */
+static void cold_path(const char *project_file, int index, char *out) {
+    const char *slash = strrchr(project_file, '/');
+    int dir_len = slash ? (int)(slash - project_file) + 1 : 0;
+    snprintf(out, MAX_PATH, "%.*s%d.cold", dir_len, project_file, index);
+}
+
+/* Write the cold tier's header (for a new file) and object sections, the
+ * list flipped so that an object's older sections stay first */
+static int write_cold(FILE *f, Project *cold, int header) {
+    Writer w;
+    writer_init(&w, f);
+    if (header) {
+        w_bytes(&w, "name=", 5);
+        w_str(&w, cold->name);
+        w_bytes(&w, "\nindex=", 7);
+        w_int(&w, cold->index);
+        w_bytes(&w, "\n\n", 2);
+    }
+    // No checkpoints: folding the tier back in invalidates them
+    cold->objects = reverse_objects(cold->objects);
+    for (Object *obj = cold->objects; obj; obj = obj->next) {
+        write_object_section(&w, obj, 0);
+    }
+    cold->objects = reverse_objects(cold->objects);
+    return writer_finish(&w);
+}
+
+static void emit_cold(FILE *f, void *arg) {
+    write_cold(f, arg, 1);
+}
+
+/* Split off the items obj's policy no longer keeps hot, with the history
+ * from before the oldest item that stays. Outside a folded save a policy
+ * is only applied once the hot tier outgrows it by some slack (an eighth
+ * plus 16 items, or a day), so most saves move nothing. Returns the part
+ * to store cold, or NULL. */
+static Object* retain_split(Object *obj, int64_t now, int exact) {
+    if (exact) obj->cold = 0;
+    if (!obj->retain_items && !obj->retain_days) return NULL;
+    int64_t cutoff = now - (int64_t)obj->retain_days * 86400;
+    if (obj->retain_items) {
+        int slack = exact ? 0 : obj->retain_items / 8 + 16;
+        if (count_items(obj) <= obj->retain_items + slack) return NULL;
+    } else {
+        int64_t due = exact ? cutoff : cutoff - 86400;
+        Item *item = obj->items;
+        while (item && item->ts.epoch >= due) item = item->next;
+        if (!item) return NULL;
+    }
+
+    Object *part = calloc(1, sizeof(Object));
+    if (!part) return NULL;
+    snprintf(part->name, MAX_TEXT, "%s", obj->name);
+    Item **keep = &obj->items, **move = &part->items;
+    int kept = 0, moved = 0;
+    int64_t oldest = INT64_MAX;
+    HashSet hot;
+    memset(&hot, 0, sizeof(hot));
+    for (Item *item = obj->items, *next; item; item = next) {
+        next = item->next;
+        if (obj->retain_items ? kept >= obj->retain_items : item->ts.epoch < cutoff) {
+            tags_update(obj, item->text, item->id, -1);
+            *move = item;
+            move = &item->next;
+            moved++;
+        } else {
+            *keep = item;
+            keep = &item->next;
+            kept++;
+            if (item->ts.epoch < oldest) oldest = item->ts.epoch;
+            hashset_add(&hot, item->hash);
+        }
+    }
+    *keep = NULL;
+    *move = NULL;
+
+    // History older than every item kept describes only cold items; in the
+    // second of the oldest kept item (a bulk import) so do entries whose
+    // text no kept item has
+    int64_t boundary = kept ? oldest : obj->retain_days ? cutoff : INT64_MAX;
+    HistoryEntry **cut = &obj->history;
+    for (HistoryEntry *h = obj->history; h; h = h->next) {
+        if (h->ts.epoch > boundary || (h->ts.epoch == boundary && hashset_contains(&hot, text_hash(h->text)))) {
+            cut = &h->next;
+        }
+    }
+    free(hot.keys);
+    free(hot.counts);
+    part->history = *cut;
+    *cut = NULL;
+    if (part->history) {
+        // Checkpoint positions count from the oldest entry
+        free_checkpoints(obj->checkpoints);
+        obj->checkpoints = NULL;
+    }
+
+    hashset_free(obj->hashes);
+    obj->hashes = NULL;
+    termstats_free(obj->terms);
+    obj->terms = NULL;
+    free(obj->by_id);
+    obj->by_id = NULL;
+    obj->cold += moved;
+    obj->dirty = 1;
+    return part;
+}
+
+/* Move what the objects' retention policies no longer keep hot to the cold
+ * tier, before a save writes the hot tier. Normally the parts are appended;
+ * a project with its tier folded in rewrites the whole tier, with the
+ * sections of objects the load left as stubs carried over. Returns 0 if the
+ * cold tier could not be written. */
+static int apply_retention(const char *project_file, Project *proj) {
+    Project *cold = calloc(1, sizeof(Project));
+    if (!cold) return 0;
+    snprintf(cold->name, MAX_TEXT, "%s", proj->name);
+    cold->index = proj->index;
+    Object **tail = &cold->objects;
+    int64_t now = (int64_t)time(NULL);
+    for (Object *obj = proj->objects; obj; obj = obj->next) {
+        if (obj->stub) continue;
+        Object *part = retain_split(obj, now, proj->cold_folded);
+        if (!part) continue;
+        *tail = part;
+        tail = &part->next;
+    }
+
+    char path[MAX_PATH];
+    cold_path(project_file, proj->index, path);
+    int ok = 1;
+    if (proj->cold_folded) {
+        *tail = proj->cold_stubs;  // lent for the write
+        if (cold->objects) {
+            char dir[MAX_PATH];
+            snprintf(dir, MAX_PATH, "%s", path);
+            char *slash = strrchr(dir, '/');
+            if (slash) *slash = '\0';
+            ok = write_file_atomic(slash ? dir : ".", slash ? slash + 1 : path, emit_cold, cold);
+        } else {
+            remove(path);
+        }
+        *tail = NULL;
+    } else if (cold->objects) {
+        FILE *f = fopen(path, "ab");
+        ok = f && fseek(f, 0, SEEK_END) == 0 && write_cold(f, cold, ftell(f) == 0);
+        if (f && fclose(f) != 0) ok = 0;
+    }
+    free_project(cold);
+    if (!ok) print_error("Cannot write the cold tier '%s'\n", path);
+    return ok;
+}
+
+/* Put one cold section's items and history behind obj's. Items also found
+ * hot, left by a save that was interrupted after appending, are dropped. */
+static void fold_cold_part(Object *obj, Object *part) {
+    int hot = obj->items != NULL;
+    Item **items = &obj->items;
+    while (*items) items = &(*items)->next;
+    while (part->items) {
+        Item *item = part->items;
+        part->items = item->next;
+        if (hot && find_item_by_id(obj, item->id)) {
+            free(item);
+            continue;
+        }
+        tags_update(obj, item->text, item->id, 1);
+        item->next = NULL;
+        *items = item;
+        items = &item->next;
+    }
+    HistoryEntry **history = &obj->history;
+    while (*history) history = &(*history)->next;
+    *history = part->history;
+    part->history = NULL;
+    free_checkpoints(obj->checkpoints);
+    obj->checkpoints = NULL;
+    hashset_free(obj->hashes);
+    obj->hashes = NULL;
+    termstats_free(obj->terms);
+    obj->terms = NULL;
+    free(obj->by_id);
+    obj->by_id = NULL;
+    obj->cold = 0;
+}
+
+/* Read a project's cold tier into it: each object's cold items and history
+ * go after its hot ones (sections load newest first). */
+static void fold_cold_tier(const char *project_file, Project *proj) {
+    if (proj->cold_folded) return;
+    proj->cold_folded = 1;
+    char path[MAX_PATH];
+    cold_path(project_file, proj->index, path);
+    Project *cold = access(path, F_OK) == 0 ? load_project_disk(path) : NULL;
+    if (!cold) return;
+    Object **stubs = &proj->cold_stubs;
+    while (cold->objects) {
+        Object *part = cold->objects;
+        cold->objects = part->next;
+        part->next = NULL;
+        Object *obj = find_object(proj, part->name);
+        if (obj && obj->stub) {
+            // Kept whole for the next save; sections of deleted objects are dropped
+            *stubs = part;
+            stubs = &part->next;
+            continue;
+        }
+        if (obj) fold_cold_part(obj, part);
+        free_project_objects(part);
+    }
+    free_project(cold);
+}
+
+// ===== Resident Project Cache ===== //
+// Only enabled inside funknotesd. Read-only paths (catalog lookups, show,
+// search, projects) borrow a cached parse that is revalidated against the
+// file's stat data; commands that mutate a project keep loading a private
+// copy with load_project_file() and the next stat picks up their write.
+
+typedef struct CachedProject {
+    char path[MAX_PATH];
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    Project *proj;
+    struct CachedProject *next;
+} CachedProject;
+
+static int g_cache_enabled = 0;
+static CachedProject *g_cache = NULL;
+
+static void cache_drop(CachedProject **link) {
+    CachedProject *c = *link;
+    *link = c->next;
+    free_project(c->proj);
+    free(c);
+}
+
+/* Load a project for reading. Must be paired with release_project(). */
+Project* load_project_shared(const char *filename) {
+    if (!g_cache_enabled || g_cold) return load_project_file(filename);
+
+    struct stat st;
+    CachedProject **link = &g_cache;
+    while (*link && strcmp((*link)->path, filename) != 0) link = &(*link)->next;
+
+    if (stat(filename, &st) != 0) {
+        if (*link) cache_drop(link);
+        return NULL;
+    }
+
+    CachedProject *c = *link;
+    if (c && c->dev == st.st_dev && c->ino == st.st_ino && c->size == st.st_size &&
+        c->mtime.tv_sec == ST_MTIM(st).tv_sec && c->mtime.tv_nsec == ST_MTIM(st).tv_nsec) {
+        return c->proj;
+    }
+    if (c) cache_drop(link);
+
+    Project *proj = load_project_file(filename);
+    if (!proj) return NULL;
+    c = calloc(1, sizeof(CachedProject));
+    if (!c) return proj;
+    snprintf(c->path, MAX_PATH, "%s", filename);
+    c->dev = st.st_dev;
+    c->ino = st.st_ino;
+    c->size = st.st_size;
+    c->mtime = ST_MTIM(st);
+    c->proj = proj;
+    c->next = g_cache;
+    g_cache = c;
+    return proj;
+}
+
+/* Load a project for listing or lookup by name/index: the resident copy
+ * when the daemon has one, else just the header. Pair with release_project(). */
+Project* load_project_overview(const char *filename) {
+    if (g_cache_enabled && !g_cold) return load_project_shared(filename);
+    return load_project_header(filename);
+}
+
+/* Release a project obtained from load_project_shared() */
+void release_project(Project *proj) {
+    if (!proj) return;
+    if (g_cache_enabled) {
+        for (CachedProject *c = g_cache; c; c = c->next) {
+            if (c->proj == proj) return;
+        }
+    }
+    free_project(proj);
+}
+
+/* Create new project */
+void new_project(Config *cfg, const char *name) {
+    if (strcmp(name, "projects") == 0) {
+        print_error("Can't create project named 'projects' (protected name)\n");
+        return;
+    }
+    int primary, counter;
+    load_config_data(cfg, &primary, &counter);
+    
+    counter++;
+    
+    char project_file[MAX_PATH];
+    snprintf(project_file, MAX_PATH, "%s/%d_%s.txt", 
+             cfg->projects_dir, counter, name);
+    
+    Project *proj = calloc(1, sizeof(Project));
+    strncpy(proj->name, name, MAX_TEXT - 1);
+    proj->name[MAX_TEXT - 1] = '\0';
+    proj->index = counter;
+    
+    if (save_project_file(project_file, proj)) {
+        printf("Created project '%s' with index %d\n", name, counter);
+    } else {
+        print_error("Error creating project file\n");
+    }
+    
+    free_project(proj);
+    save_config_data(cfg, primary, counter);
+}
+
+/* Get project file by index */
+int get_project_file(Config *cfg, int index, char *filename) {
+    DIR *dir = opendir(cfg->projects_dir);
+    if (!dir) return 0;
+    
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (is_project_entry(cfg->projects_dir, entry->d_name)) {
+            char path[MAX_PATH];
+            snprintf(path, MAX_PATH, "%s/%s", cfg->projects_dir, entry->d_name);
+            
+            Project *proj = load_project_overview(path);
+            if (proj) {
+                if (proj->index == index) {
+                    strcpy(filename, path);
+                    release_project(proj);
+                    closedir(dir);
+                    return 1;
+                }
+                release_project(proj);
+            }
+        }
+    }
+    
+    closedir(dir);
+    return 0;
+}
+
+/* Get project file by name or numeric identifier. If ident is numeric, treat as index.
+ * On success fills `filename` with the path and sets *out_index (if non-NULL).
+ * Returns 1 on found, 0 otherwise.
+ */
+int get_project_file_by_ident(Config *cfg, const char *ident, char *filename, int *out_index) {
+    // Check if ident is a number (all digits)
+    int is_number = 1;
+    for (size_t i = 0; i < strlen(ident); ++i) {
+        if (ident[i] < '0' || ident[i] > '9') { is_number = 0; break; }
+    }
+
+    if (is_number) {
+        int idx = atoi(ident);
+        if (out_index) *out_index = idx;
+        return get_project_file(cfg, idx, filename);
+    }
+
+    DIR *dir = opendir(cfg->projects_dir);
+    if (!dir) return 0;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (is_project_entry(cfg->projects_dir, entry->d_name)) {
+            char path[MAX_PATH];
+            snprintf(path, MAX_PATH, "%s/%s", cfg->projects_dir, entry->d_name);
+
+            Project *proj = load_project_overview(path);
+            if (proj) {
+                if (strcmp(proj->name, ident) == 0) {
+                    if (out_index) *out_index = proj->index;
+                    strcpy(filename, path);
+                    release_project(proj);
+                    closedir(dir);
+                    return 1;
+                }
+                release_project(proj);
+            }
+        }
+    }
+
+    closedir(dir);
+    return 0;
+}
+
+/* Find object in project */
+Object* find_object(Project *proj, const char *object_name) {
+    Object *obj = proj->objects;
+    while (obj) {
+        if (strcmp(obj->name, object_name) == 0) return obj;
+        obj = obj->next;
+    }
+    return NULL;
+}
+
+/* Content-hash set of an object's items, built from the stored hashes on
+ * first use and kept current by the add/delete paths afterwards. */
+HashSet* object_hashes(Object *obj) {
+    if (obj->hashes) return obj->hashes;
+    obj->hashes = calloc(1, sizeof(HashSet));
+    if (!obj->hashes) return NULL;
+    for (Item *item = obj->items; item; item = item->next) {
+        hashset_add(obj->hashes, item->hash);
+    }
+    return obj->hashes;
+}
+
+/* Duplicate handling for add, import and merge */
+enum { DEDUPE_OFF, DEDUPE_COUNT, DEDUPE_SKIP };
+
+/* Remove every occurrence of a boolean flag from argv; returns whether it was present */
+int extract_flag(int *argc, char **argv, const char *flag) {
+    int found = 0, out = 0;
+    for (int i = 0; i < *argc; i++) {
+        if (strcmp(argv[i], flag) == 0) found = 1;
+        else argv[out++] = argv[i];
+    }
+    *argc = out;
+    argv[out] = NULL;
+    return found;
+}
+
+/* Remove `flag VALUE` from argv and return VALUE (NULL if absent) */
+char* extract_value(int *argc, char **argv, const char *flag) {
+    char *value = NULL;
+    int out = 0;
+    for (int i = 0; i < *argc; i++) {
+        if (strcmp(argv[i], flag) == 0 && i + 1 < *argc) value = argv[++i];
+        else argv[out++] = argv[i];
+    }
+    *argc = out;
+    argv[out] = NULL;
+    return value;
+}
+
+/* Strip --cold for the commands that read cold items: anywhere in show,
+ * search, tags and diff, and right after the #id of edit and delete (so
+ * item text is left alone). Every other command keeps its argv untouched.
+ */
+static int extract_cold_flag(int *argc, char **argv) {
+    if (*argc < 2) return 0;
+    const char *cmd = argv[1];
+    if (strcmp(cmd, "show") == 0 || strcmp(cmd, "search") == 0 ||
+        strcmp(cmd, "tags") == 0 || strcmp(cmd, "diff") == 0) {
+        return extract_flag(argc, argv, "--cold");
+    }
+    if ((strcmp(cmd, "edit") == 0 || strcmp(cmd, "delete") == 0) && *argc >= 5 &&
+        argv[3][0] == '#' && strcmp(argv[4], "--cold") == 0) {
+        for (int i = 4; i + 1 < *argc; i++) argv[i] = argv[i + 1];
+        argv[--*argc] = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+/* Strip --dedupe[=skip|count|off] from argv in place. Bare --dedupe means
+ * skip; without the option the policy is count (add, but report duplicates).
+ * Returns 0 on an unknown policy.
+ */
+int extract_dedupe_policy(int *argc, char **argv, int *policy) {
+    *policy = DEDUPE_COUNT;
+    int out = 0;
+    for (int i = 0; i < *argc; i++) {
+        if (strncmp(argv[i], "--dedupe", 8) != 0 || (argv[i][8] != '\0' && argv[i][8] != '=')) {
+            argv[out++] = argv[i];
+            continue;
+        }
+        const char *v = argv[i][8] == '=' ? argv[i] + 9 : "skip";
+        if (strcmp(v, "skip") == 0) *policy = DEDUPE_SKIP;
+        else if (strcmp(v, "count") == 0) *policy = DEDUPE_COUNT;
+        else if (strcmp(v, "off") == 0) *policy = DEDUPE_OFF;
+        else {
+            printf("Unknown dedupe policy '%s' (use skip, count or off)\n", v);
+            return 0;
+        }
+    }
+    *argc = out;
+    argv[out] = NULL;
+    return 1;
+}
+
+/* Count items in object */
+int count_items(Object *obj) {
+    int count = 0;
+    Item *item = obj->items;
+    while (item) {
+        count++;
+        item = item->next;
+    }
+    return count;
+}
+
+/* Get item by 1-based index (returns NULL if not found) */
+Item* get_item_by_index(Object *obj, int index) {
+    // Count total items first
+    int total = count_items(obj);
+    if (index < 1 || index > total) return NULL;
+    
+    // Items are stored in reverse order, so we need to traverse from end
+    int target = total - index;  // Convert to 0-based from start
+    Item *item = obj->items;
+    for (int i = 0; i < target; i++) {
+        if (!item) return NULL;
+        item = item->next;
+    }
+    return item;
+}
+
+/* Get all items as array (caller must free) */
+Item** get_items_array(Object *obj, int *count) {
+    *count = count_items(obj);
+    if (*count == 0) return NULL;
+    
+    Item **items = malloc(sizeof(Item*) * (*count));
+    Item *item = obj->items;
+    for (int i = *count - 1; i >= 0; i--) {
+        items[i] = item;
+        item = item->next;
+    }
+    return items;
+}
+
+/* First position in a time-ordered items array whose epoch is >= t */
+static int items_lower_bound(Item **items, int count, int64_t t) {
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (items[mid]->ts.epoch < t) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* Is the item inside the time range? (NULL range matches everything) */
+int item_in_range(const Item *item, const TimeRange *range) {
+    if (!range) return 1;
+    return item->ts.epoch >= range->since && item->ts.epoch < range->until;
+}
+
+/* Narrow an items array (from get_items_array) to the [*first, *last) slice that
+ * can fall inside `range`. Items are appended in time order, so the bounds are
+ * found by binary search; objects whose order was broken (e.g. by a merge) fall
+ * back to the whole array and callers filter with item_in_range().
+ */
+void items_range_bounds(Object *obj, Item **items, int count, const TimeRange *range, int *first, int *last) {
+    *first = 0;
+    *last = count;
+    if (!range || obj->unordered) return;
+    if (range->since != INT64_MIN) *first = items_lower_bound(items, count, range->since);
+    if (range->until != INT64_MAX) *last = items_lower_bound(items, count, range->until);
+    if (*last < *first) *last = *first;
+}
+
+// show --ids: label items with their stable id instead of their position
+static int g_show_ids = 0;
+
+/* Buffer one item as "N. [timestamp] text" ("#id. ..." under --ids) */
+static void out_item(const Item *item, int pos) {
+    if (g_show_ids) {
+        out_char('#');
+        out_int(item->id);
+    } else {
+        out_int(pos);
+    }
+    out_bytes(". [", 3);
+    out_timestamp(&item->ts);
+    out_bytes("] ", 2);
+    out_str(item->text);
+    out_char('\n');
+}
+
+/* Print an object's items as "N. [timestamp] text" (N is the 1-based position) */
+void print_items(Object *obj, const TimeRange *range) {
+    int count;
+    Item **items = get_items_array(obj, &count);
+    int first, last;
+    items_range_bounds(obj, items, count, range, &first, &last);
+    out_begin();
+    for (int i = first; i < last && out_ok(); i++) {
+        if (!item_in_range(items[i], range)) continue;
+        out_item(items[i], i + 1);
+    }
+    out_flush();
+    free(items);
+}
+
+// ===== Text Matching ===== //
+
+enum { MATCH_KEYWORDS, MATCH_REGEX, MATCH_FUZZY };
+
+/* A compiled search pattern. Built once per command and reused for every
+ * item; `literal` is a string every match must contain, checked with a cheap
+ * case-insensitive substring scan before running the full matcher. */
+typedef struct {
+    int mode;
+    int kwc;            // MATCH_KEYWORDS: all keywords must appear
+    char **kws;
+    char *pattern;      // MATCH_REGEX / MATCH_FUZZY (owned)
+    regex_t re;
+    char literal[64];
+} Matcher;
+
+/* Extract the literal run a regex must start with (after an optional '^').
+ * Stops at the first metacharacter; an atom followed by a quantifier that
+ * allows zero repetitions is not required and ends the run before it.
+ * Patterns with alternation get no prefix, since no single literal is required.
+ */
+static void regex_literal_prefix(const char *pat, char *out, size_t size) {
+    size_t n = 0;
+    out[0] = '\0';
+    if (strchr(pat, '|')) return;
+    const char *p = pat;
+    if (*p == '^') p++;
+    while (*p && n < size - 1) {
+        char c;
+        const char *next;
+        if (*p == '\\') {
+            // Escaped punctuation is literal; \w, \1 etc. are not
+            if (!p[1] || (p[1] >= '0' && p[1] <= '9') || (p[1] >= 'a' && p[1] <= 'z') || (p[1] >= 'A' && p[1] <= 'Z')) break;
+            c = p[1];
+            next = p + 2;
+        } else if (strchr(".[]()*+?{}^$", *p)) {
+            break;
+        } else {
+            c = *p;
+            next = p + 1;
+        }
+        if (*next == '*' || *next == '?' || *next == '{') break;
+        out[n++] = c;
+        p = next;
+        if (*next == '+') break;
+    }
+    out[n] = '\0';
+}
+
+/* Keyword matcher over existing argv strings (AND, case-insensitive substrings) */
+void matcher_init_keywords(Matcher *m, int kwc, char **kws) {
+    memset(m, 0, sizeof(*m));
+    m->mode = MATCH_KEYWORDS;
+    m->kwc = kwc;
+    m->kws = kws;
+}
+
+/* Compile a regex (POSIX extended, case-insensitive) or fuzzy pattern.
+ * Returns 1 on success; prints the error and returns 0 otherwise.
+ */
+int matcher_compile(Matcher *m, int mode, const char *pattern) {
+    memset(m, 0, sizeof(*m));
+    m->mode = mode;
+    m->pattern = strdup(pattern);
+    if (!m->pattern) return 0;
+
+    if (mode == MATCH_REGEX) {
+        int rc = regcomp(&m->re, pattern, REG_EXTENDED | REG_ICASE | REG_NOSUB);
+        if (rc != 0) {
+            char err[256];
+            regerror(rc, &m->re, err, sizeof(err));
+            print_error("Invalid regex '%s': %s\n", pattern, err);
+            free(m->pattern);
+            m->pattern = NULL;
+            return 0;
+        }
+        regex_literal_prefix(pattern, m->literal, sizeof(m->literal));
+    } else {
+        // Fuzzy: every match contains the first pattern character
+        m->literal[0] = pattern[0];
+        m->literal[1] = '\0';
+    }
+    return 1;
+}
+
+void matcher_free(Matcher *m) {
+    if (m->mode == MATCH_REGEX && m->pattern) regfree(&m->re);
+    free(m->pattern);
+    m->pattern = NULL;
+}
+
+/* Case-insensitive ordered subsequence test */
+static int fuzzy_match(const char *text, const char *pattern) {
+    const unsigned char *p = (const unsigned char *)pattern;
+    for (const unsigned char *t = (const unsigned char *)text; *t && *p; t++) {
+        if (tolower(*t) == tolower(*p)) p++;
+    }
+    return *p == '\0';
+}
+
+/* Does the text match? */
+int matcher_match(const Matcher *m, const char *text) {
+    if (m->mode == MATCH_KEYWORDS) {
+        for (int k = 0; k < m->kwc; k++) {
+            if (!strcasestr(text, m->kws[k])) return 0;
+        }
+        return 1;
+    }
+    if (m->literal[0] && !strcasestr(text, m->literal)) return 0;
+    if (m->mode == MATCH_REGEX) return regexec(&m->re, text, 0, NULL, 0) == 0;
+    return fuzzy_match(text, m->pattern);
+}
+
+/* Could proj hold a match? Only its trigram filter is consulted, so this
+ * works on a header-only load. Fuzzy patterns and keywords shorter than three
+ * characters are never ruled out. */
+int project_may_match(const Project *proj, const Matcher *m) {
+    if (!proj->has_filter) return 1;
+    if (m->mode == MATCH_KEYWORDS) {
+        for (int k = 0; k < m->kwc; k++) {
+            if (!filter_may_contain(proj->filter, m->kws[k])) return 0;
+        }
+        return 1;
+    }
+    return m->mode == MATCH_FUZZY || filter_may_contain(proj->filter, m->literal);
+}
+
+/* Strip a --regex or --fuzzy flag from argv in place and return the mode
+ * it selects (MATCH_KEYWORDS when absent). */
+int extract_match_mode(int *argc, char **argv) {
+    int mode = MATCH_KEYWORDS;
+    int out = 0;
+    for (int i = 0; i < *argc; i++) {
+        if (strcmp(argv[i], "--regex") == 0) mode = MATCH_REGEX;
+        else if (strcmp(argv[i], "--fuzzy") == 0) mode = MATCH_FUZZY;
+        else argv[out++] = argv[i];
+    }
+    *argc = out;
+    argv[out] = NULL;
+    return mode;
+}
+
+// ===== Ranked Search ===== //
+// search --top N scores every match with BM25 over the project's term
+// statistics plus a recency boost, keeping only the best N in a min-heap.
+
+#define BM25_K1 1.2
+#define BM25_B 0.75
+#define RECENCY_WEIGHT 1.0
+#define RECENCY_HALF_LIFE (30 * 86400.0)   // boost halves after this age
+#define MAX_QUERY_TERMS 16
+
+/* Term statistics of obj, built on first use */
+TermStats* object_terms(Object *obj) {
+    if (obj->terms) return obj->terms;
+    obj->terms = calloc(1, sizeof(TermStats));
+    if (!obj->terms) return NULL;
+    for (Item *item = obj->items; item; item = item->next) {
+        termstats_update(obj->terms, item->text, 1);
+    }
+    return obj->terms;
+}
+
+/* Natural log for x > 0 without libm: scale into [1, 2) by powers of two,
+ * then the atanh series ln(x) = 2(y + y^3/3 + y^5/5 ...), y = (x-1)/(x+1). */
+static double ln_approx(double x) {
+    int k = 0;
+    while (x >= 2.0) { x /= 2.0; k++; }
+    while (x < 1.0) { x *= 2.0; k--; }
+    double y = (x - 1.0) / (x + 1.0), y2 = y * y, term = y, sum = 0.0;
+    for (int i = 1; i < 40; i += 2) {
+        sum += term / i;
+        term *= y2;
+    }
+    return 2.0 * sum + k * 0.69314718055994530942;
+}
+
+typedef struct {
+    int n;
+    uint64_t terms[MAX_QUERY_TERMS];
+    double idf[MAX_QUERY_TERMS];
+    double avgdl;
+    int64_t now;
+} RankQuery;
+
+/* Query words come from the keywords (or the regex/fuzzy pattern); idf and
+ * average length use the statistics of every object in the project. */
+static void rank_query_init(RankQuery *q, const Matcher *m, Project *proj) {
+    memset(q, 0, sizeof(*q));
+    uint64_t words[MAX_QUERY_TERMS];
+    int count = 0;
+    if (m->mode == MATCH_KEYWORDS) {
+        for (int i = 0; i < m->kwc && count < MAX_QUERY_TERMS; i++) {
+            count += text_terms(m->kws[i], words + count, MAX_QUERY_TERMS - count);
+        }
+    } else {
+        count = text_terms(m->pattern, words, MAX_QUERY_TERMS);
+    }
+    for (int i = 0; i < count; i++) {
+        int seen = 0;
+        for (int j = 0; j < q->n && !seen; j++) seen = q->terms[j] == words[i];
+        if (!seen) q->terms[q->n++] = words[i];
+    }
+
+    long docs = 0, total = 0;
+    uint32_t df[MAX_QUERY_TERMS] = {0};
+    for (Object *obj = proj->objects; obj; obj = obj->next) {
+        TermStats *ts = object_terms(obj);
+        if (!ts) continue;
+        docs += ts->docs;
+        total += ts->words;
+        for (int i = 0; i < q->n; i++) df[i] += hashset_count(&ts->df, q->terms[i]);
+    }
+    for (int i = 0; i < q->n; i++) {
+        q->idf[i] = ln_approx(1.0 + (docs - df[i] + 0.5) / (df[i] + 0.5));
+    }
+    q->avgdl = docs ? (double)total / docs : 1.0;
+    if (q->avgdl <= 0) q->avgdl = 1.0;
+    q->now = (int64_t)time(NULL);
+}
+
+static double rank_score(const RankQuery *q, const Item *item) {
+    uint64_t words[MAX_ITEM_TERMS];
+    int dl = text_terms(item->text, words, MAX_ITEM_TERMS);
+    double score = 0.0;
+    for (int i = 0; i < q->n; i++) {
+        int tf = 0;
+        for (int j = 0; j < dl; j++) tf += words[j] == q->terms[i];
+        if (!tf) continue;
+        score += q->idf[i] * tf * (BM25_K1 + 1) /
+                 (tf + BM25_K1 * (1 - BM25_B + BM25_B * dl / q->avgdl));
+    }
+    double age = (double)(q->now - item->ts.epoch);
+    if (age < 0) age = 0;
+    return score + RECENCY_WEIGHT * RECENCY_HALF_LIFE / (RECENCY_HALF_LIFE + age);
+}
+
+typedef struct {
+    double score;
+    Item *item;
+    Object *obj;
+    const char *project;  // search --all: name of the item's project
+} Ranked;
+
+/* Heap order: lower score first, older item first on ties */
+static int ranked_less(const Ranked *a, const Ranked *b) {
+    if (a->score != b->score) return a->score < b->score;
+    return a->item->ts.epoch < b->item->ts.epoch;
+}
+
+static void heap_sift_down(Ranked *heap, int n, int i) {
+    for (;;) {
+        int least = i, l = 2 * i + 1, r = l + 1;
+        if (l < n && ranked_less(&heap[l], &heap[least])) least = l;
+        if (r < n && ranked_less(&heap[r], &heap[least])) least = r;
+        if (least == i) return;
+        Ranked tmp = heap[i]; heap[i] = heap[least]; heap[least] = tmp;
+        i = least;
+    }
+}
+
+/* Keep the best `cap` entries seen so far in a min-heap of size *n */
+static void heap_offer(Ranked *heap, int *n, int cap, Ranked r) {
+    if (*n < cap) {
+        int i = (*n)++;
+        heap[i] = r;
+        while (i > 0 && ranked_less(&heap[i], &heap[(i - 1) / 2])) {
+            Ranked tmp = heap[i]; heap[i] = heap[(i - 1) / 2]; heap[(i - 1) / 2] = tmp;
+            i = (i - 1) / 2;
+        }
+    } else if (ranked_less(&heap[0], &r)) {
+        heap[0] = r;
+        heap_sift_down(heap, *n, 0);
+    }
+}
+
+/* Remove `top N` (--top N / --top=N) from argv. Returns 0 on a bad count. */
+int extract_top(int *argc, char **argv, int *top) {
+    *top = 0;
+    int out = 0;
+    for (int i = 0; i < *argc; i++) {
+        const char *value = NULL;
+        if (strcmp(argv[i], "--top") == 0 && i + 1 < *argc) value = argv[++i];
+        else if (strncmp(argv[i], "--top=", 6) == 0) value = argv[i] + 6;
+        else { argv[out++] = argv[i]; continue; }
+        *top = atoi(value);
+        if (*top <= 0) {
+            print_error("Invalid --top count '%s'\n", value);
+            return 0;
+        }
+    }
+    *argc = out;
+    argv[out] = NULL;
+    return 1;
+}
+
+/* Add object to project */
+void add_object(Config *cfg, const char *object_name) {
+    int primary, counter;
+    load_config_data(cfg, &primary, &counter);
+    
+    if (primary < 0) {
+        print_error("No primary project set. Use 'funknotes primary <project>' first.\n");
+        return;
+    }
+    
+    char project_file[MAX_PATH];
+    if (!get_project_file(cfg, primary, project_file)) {
+        print_error("Primary project not found\n");
+        return;
+    }
+    
+    Project *proj = load_project_for_object(project_file, object_name);
+    if (!proj) return;
+    
+    if (find_object(proj, object_name)) {
+        printf("Object '%s' already exists\n", object_name);
+        free_project(proj);
+        return;
+    }
+    
+    Object *obj = calloc(1, sizeof(Object));
+    strncpy(obj->name, object_name, MAX_TEXT - 1);
+    obj->name[MAX_TEXT - 1] = '\0';
+    touch_object(obj);
+    obj->next = proj->objects;
+    proj->objects = obj;
+    
+    if (save_project_file(project_file, proj)) {
+        printf("Created object '%s' in project '%s'\n", 
+               object_name, proj->name);
+    }
+    
+    free_project(proj);
+}
+
+#define COMPACT_MIN_RECORDS 64
+
+/* Append one journal line to a file */
+static int append_record(const char *path, const char *record) {
+    FILE *f = fopen(path, "a");
+    if (!f) return 0;
+    fputs(record, f);
+    return fclose(f) == 0;
+}
+
+/* Hold readers off a file that a journal append changes in place (they
+ * wait in lock_for_read); returns the fd to close when done, or -1 */
+static int lock_for_append(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    while (flock(fd, LOCK_EX) != 0) {
+        if (errno != EINTR) { close(fd); return -1; }
+    }
+    return fd;
+}
+
+/* Can checksummed journal records be appended to path? Not after journal
+ * records written without a crc= line: the new line would cover them too. */
+static int journal_tail_checked(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    char buf[MAX_LINE + 1];
+    long size = fseek(f, 0, SEEK_END) == 0 ? ftell(f) : -1;
+    long start = size > MAX_LINE ? size - MAX_LINE : 0;
+    size_t n = size >= 0 && fseek(f, start, SEEK_SET) == 0 ? fread(buf, 1, MAX_LINE, f) : 0;
+    fclose(f);
+    if (size < 0) return 0;
+    while (n > 0 && buf[n - 1] == '\n') n--;
+    buf[n] = '\0';
+    char *last = memrchr(buf, '\n', n);
+    if (!last && start > 0) return 0;  // a line longer than any record
+    return !is_journal_line(last ? last + 1 : buf);
+}
+
+/* Offsets of the fixed-width fields of obj's summary= and rollup= lines in
+ * a plain project file's header; -1 where there is none to patch */
+static void find_summary_fields(const char *path, const char *name, long *summary, long *rollup) {
+    *summary = *rollup = -1;
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+    char line[MAX_LINE];
+    long offset = 0;
+    size_t name_len = strlen(name);
+    while ((*summary < 0 || *rollup < 0) && fgets(line, sizeof(line), f)) {
+        size_t len = strlen(line);
+        if (strncmp(line, "[object ", 8) == 0) break;
+        if (strncmp(line, "summary=", 8) == 0 && len == 8 + SUMMARY_FIELDS_LEN + 1 + name_len + 1 &&
+            line[8 + 10] == '|' && line[8 + SUMMARY_FIELDS_LEN] == '|' &&
+            strncmp(line + 8 + SUMMARY_FIELDS_LEN + 1, name, name_len) == 0) {
+            *summary = offset + 8;
+        } else if (strncmp(line, "rollup=", 7) == 0 && len == 7 + ROLLUP_FIELDS_LEN + 1 + name_len + 1 &&
+                   line[7 + ROLLUP_FIELDS_LEN] == '|' &&
+                   strncmp(line + 7 + ROLLUP_FIELDS_LEN + 1, name, name_len) == 0) {
+            *rollup = offset + 7;
+        }
+        offset += (long)len;
+    }
+    fclose(f);
+}
+
+/* Offset of the hex digits of a plain project file's filter= line, or -1 */
+static long find_filter_field(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[MAX_LINE];
+    long offset = 0, found = -1;
+    while (found < 0 && fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "[object ", 8) == 0) break;
+        if (strncmp(line, "filter=", 7) == 0 && strlen(line) == 7 + FILTER_HEX + 1) found = offset + 7;
+        offset += (long)strlen(line);
+    }
+    fclose(f);
+    return found;
+}
+
+/* Persist id-addressed changes already applied to proj in memory: append
+ * `records` (`count` journal lines) to the project file (the object's own
+ * file in the directory layout) and refresh obj's summary and rollup (and
+ * the project's trigram filter, which edits may have added to) in place.
+ * The records are closed by their crc= line. Archived projects, headers
+ * from before fixed-width summaries and journals from before checksums are
+ * rewritten in full instead. So is a journal that would reach
+ * COMPACT_MIN_RECORDS and a quarter of the items loaded: that rewrite is
+ * the compaction that folds the tombstones away. The append itself is
+ * constant work past one header scan; the caller's load still parses the
+ * object (the whole file in the single-file layout). Unlike saves it
+ * changes the live file, so it holds an exclusive flock() on it until the
+ * header is patched and readers never see half a record.
+ */
+int journal_append(const char *project_file, Project *proj, Object *obj, const char *records, int count) {
+    obj->item_count = count_items(obj);
+    if (g_batch_active) return save_project_file(project_file, proj);  // folded into the batch's one write
+    if (proj->cold_folded) return save_project_file(project_file, proj);  // the record may be for a cold item
+
+    // Totals kept by the loader: no walk over the other objects' items
+    int journal = proj->journal_count + count;
+    if (journal >= COMPACT_MIN_RECORDS && journal * 4 >= proj->loaded_items) {
+        obj->dirty = 1;
+        return save_project_file(project_file, proj);
+    }
+
+    // The records go out in one append, closed by their crc= line
+    size_t records_len = strlen(records);
+    char *block = malloc(records_len + 16);
+    if (!block) return 0;
+    memcpy(block, records, records_len);
+    snprintf(block + records_len, 16, "crc=%08x\n", crc32c(0, records, records_len));
+
+    int ok;
+    if (is_directory(project_file)) {
+        char path[MAX_PATH];
+        snprintf(path, MAX_PATH, "%s/%d.txt", project_file, obj->shard_id);
+        int lock = obj->shard_id > 0 && journal_tail_checked(path) ? lock_for_append(path) : -1;
+        int appended = lock >= 0 && append_record(path, block);
+        if (lock >= 0) close(lock);
+        if (!appended) {
+            ok = save_project_file(project_file, proj);
+        } else {
+            obj->dirty = 0;
+            ok = save_project_dir(project_file, proj, 0);  // rewrites just the manifest
+        }
+        free(block);
+        return ok;
+    }
+
+    long fields = -1, rollup = -1;
+    if (!is_compressed_path(project_file)) find_summary_fields(project_file, obj->name, &fields, &rollup);
+    // Tag postings are variable length: a change to them rewrites the header
+    if (fields < 0 || rollup < 0 || !obj->rollup.valid || (obj->tags && obj->tags->changed) ||
+        !journal_tail_checked(project_file)) {
+        free(block);
+        return save_project_file(project_file, proj);
+    }
+    long filter = proj->has_filter ? find_filter_field(project_file) : -1;
+    int lock = lock_for_append(project_file);
+    if (lock < 0) {
+        free(block);
+        return save_project_file(project_file, proj);
+    }
+    ok = append_record(project_file, block);
+    free(block);
+    if (!ok) {
+        close(lock);
+        return 0;
+    }
+
+    char buf[SUMMARY_FIELDS_LEN + 1];
+    format_summary_fields(obj, buf);
+    FILE *f = fopen(project_file, "r+");
+    if (!f) {
+        close(lock);
+        return 0;
+    }
+    ok = fseek(f, fields, SEEK_SET) == 0 && fwrite(buf, 1, SUMMARY_FIELDS_LEN, f) == SUMMARY_FIELDS_LEN;
+    if (ok) {
+        char rollup_buf[ROLLUP_FIELDS_LEN + 1];
+        format_rollup_fields(&obj->rollup, rollup_buf);
+        ok = fseek(f, rollup, SEEK_SET) == 0 && fwrite(rollup_buf, 1, ROLLUP_FIELDS_LEN, f) == ROLLUP_FIELDS_LEN;
+    }
+    if (ok && filter >= 0) {
+        char hex[FILTER_HEX + 1];
+        format_filter(proj, hex);
+        ok = fseek(f, filter, SEEK_SET) == 0 && fwrite(hex, 1, FILTER_HEX, f) == FILTER_HEX;
+    }
+    if (fclose(f) != 0) ok = 0;
+    close(lock);
+    return ok;
+}
+
+/* Journal a tombstone for each removed id (see journal_append) */
+int persist_tombstones(const char *project_file, Project *proj, Object *obj, const uint32_t *ids, int count) {
+    Timestamp now;
+    char ts[32];
+    get_timestamp(&now);
+    write_timestamp_field(&now, ts, sizeof(ts));
+    size_t cap = (size_t)count * (strlen(ts) + 24) + 1, len = 0;
+    char *records = malloc(cap);
+    if (!records) return 0;
+    records[0] = '\0';
+    for (int i = 0; i < count; i++) {
+        len += snprintf(records + len, cap - len, "tombstone=%u|%s\n", ids[i], ts);
+    }
+    int ok = journal_append(project_file, proj, obj, records, count);
+    free(records);
+    return ok;
+}
+
+/* Delete an object from the primary project */
+void delete_object(Config *cfg, const char *object_name) {
+    int primary, counter;
+    load_config_data(cfg, &primary, &counter);
+
+    if (primary < 0) {
+        print_error("No primary project set. Use 'funknotes primary <project>' first.\n");
+        return;
+    }
+
+    char project_file[MAX_PATH];
+    if (!get_project_file(cfg, primary, project_file)) {
+        print_error("Primary project not found\n");
+        return;
+    }
+
+    Project *proj = load_project_for_object(project_file, object_name);
+    if (!proj) return;
+
+    Object *obj = find_object(proj, object_name);
+    if (!obj) {
+        print_error("Object '%s' not found\n", object_name);
+        free_project(proj);
+        return;
+    }
+    if (obj->cold) fold_cold_tier(project_file, proj);  // the save then drops its cold sections
+
+    // Confirm deletion with user (default: No)
+    if (can_confirm()) {
+        printf("Delete object '%s'? y/N: ", object_name);
+        fflush(stdout);
+        if (!read_answer(0)) {
+            print_error("Deletion cancelled\n");
+            free_project(proj);
+            return;
+        }
+    } else {
+        // Non-interactive: do not delete by default
+        print_error("Non-interactive mode: deletion of object '%s' aborted\n", object_name);
+        free_project(proj);
+        return;
+    }
+
+    // Remove the object from linked list
+    if (proj->objects == obj) {
+        proj->objects = obj->next;
+    } else {
+        Object *prev = proj->objects;
+        while (prev && prev->next != obj) prev = prev->next;
+        if (prev) prev->next = obj->next;
+    }
+    
+    // Free object's items and history
+    Item *item = obj->items;
+    while (item) {
+        Item *next = item->next;
+        free(item);
+        item = next;
+    }
+    HistoryEntry *hist = obj->history;
+    while (hist) {
+        HistoryEntry *next = hist->next;
+        free(hist);
+        hist = next;
+    }
+    hashset_free(obj->hashes);
+    termstats_free(obj->terms);
+    tags_free(obj->tags);
+    free_checkpoints(obj->checkpoints);
+    free(obj->by_id);
+    free(obj);
+
+    if (save_project_file(project_file, proj)) {
+        printf("Deleted object '%s' from project\n", object_name);
+    }
+
+    free_project(proj);
+}
+
+/* Delete a project file by index */
+void delete_project(Config *cfg, const char *ident) {
+    int primary, counter;
+    load_config_data(cfg, &primary, &counter);
+
+    char project_file[MAX_PATH];
+    int proj_idx = -1;
+    if (!get_project_file_by_ident(cfg, ident, project_file, &proj_idx)) {
+        print_error("Project '%s' not found\n", ident);
+        return;
+    }
+
+    // Confirm before removing the file
+    printf("Delete project '%s' (index %d)? y/N: ", ident, proj_idx);
+    fflush(stdout);
+    if (!read_answer(0)) {
+        print_error("Deletion cancelled\n");
+        return;
+    }
+    // Remove the file (or project directory) only if confirmed
+    if (remove_project_path(project_file) == 0) {
+        char cold[MAX_PATH];
+        cold_path(project_file, proj_idx, cold);
+        remove(cold);
+        printf("Deleted project '%s' (index %d)\n", ident, proj_idx);
+
+        // If deleted project was primary, unset primary
+        if (primary == proj_idx) {
+            save_config_data(cfg, -1, counter);
+            printf("Primary project was deleted; primary unset.\n");
+        }
+    } else {
+        print_error("Failed to delete project file '%s'\n", project_file);
+    }
+}
+
+/* Delete a specific item (1-based index) from an object in the primary project */
+void delete_item_from_object(Config *cfg, const char *object_name, int item_index) {
+    int primary, counter;
+    load_config_data(cfg, &primary, &counter);
+
+    if (primary < 0) {
+        print_error("No primary project set. Use 'funknotes primary <project>' first.\n");
+        return;
+    }
+
+    char project_file[MAX_PATH];
+    if (!get_project_file(cfg, primary, project_file)) {
+        print_error("Primary project not found\n");
+        return;
+    }
+
+    Project *proj = load_project_for_object(project_file, object_name);
+    if (!proj) return;
+
+    Object *obj = find_object(proj, object_name);
+    if (!obj) {
+        print_error("Object '%s' not found\n", object_name);
+        free_project(proj);
+        return;
+    }
+
+    int item_count = count_items(obj);
+    if (item_index < 1 || item_index > item_count) {
+        print_error("Item %d not found in object '%s'\n", item_index, object_name);
+        free_project(proj);
+        return;
+    }
+
+    // Confirm deletion
+    if (can_confirm()) {
+        printf("Delete item %d from '%s'? y/N: ", item_index, object_name);
+        fflush(stdout);
+        if (!read_answer(0)) {
+            print_error("Deletion cancelled\n");
+            free_project(proj);
+            return;
+        }
+    } else {
+        print_error("Non-interactive mode: deletion of item %d aborted\n", item_index);
+        free_project(proj);
+        return;
+    }
+
+    // Get items as array to find the one to delete
+    int count;
+    Item **items = get_items_array(obj, &count);
+    Item *del_item = items[item_index - 1];
+    char del_text[MAX_TEXT];
+    strncpy(del_text, del_item->text, MAX_TEXT - 1);
+    del_text[MAX_TEXT - 1] = '\0';
+
+    // Remove item from linked list (items are in reverse order)
+    int target_idx = count - item_index;
+    if (target_idx == 0) {
+        // First item in list
+        obj->items = del_item->next;
+    } else {
+        Item *prev = obj->items;
+        for (int i = 0; i < target_idx - 1; i++) {
+            if (!prev) break;
+            prev = prev->next;
+        }
+        if (prev && prev->next) {
+            prev->next = prev->next->next;
+        }
+    }
+    hashset_remove(obj->hashes, del_item->hash);
+    termstats_update(obj->terms, del_item->text, -1);
+    tags_update(obj, del_item->text, del_item->id, -1);
+    uint32_t del_id = del_item->id;
+    free(del_item);
+    free(items);
+
+    // Add history entry
+    HistoryEntry *hist = calloc(1, sizeof(HistoryEntry));
+    strcpy(hist->action, "DELETE_ITEM");
+    get_timestamp(&hist->ts);
+    hist->id = del_id;
+    strncpy(hist->text, del_text, MAX_TEXT - 1);
+    hist->text[MAX_TEXT - 1] = '\0';
+    hist->next = obj->history;
+    obj->history = hist;
+    rollup_deleted(obj, del_text, &hist->ts);
+    touch_object(obj);
+
+    // Write back as a tombstone
+    if (persist_tombstones(project_file, proj, obj, &del_id, 1)) {
+        printf("Deleted item %d from '%s'\n", item_index, object_name);
+    } else {
+        print_error("Failed to write project file\n");
+    }
+
+    free_project(proj);
+}
+
+/* Remove the items whose 1-based positions are flagged in `mark` (one byte per
+ * item), recording a DELETE_ITEM history entry for each in position order.
+ * Their ids go to `ids` (if non-NULL, room for every item). Returns the
+ * number of items removed.
+ */
+int remove_marked_items(Object *obj, const char *mark, uint32_t *ids) {
+    int count;
+    Item **items = get_items_array(obj, &count);
+    if (!items) return 0;
+
+    Timestamp now;
+    get_timestamp(&now);
+
+    int removed = 0;
+    obj->items = NULL;
+    for (int i = 0; i < count; i++) {
+        Item *item = items[i];
+        if (!mark[i]) {
+            // Relink survivors newest-first, as the list is stored
+            item->next = obj->items;
+            obj->items = item;
+            continue;
+        }
+        HistoryEntry *hist = calloc(1, sizeof(HistoryEntry));
+        strcpy(hist->action, "DELETE_ITEM");
+        hist->ts = now;
+        hist->id = item->id;
+        strncpy(hist->text, item->text, MAX_TEXT - 1);
+        hist->text[MAX_TEXT - 1] = '\0';
+        hist->next = obj->history;
+        obj->history = hist;
+        rollup_deleted(obj, item->text, &now);
+        hashset_remove(obj->hashes, item->hash);
+        termstats_update(obj->terms, item->text, -1);
+        tags_update(obj, item->text, item->id, -1);
+        if (ids) ids[removed] = item->id;
+        free(item);
+        removed++;
+    }
+    free(items);
+    if (removed) touch_object(obj);
+    return removed;
+}
+
+/* Delete multiple items from an object. `index_list` can be comma-separated numbers and ranges like "1,3,5-7" */
+void delete_items_from_object(Config *cfg, const char *object_name, const char *index_list) {
+    int primary, counter;
+    load_config_data(cfg, &primary, &counter);
+
+    if (primary < 0) {
+        print_error("No primary project set. Use 'funknotes primary <project>' first.\n");
+        return;
+    }
+
+    char project_file[MAX_PATH];
+    if (!get_project_file(cfg, primary, project_file)) {
+        print_error("Primary project not found\n");
+        return;
+    }
+
+    // Parse index_list into a set of integers
+    int *indexes = NULL;
+    int idx_count = 0;
+
+    char *s = strdup(index_list);
+    char *tok = strtok(s, ",");
+    while (tok) {
+        // Trim
+        while (*tok == ' ') tok++;
+        char *dash = strchr(tok, '-');
+        if (dash) {
+            // range a-b
+            *dash = '\0';
+            int a = atoi(tok);
+            int b = atoi(dash + 1);
+            if (a <= 0 || b <= 0) { tok = strtok(NULL, ","); continue; }
+            if (a > b) { int t=a;a=b;b=t; }
+            for (int v = a; v <= b; ++v) {
+                indexes = realloc(indexes, sizeof(int) * (idx_count + 1));
+                indexes[idx_count++] = v;
+            }
+        } else {
+            int v = atoi(tok);
+            if (v > 0) {
+                indexes = realloc(indexes, sizeof(int) * (idx_count + 1));
+                indexes[idx_count++] = v;
+            }
+        }
+        tok = strtok(NULL, ",");
+    }
+    free(s);
+
+    if (idx_count == 0) {
+        printf("No valid indexes provided\n");
+        free(indexes);
+        return;
+    }
+
+    // Deduplicate and sort descending
+    // Simple O(n^2) dedupe since counts are expected small
+    for (int i = 0; i < idx_count; ++i) {
+        for (int j = i + 1; j < idx_count; ) {
+            if (indexes[i] == indexes[j]) {
+                // remove j
+                for (int k = j; k < idx_count - 1; ++k) indexes[k] = indexes[k+1];
+                idx_count--; indexes = realloc(indexes, sizeof(int) * idx_count);
+            } else j++;
+        }
+    }
+    // sort descending
+    for (int i = 0; i < idx_count; ++i) {
+        for (int j = i + 1; j < idx_count; ++j) {
+            if (indexes[j] > indexes[i]) { int t = indexes[i]; indexes[i] = indexes[j]; indexes[j] = t; }
+        }
+    }
+
+    // Confirm deletion
+    if (can_confirm()) {
+        printf("Delete items %s from '%s'? y/N: ", index_list, object_name);
+        fflush(stdout);
+        if (!read_answer(0)) {
+            print_error("Deletion cancelled\n");
+            free(indexes);
+            return;
+        }
+    } else {
+        print_error("Non-interactive mode: deletion aborted\n");
+        free(indexes);
+        return;
+    }
+
+    // Load project
+    Project *proj = load_project_for_object(project_file, object_name);
+    if (!proj) { free(indexes); return; }
+
+    Object *obj = find_object(proj, object_name);
+    if (!obj) {
+        print_error("Object '%s' not found\n", object_name);
+        free_project(proj); free(indexes); return;
+    }
+
+    int item_count = count_items(obj);
+    if (item_count == 0) {
+        printf("No items in object '%s'\n", object_name);
+        free_project(proj); free(indexes); return;
+    }
+
+    // Build mark array
+    char *mark = calloc(item_count, 1);
+    int any_marked = 0;
+    for (int i = 0; i < idx_count; ++i) {
+        int v = indexes[i];
+        if (v < 1 || v > item_count) continue;
+        mark[v-1] = 1; any_marked = 1;
+    }
+
+    if (!any_marked) {
+        printf("No matching items to delete\n");
+        free_project(proj); free(indexes); free(mark);
+        return;
+    }
+
+    uint32_t *ids = malloc(sizeof(uint32_t) * item_count);
+    int removed = remove_marked_items(obj, mark, ids);
+    free(mark);
+    free(indexes);
+
+    // Tombstones are appended; the file is only rewritten on compaction
+    int ok = persist_tombstones(project_file, proj, obj, ids, removed);
+    free(ids);
+    if (ok) {
+        printf("Deleted specified items from '%s'\n", object_name);
+    } else {
+        print_error("Failed to write project file\n");
+    }
+
+    free_project(proj);
+}
+
+/* Delete every item in an object of the primary project that matches `m`.
+ * Lists the matches and their count before asking for confirmation.
+ */
+void delete_items_matching(Config *cfg, const char *object_name, const Matcher *m) {
+    int primary, counter;
+    load_config_data(cfg, &primary, &counter);
+
+    if (primary < 0) {
+        print_error("No primary project set. Use 'funknotes primary <project>' first.\n");
+        return;
+    }
+
+    char project_file[MAX_PATH];
+    if (!get_project_file(cfg, primary, project_file)) {
+        print_error("Primary project not found\n");
+        return;
+    }
+
+    Project *proj = load_project_for_object(project_file, object_name);
+    if (!proj) return;
+
+    Object *obj = find_object(proj, object_name);
+    if (!obj) {
+        print_error("Object '%s' not found\n", object_name);
+        free_project(proj);
+        return;
+    }
+
+    int count;
+    Item **items = get_items_array(obj, &count);
+    char *mark = calloc(count ? count : 1, 1);
+    int matched = 0;
+    for (int i = 0; i < count; i++) {
+        if (!matcher_match(m, items[i]->text)) continue;
+        mark[i] = 1;
+        matched++;
+        char ts[32];
+        format_timestamp(&items[i]->ts, ts, sizeof(ts));
+        printf("%d. [%s] %s\n", i + 1, ts, items[i]->text);
+    }
+    free(items);
+
+    if (matched == 0) {
+        printf("No items in '%s' match '%s'\n", object_name, m->pattern);
+        free(mark);
+        free_project(proj);
+        return;
+    }
+
+    // Confirm deletion
+    if (can_confirm()) {
+        printf("Delete %d matching item%s from '%s'? y/N: ", matched, matched == 1 ? "" : "s", object_name);
+        fflush(stdout);
+        if (!read_answer(0)) {
+            print_error("Deletion cancelled\n");
+            free(mark);
+            free_project(proj);
+            return;
+        }
+    } else {
+        print_error("Non-interactive mode: deletion of %d matching items aborted\n", matched);
+        free(mark);
+        free_project(proj);
+        return;
+    }
+
+    uint32_t *ids = malloc(sizeof(uint32_t) * count_items(obj));
+    int removed = remove_marked_items(obj, mark, ids);
+    free(mark);
+
+    int ok = persist_tombstones(project_file, proj, obj, ids, removed);
+    free(ids);
+    if (ok) {
+        printf("Deleted %d item%s from '%s'\n", removed, removed == 1 ? "" : "s", object_name);
+    } else {
+        print_error("Failed to write project file\n");
+    }
+
+    free_project(proj);
+}
+
+/* Scan proj (or just `only`) for matches in range: print each, under
+ * `project/` when project is set, or offer it to the ranking heap. */
+static void search_objects(Project *proj, Object *only, const Matcher *m, const TimeRange *range,
+                           const char *project, Ranked *heap, int *heap_len, int top) {
+    RankQuery query;
+    if (heap) rank_query_init(&query, m, proj);
+
+    for (Object *obj = only ? only : proj->objects; obj && out_ok(); obj = only ? NULL : obj->next) {
+        int count;
+        Item **items = get_items_array(obj, &count);
+        int first, last;
+        items_range_bounds(obj, items, count, range, &first, &last);
+
+        for (int i = first; i < last && out_ok(); i++) {
+            if (!item_in_range(items[i], range)) continue;
+            const char *txt = items[i]->text;
+
+            if (matcher_match(m, txt)) {
+                if (heap) {
+                    Ranked r = { rank_score(&query, items[i]), items[i], obj, project };
+                    heap_offer(heap, heap_len, top, r);
+                    continue;
+                }
+                if (project) {
+                    out_str(project);
+                    out_char('/');
+                }
+                out_str(obj->name);
+                out_bytes(": [", 3);
+                out_timestamp(&items[i]->ts);
+                out_bytes("] ", 2);
+                out_str(txt);
+                out_char('\n');
+            }
+        }
+
+        free(items);
+    }
+}
+
+/* Pop the heap from the back and print it, best match first */
+static void print_ranked(Ranked *heap, int heap_len) {
+    int n = heap_len;
+    while (heap_len > 1) {
+        Ranked tmp = heap[0]; heap[0] = heap[heap_len - 1]; heap[heap_len - 1] = tmp;
+        heap_sift_down(heap, --heap_len, 0);
+    }
+    for (int i = 0; i < n; i++) {
+        char ts[32];
+        format_timestamp(&heap[i].item->ts, ts, sizeof(ts));
+        printf("%d. (%.2f) %s%s%s: [%s] %s\n", i + 1, heap[i].score,
+               heap[i].project ? heap[i].project : "", heap[i].project ? "/" : "",
+               heap[i].obj->name, ts, heap[i].item->text);
+    }
+}
+
+/* Search items across objects (or within a single object when object_name != NULL)
+ * m = compiled matcher: keywords (case-insensitive substrings, AND semantics),
+ * a regex or a fuzzy subsequence pattern
+ * range (optional) restricts matches to items timestamped inside it.
+ */
+void search(Config *cfg, const char *object_name, const Matcher *m, const TimeRange *range, int top) {
+    int primary, counter;
+    load_config_data(cfg, &primary, &counter);
+
+    if (primary < 0) {
+        print_error("No primary project set. Use 'funknotes primary <project>' first.\n");
+        return;
+    }
+
+    char project_file[MAX_PATH];
+    if (!get_project_file(cfg, primary, project_file)) {
+        print_error("Primary project not found\n");
+        return;
+    }
+
+    Project *proj = load_project_shared(project_file);
+    if (!proj) return;
+
+    if (!proj->objects) {
+        printf("No objects in primary project\n");
+        release_project(proj);
+        return;
+    }
+
+    // The matcher is compiled once by the caller and reused for every item
+    Object *only = NULL;
+    if (object_name) {
+        only = find_object(proj, object_name);
+        if (!only) {
+            print_error("Object '%s' not found\n", object_name);
+            release_project(proj);
+            return;
+        }
+    }
+
+    // Ranked mode: score matches, keeping the best `top` in a min-heap
+    Ranked *heap = top > 0 ? malloc(sizeof(Ranked) * top) : NULL;
+    int heap_len = 0;
+
+    out_begin();
+    search_objects(proj, only, m, range, NULL, heap, &heap_len, top);
+    out_flush();
+
+    if (heap) {
+        print_ranked(heap, heap_len);
+        free(heap);
+    }
+
+    release_project(proj);
+}
+
+/* search --all: search every project. Each header's trigram filter is read
+ * first and projects that cannot match are never parsed; projects written
+ * before filters existed are always searched. Matches print as
+ * project/object. */
+void search_all(Config *cfg, const Matcher *m, const TimeRange *range, int top) {
+    DIR *dir = opendir(cfg->projects_dir);
+    if (!dir) {
+        printf("No projects found\n");
+        return;
+    }
+
+    // Ranked results point into their projects, which stay loaded until printed
+    Ranked *heap = top > 0 ? malloc(sizeof(Ranked) * top) : NULL;
+    int heap_len = 0;
+    Project **held = NULL;
+    int held_count = 0;
+
+    out_begin();
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && out_ok()) {
+        if (!is_project_entry(cfg->projects_dir, entry->d_name)) continue;
+        char path[MAX_PATH];
+        snprintf(path, MAX_PATH, "%s/%s", cfg->projects_dir, entry->d_name);
+
+        Project *proj = load_project_overview(path);
+        if (!proj) continue;
+        if (!g_cold && !project_may_match(proj, m)) {  // the filter covers the hot tier only
+            release_project(proj);
+            continue;
+        }
+        // The overview is a header (stubs) unless the daemon has it cached
+        int stubs = 0;
+        for (Object *obj = proj->objects; obj; obj = obj->next) stubs |= obj->stub;
+        if (stubs) {
+            release_project(proj);
+            proj = load_project_shared(path);
+            if (!proj) continue;
+        }
+
+        search_objects(proj, NULL, m, range, proj->name, heap, &heap_len, top);
+        if (heap) {
+            Project **grown = realloc(held, sizeof(Project*) * (held_count + 1));
+            if (grown) {
+                held = grown;
+                held[held_count++] = proj;
+                continue;
+            }
+        }
+        release_project(proj);
+    }
+    closedir(dir);
+    out_flush();
+
+    if (heap) {
+        print_ranked(heap, heap_len);
+        free(heap);
+    }
+    for (int i = 0; i < held_count; i++) release_project(held[i]);
+    free(held);
+}
+
+/* Move all items and history from src to dst, after dst's own and in their
+ * original order. Items whose content already exists in dst are counted in
+ * *duplicates (unless dedupe is off) and dropped under DEDUPE_SKIP. Items
+ * coming from another project get new ids from `renumber` (NULL keeps them).
+ */
+void move_object_contents(Object *dst, Object *src, int dedupe, int *duplicates, Project *renumber) {
+    if (!src->rollup.valid) rollup_rebuild(src);
+    rollup_merge(&dst->rollup, &src->rollup);
+    int count;
+    Item **items = get_items_array(src, &count);
+    HashSet *set = dedupe != DEDUPE_OFF ? object_hashes(dst) : dst->hashes;
+    for (int i = 0; i < count; i++) {
+        Item *item = items[i];
+        if (dedupe != DEDUPE_OFF && hashset_contains(set, item->hash)) {
+            (*duplicates)++;
+            if (dedupe == DEDUPE_SKIP) {
+                size_t len = strlen(item->text);
+                dst->rollup.chars -= len < dst->rollup.chars ? len : dst->rollup.chars;
+                free(item);
+                continue;
+            }
+        }
+        if (dst->items && item->ts.epoch < dst->items->ts.epoch) dst->unordered = 1;
+        if (renumber) item->id = renumber->next_id++;
+        item->next = dst->items;
+        dst->items = item;
+        if (set) hashset_add(set, item->hash);
+        termstats_update(dst->terms, item->text, 1);
+        tags_update(dst, item->text, item->id, 1);
+    }
+    free(items);
+    src->items = NULL;
+
+    // History: oldest first, so prepend from the tail of the source list
+    int hist_count = 0;
+    for (HistoryEntry *h = src->history; h; h = h->next) hist_count++;
+    HistoryEntry **hists = hist_count ? malloc(sizeof(HistoryEntry*) * hist_count) : NULL;
+    int j = hist_count;
+    for (HistoryEntry *h = src->history; h; h = h->next) hists[--j] = h;
+    for (j = 0; j < hist_count; j++) {
+        if (renumber) hists[j]->id = 0;  // the other project's ids mean nothing here
+        hists[j]->next = dst->history;
+        dst->history = hists[j];
+    }
+    free(hists);
+    src->history = NULL;
+    memset(&src->rollup, 0, sizeof(src->rollup));
+    src->rollup.valid = 1;
+    hashset_free(src->hashes);
+    src->hashes = NULL;
+    // dst's checkpoints stay valid: the moved history is appended after them
+    free_checkpoints(src->checkpoints);
+    src->checkpoints = NULL;
+    termstats_free(src->terms);
+    src->terms = NULL;
+    tags_free(src->tags);
+    src->tags = NULL;
+    free(src->by_id);
+    src->by_id = NULL;
+    touch_object(dst);
+}
+
+/* Print the duplicate summary for a merge or import */
+static void report_duplicates(int dedupe, int duplicates) {
+    if (dedupe == DEDUPE_OFF || duplicates == 0) return;
+    if (dedupe == DEDUPE_SKIP) printf("Skipped %d duplicate item%s\n", duplicates, duplicates == 1 ? "" : "s");
+    else printf("Note: %d item%s duplicate existing content (use --dedupe to skip)\n", duplicates, duplicates == 1 ? "" : "s");
+}
+
+/* Merge multiple projects into the last project identifier (target).
+ * idents: array of project identifiers (name or index), count >= 2
+ * dedupe: duplicate policy for items that already exist in the target object
+ */
+void merge_projects(Config *cfg, int count, char **idents, int dedupe) {
+    if (count < 2) {
+        printf("Need at least two projects to merge: sources...,target\n");
+        return;
+    }
+
+    // Resolve all project files
+    char **paths = malloc(sizeof(char*) * count);
+    int *indices = malloc(sizeof(int) * count);
+    char **names = malloc(sizeof(char*) * count);
+    for (int i = 0; i < count; ++i) {
+        paths[i] = malloc(MAX_PATH);
+        if (!get_project_file_by_ident(cfg, idents[i], paths[i], &indices[i])) {
+            print_error("Project '%s' not found\n", idents[i]);
+            // cleanup
+            for (int j = 0; j <= i; j++) free(paths[j]);
+            free(paths); free(indices); free(names);
+            return;
+        }
+        // Read project name
+        Project *p = load_project_overview(paths[i]);
+        if (p) {
+            names[i] = strdup(p->name);
+            release_project(p);
+        } else {
+            names[i] = strdup(idents[i]);
+        }
+    }
+
+    // Build prompt: sources -> target
+    int target_idx = count - 1;
+    printf("Merge ");
+    for (int i = 0; i < target_idx; ++i) {
+        printf("%s%s", names[i], i < target_idx-1 ? "," : " ");
+    }
+    printf("into %s? y/N: ", names[target_idx]);
+    fflush(stdout);
+
+    if (!read_answer(0)) {
+        print_error("Merge cancelled\n");
+        for (int i=0;i<count;++i) { free(paths[i]); free(names[i]); }
+        free(paths); free(indices); free(names);
+        return;
+    }
+
+    // Load target
+    char *target_path = paths[target_idx];
+    int duplicates = 0;
+    Project *target = load_project_file(target_path);
+    if (!target) { print_error("Failed to load target project\n"); goto cleanup; }
+
+    // For each source, merge
+    for (int s = 0; s < target_idx; ++s) {
+        char *spath = paths[s];
+        Project *source = load_project_file(spath);
+        if (!source) { printf("Warning: failed reading source %s\n", spath); continue; }
+        fold_cold_tier(spath, source);
+
+        if (!source->objects) { free_project(source); continue; }
+
+        // For each object in source
+        Object *sobj = source->objects;
+        while (sobj) {
+            Object *next_sobj = sobj->next;
+            
+            // Find if target already has this object
+            Object *tobj = find_object(target, sobj->name);
+            
+            if (tobj) {
+                // Append items and history
+                move_object_contents(tobj, sobj, dedupe, &duplicates, target);
+                
+                // Free the source object (items/history already moved)
+                free(sobj);
+            } else if (dedupe != DEDUPE_OFF) {
+                // New object in target: move it through an empty object so
+                // duplicates within the source are caught too
+                Object *copy = calloc(1, sizeof(Object));
+                strcpy(copy->name, sobj->name);
+                move_object_contents(copy, sobj, dedupe, &duplicates, target);
+                free(sobj);
+                copy->next = target->objects;
+                target->objects = copy;
+            } else {
+                // Copy object into target (it gets a fresh file and ids there)
+                int n;
+                Item **items = get_items_array(sobj, &n);
+                for (int i = 0; i < n; i++) items[i]->id = target->next_id++;
+                free(items);
+                sobj->shard_id = 0;
+                touch_object(sobj);
+                sobj->next = target->objects;
+                target->objects = sobj;
+            }
+            
+            sobj = next_sobj;
+        }
+        
+        // Free source project (objects already moved or freed)
+        source->objects = NULL;
+        free_project(source);
+    }
+
+    // Write target back
+    if (save_project_file(target_path, target)) {
+        printf("Merged into %s\n", names[target_idx]);
+        report_duplicates(dedupe, duplicates);
+        // After successful merge, prompt to delete source projects
+        printf("Delete source projects? y/N: "); fflush(stdout);
+        if (read_answer(0)) {
+            for (int s = 0; s < target_idx; ++s) {
+                if (indices[s] > 0) {
+                    char idxbuf[32]; snprintf(idxbuf, sizeof(idxbuf), "%d", indices[s]);
+                    delete_project(cfg, idxbuf);
+                } else {
+                    delete_project(cfg, names[s]);
+                }
+            }
+        }
+    } else {
+        print_error("Failed to write target project\n");
+    }
+
+    free_project(target);
+
+cleanup:
+    for (int i=0;i<count;++i) { free(paths[i]); free(names[i]); }
+    free(paths); free(indices); free(names);
+}
+
+/* Merge objects within a single project: provide project ident and comma-separated object list
+ * Syntax: merge <project> <obj1,obj2,target>
+ * dedupe: duplicate policy for items that already exist in the target object
+ */
+void merge_objects_in_project(Config *cfg, const char *project_ident, const char *comma_list, int dedupe) {
+    // Resolve project
+    char project_file[MAX_PATH]; int proj_idx;
+    if (!get_project_file_by_ident(cfg, project_ident, project_file, &proj_idx)) {
+        print_error("Project '%s' not found\n", project_ident);
+        return;
+    }
+
+    // Split comma_list into tokens
+    char *cl = strdup(comma_list);
+    int parts = 0;
+    char *tok = strtok(cl, ",");
+    char **objs = NULL;
+    while (tok) {
+        objs = realloc(objs, sizeof(char*) * (parts+1));
+        objs[parts++] = strdup(tok);
+        tok = strtok(NULL, ",");
+    }
+    free(cl);
+
+    if (parts < 2) { printf("Need at least two objects to merge (sources,target)\n"); for (int i=0;i<parts;i++) free(objs[i]); free(objs); return; }
+
+    // Prompt y/N
+    printf("Merge ");
+    for (int i=0;i<parts-1;i++) { printf("%s%s", objs[i], i < parts-2 ? "," : " "); }
+    printf("into %s in project %s? y/N: ", objs[parts-1], project_ident);
+    fflush(stdout);
+    if (!read_answer(0)) {
+        print_error("Merge cancelled\n"); for (int i=0;i<parts;i++) free(objs[i]); free(objs); return;
+    }
+
+    // Load project, cold items included: they move with their object
+    Project *proj = load_project_file(project_file);
+    if (!proj) { print_error("Failed to load project\n"); for (int i=0;i<parts;i++) free(objs[i]); free(objs); return; }
+    fold_cold_tier(project_file, proj);
+
+    if (!proj->objects) { printf("No objects in project\n"); free_project(proj); for (int i=0;i<parts;i++) free(objs[i]); free(objs); return; }
+
+    const char *target = objs[parts-1];
+    int duplicates = 0;
+    Object *tobj = find_object(proj, target);
+    if (!tobj) { print_error("Target object '%s' not found\n", target); free_project(proj); for (int i=0;i<parts;i++) free(objs[i]); free(objs); return; }
+
+    for (int s=0; s<parts-1; ++s) {
+        Object *sobj = find_object(proj, objs[s]);
+        if (!sobj) { printf("Source object '%s' not found, skipping\n", objs[s]); continue; }
+        if (sobj == tobj) continue;
         
-        // Trim whitespace
-        while (*key == ' ' || *key == '\t') key++;
-        while (*value == ' ' || *value == '\t') value++;
+        // Append items and history
+        move_object_contents(tobj, sobj, dedupe, &duplicates, NULL);
+    }
+
+    // Write back
+    if (save_project_file(project_file, proj)) {
+        printf("Merged objects into %s\n", target);
+        report_duplicates(dedupe, duplicates);
+
+        // Prompt whether to delete source objects
+        printf("Delete source objects? y/N: "); fflush(stdout);
+        if (read_answer(0)) {
+            for (int s = 0; s < parts-1; ++s) {
+                Object *sobj = find_object(proj, objs[s]);
+                if (sobj) {
+                    // Remove from linked list
+                    if (proj->objects == sobj) {
+                        proj->objects = sobj->next;
+                    } else {
+                        Object *prev = proj->objects;
+                        while (prev && prev->next != sobj) prev = prev->next;
+                        if (prev) prev->next = sobj->next;
+                    }
+                    // Free object (items/history already moved)
+                    free(sobj);
+                }
+            }
+            // Write again after deletions
+            if (save_project_file(project_file, proj)) {
+                printf("Deleted source objects and updated project file\n");
+            } else {
+                print_error("Failed to write project file after deletions\n");
+            }
+        }
+    } else {
+        print_error("Failed to write project file\n");
+    }
+
+    free_project(proj);
+    for (int i=0;i<parts;i++) free(objs[i]); free(objs);
+}
+
+/* Show items of a specific object within a specific project (by name or index).
+ * range (optional) limits the listing to items inside a time window.
+ */
+void show_object_in_project(Config *cfg, const char *proj_ident, const char *object_name, const TimeRange *range) {
+    char project_file[MAX_PATH];
+    int proj_idx = -1;
+    if (!get_project_file_by_ident(cfg, proj_ident, project_file, &proj_idx)) {
+        print_error("Project '%s' not found\n", proj_ident);
+        return;
+    }
+
+    Project *proj = load_project_shared(project_file);
+    if (!proj) return;
+
+    Object *obj = find_object(proj, object_name);
+    if (!obj) {
+        print_error("Object '%s' not found in project '%s'\n", object_name, proj_ident);
+        release_project(proj);
+        return;
+    }
+
+    int item_count = count_items(obj);
+
+    if (item_count == 0) {
+        printf("\n=== %s/%s (empty) ===\n", proj->name, object_name);
+        release_project(proj);
+        return;
+    }
+
+    printf("\n=== %s/%s ===\n", proj->name, object_name);
+    print_items(obj, range);
+
+    release_project(proj);
+}
+
+/* Resolve a project (NULL = primary) to its file, printing the usual errors */
+static int resolve_project_file(Config *cfg, const char *proj_ident, char *project_file) {
+    if (proj_ident) {
+        if (get_project_file_by_ident(cfg, proj_ident, project_file, NULL)) return 1;
+        print_error("Project '%s' not found\n", proj_ident);
+        return 0;
+    }
+    int primary, counter;
+    load_config_data(cfg, &primary, &counter);
+    if (primary < 0) {
+        print_error("No primary project set. Use 'funknotes primary <project>' first.\n");
+        return 0;
+    }
+    if (!get_project_file(cfg, primary, project_file)) {
+        print_error("Primary project not found\n");
+        return 0;
+    }
+    return 1;
+}
+
+/* Format an epoch given on the command line for display */
+static void format_time_arg(int64_t epoch, char *buf, size_t size) {
+    Timestamp ts;
+    get_timestamp(&ts);
+    ts.epoch = epoch;
+    format_timestamp(&ts, buf, size);
+}
+
+/* show [<project>] <object> --at <time>: the object's items as they were
+ * just before <time>, rebuilt from its history */
+void show_object_at(Config *cfg, const char *proj_ident, const char *object_name, int64_t at) {
+    char project_file[MAX_PATH];
+    if (!resolve_project_file(cfg, proj_ident, project_file)) return;
+
+    Project *proj = load_project_shared(project_file);
+    if (!proj) return;
+
+    Object *obj = find_object(proj, object_name);
+    if (!obj) {
+        print_error("Object '%s' not found\n", object_name);
+        release_project(proj);
+        return;
+    }
+
+    HistoryEntry **adds;
+    int count;
+    int *live = object_state_at(obj, at, &adds, &count);
+
+    char when[32];
+    format_time_arg(at, when, sizeof(when));
+    printf("\n=== %s/%s at %s%s ===\n", proj->name, object_name, when, count ? "" : " (empty)");
+    for (int i = 0; i < count; i++) {
+        char ts[32];
+        format_timestamp(&adds[live[i]]->ts, ts, sizeof(ts));
+        printf("%d. [%s] %s\n", i + 1, ts, adds[live[i]]->text);
+    }
+
+    free(live);
+    free(adds);
+    release_project(proj);
+}
+
+/* diff <object> <t1> <t2>: items added (+) and removed (-) between two times */
+void diff_object(Config *cfg, const char *object_name, int64_t t1, int64_t t2) {
+    char project_file[MAX_PATH];
+    if (!resolve_project_file(cfg, NULL, project_file)) return;
+
+    Project *proj = load_project_shared(project_file);
+    if (!proj) return;
+
+    Object *obj = find_object(proj, object_name);
+    if (!obj) {
+        print_error("Object '%s' not found\n", object_name);
+        release_project(proj);
+        return;
+    }
+
+    HistoryEntry **adds1, **adds2;
+    int n1, n2;
+    int *before = object_state_at(obj, t1, &adds1, &n1);
+    int *after = object_state_at(obj, t2, &adds2, &n2);
+
+    char from[32], to[32];
+    format_time_arg(t1, from, sizeof(from));
+    format_time_arg(t2, to, sizeof(to));
+    printf("\n=== %s/%s: %s -> %s ===\n", proj->name, object_name, from, to);
+
+    // Both live lists are ascending ADD ordinals; walk them together
+    int added = 0, removed = 0;
+    int i = 0, j = 0;
+    while (i < n1 || j < n2) {
+        HistoryEntry *h;
+        char sign;
+        if (j >= n2 || (i < n1 && before[i] < after[j])) {
+            h = adds1[before[i++]];
+            sign = '-';
+            removed++;
+        } else if (i >= n1 || after[j] < before[i]) {
+            h = adds2[after[j++]];
+            sign = '+';
+            added++;
+        } else {
+            i++; j++;
+            continue;
+        }
+        char ts[32];
+        format_timestamp(&h->ts, ts, sizeof(ts));
+        printf("%c [%s] %s\n", sign, ts, h->text);
+    }
+    if (added == 0 && removed == 0) printf("No changes\n");
+    else printf("%d added, %d removed\n", added, removed);
+
+    free(before); free(adds1);
+    free(after); free(adds2);
+    release_project(proj);
+}
+
+/* Show objects of a project or items in an object.
+ * If arg is NULL -> show objects in primary project.
+ * If arg matches a project (name or index) -> show that project's objects.
+ * Otherwise treat arg as an object name in the primary project and show its items,
+ * limited to `range` when one is given.
+ */
+/* "  • NAME (N items, modified TIME)" for each object; stubs from a header
+ * load use their summary count */
+static void print_object_list(Project *proj) {
+    out_begin();
+    for (Object *obj = proj->objects; obj && out_ok(); obj = obj->next) {
+        out_str("  • ");
+        out_str(obj->name);
+        out_bytes(" (", 2);
+        out_int(obj->stub ? obj->item_count : count_items(obj));
+        out_str(" items");
+        if (obj->cold) {
+            out_str(", ");
+            out_int(obj->cold);
+            out_str(" cold");
+        }
+        if (obj->modified.epoch) {
+            out_str(", modified ");
+            out_timestamp(&obj->modified);
+        }
+        out_str(")\n");
+    }
+    out_flush();
+}
+
+void show(Config *cfg, const char *arg, const TimeRange *range) {
+    int primary, counter;
+    load_config_data(cfg, &primary, &counter);
+
+    char project_file[MAX_PATH];
+    Project *proj = NULL;
+
+    // If arg provided and matches a project identifier, show that project
+    if (arg && get_project_file_by_ident(cfg, arg, project_file, NULL)) {
+        proj = load_project_overview(project_file);
+        if (!proj) {
+            print_error("Failed to load project '%s'\n", arg);
+            return;
+        }
+
+        if (!proj->objects) {
+            printf("No objects in project '%s'\n", proj->name);
+            release_project(proj);
+            return;
+        }
+
+        printf("\n=== Objects in '%s' ===\n", proj->name);
+        print_object_list(proj);
+
+        release_project(proj);
+        return;
+    }
+
+    // Otherwise, operate on primary project
+    if (primary < 0) {
+        print_error("No primary project set. Use 'funknotes primary <project>' first.\n");
+        return;
+    }
+
+    if (!get_project_file(cfg, primary, project_file)) {
+        print_error("Primary project not found\n");
+        return;
+    }
+
+    // The object overview needs only the header; items need the full load
+    proj = arg ? load_project_shared(project_file) : load_project_overview(project_file);
+    if (!proj) return;
+
+    // If no arg provided, show all objects in primary
+    if (!arg) {
+        if (!proj->objects) {
+            printf("No objects in project '%s'\n", proj->name);
+            release_project(proj);
+            return;
+        }
+
+        printf("\n=== Objects in '%s' ===\n", proj->name);
+        print_object_list(proj);
+
+        release_project(proj);
+        return;
+    }
+
+    // If arg did not match a project, treat it as an object name in primary and show its items
+    Object *obj = find_object(proj, arg);
+    if (!obj) {
+        print_error("Object '%s' not found\n", arg);
+        release_project(proj);
+        return;
+    }
+
+    int item_count = count_items(obj);
+
+    if (item_count == 0) {
+        printf("\n=== %s (empty) ===\n", arg);
+        release_project(proj);
+        return;
+    }
+
+    printf("\n=== %s ===\n", arg);
+    print_items(obj, range);
+
+    release_project(proj);
+}
+
+// ===== Follow Mode ===== //
+// tail -f / show -f print the last items of an object, then wait on inotify
+// for the project to be written: a save renames a new file over the old one
+// (IN_MOVED_TO) and a journal append closes the file it wrote to
+// (IN_CLOSE_WRITE), so each event marks a finished write. Every save bumps
+// or keeps the header's next_id, and new items always get ids from it, so
+// an unchanged next_id means nothing was added and the rest of the file is
+// never read. Otherwise only the object's item lines are scanned for ids
+// past the last one seen. Items are labelled with their ids: positions
+// shift when items are deleted, and the scan never sees the whole object.
+
+typedef struct {
+    char path[MAX_PATH];      // project file, or directory-layout project
+    char object[MAX_TEXT];
+    int shard_id;             // directory layout: the object's file
+    uint32_t next_id;         // items with ids from here on have not been printed
+} Follow;
+
+/* Read next_id from the header (the manifest in the directory layout, which
+ * also says which file holds the object). Returns 0 if it cannot be read. */
+static int follow_read_header(Follow *fw, uint32_t *next_id) {
+    char path[MAX_PATH];
+    int dir = is_directory(fw->path);
+    if (dir) snprintf(path, MAX_PATH, "%s/" MANIFEST_FILE, fw->path);
+    else snprintf(path, MAX_PATH, "%s", fw->path);
+    FILE *f = dir ? fopen(path, "r") : open_project_read(path);
+    if (!f) return 0;
+    char line[MAX_LINE];
+    int found = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "[object ", 8) == 0) break;
+        if (strncmp(line, "next_id=", 8) == 0) {
+            *next_id = (uint32_t)strtoul(line + 8, NULL, 10);
+            found = 1;
+            if (!dir) break;
+        } else if (dir && strncmp(line, "object=", 7) == 0) {
+            char *pipe = strchr(line, '|');
+            size_t len = strlen(line);
+            if (len > 0 && line[len-1] == '\n') line[len-1] = '\0';
+            if (pipe && strcmp(pipe + 1, fw->object) == 0) fw->shard_id = atoi(line + 7);
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+/* Print the object's items with ids from fw->next_id on, in file order */
+static void follow_emit_new(Follow *fw) {
+    char path[MAX_PATH];
+    int dir = is_directory(fw->path);
+    if (dir) snprintf(path, MAX_PATH, "%s/%d.txt", fw->path, fw->shard_id);
+    else snprintf(path, MAX_PATH, "%s", fw->path);
+    FILE *f = dir ? fopen(path, "r") : open_project_read(path);
+    if (!f) return;
+
+    char line[MAX_LINE], header[MAX_TEXT + 16];
+    snprintf(header, sizeof(header), "[object %s]", fw->object);
+    size_t header_len = strlen(header);
+    int inside = 0;
+    out_begin();
+    while (fgets(line, sizeof(line), f) && out_ok()) {
+        if (line[0] == '[') {
+            if (inside) break;
+            inside = strncmp(line, header, header_len) == 0 && (line[header_len] == '\n' || !line[header_len]);
+            continue;
+        }
+        if (!inside || strncmp(line, "item=", 5) != 0) continue;
+        size_t len = strlen(line);
+        if (len > 0 && line[len-1] == '\n') line[--len] = '\0';
+        char *pipe = strchr(line, '|');
+        char *at = memchr(line, '@', pipe ? (size_t)(pipe - line) : 0);
+        if (!pipe || !at) continue;
+        uint32_t id = (uint32_t)strtoul(at + 1, NULL, 10);
+        if (id < fw->next_id) continue;
+        Item item;
+        *pipe = '\0';
+        if (!parse_timestamp_field(line + 5, &item.ts)) continue;
+        item.id = id;
+        read_text_field(pipe, line + len, item.text);
+        out_item(&item, 0);
+    }
+    out_flush();
+    fclose(f);
+}
+
+/* tail -f / show -f: print the last `last_n` items of the object (or, with
+ * has_after, those after item #after), then follow it until interrupted or
+ * the reader goes away. */
+void follow_object(Config *cfg, const char *proj_ident, const char *object_name, int last_n,
+                   int has_after, uint32_t after, int follow) {
+    Follow fw;
+    memset(&fw, 0, sizeof(fw));
+    if (!resolve_project_file(cfg, proj_ident, fw.path)) return;
+    snprintf(fw.object, MAX_TEXT, "%s", object_name);
+
+    Project *proj = load_project_for_object(fw.path, object_name);
+    if (!proj) return;
+    Object *obj = find_object(proj, object_name);
+    if (!obj || obj->stub) {
+        print_error("Object '%s' not found\n", object_name);
+        free_project(proj);
+        return;
+    }
+    int count;
+    Item **items = get_items_array(obj, &count);
+    int first = count > last_n ? count - last_n : 0;
+    out_begin();
+    for (int i = has_after ? 0 : first; i < count && out_ok(); i++) {
+        if (has_after && items[i]->id <= after) continue;
+        out_item(items[i], i + 1);
+    }
+    out_flush();
+    free(items);
+    fw.next_id = proj->next_id;
+    fw.shard_id = obj->shard_id;
+    free_project(proj);
+    if (!follow || !out_ok()) return;
+
+#ifdef __linux__
+    // Saves rename over the file and appends close it: watch its directory for the name
+    char watch_dir[MAX_PATH], name[MAX_PATH];
+    int dir = is_directory(fw.path);
+    if (dir) {
+        snprintf(watch_dir, MAX_PATH, "%s", fw.path);
+        snprintf(name, MAX_PATH, "%s", MANIFEST_FILE);  // written last by every save
+    } else {
+        const char *slash = strrchr(fw.path, '/');
+        snprintf(watch_dir, MAX_PATH, "%.*s", slash ? (int)(slash - fw.path) : 1, slash ? fw.path : ".");
+        snprintf(name, MAX_PATH, "%s", slash ? slash + 1 : fw.path);
+    }
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, watch_dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        print_error("Cannot watch '%s': %s\n", watch_dir, strerror(errno));
+        if (fd >= 0) close(fd);
+        return;
+    }
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (out_ok()) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        int changed = 0;
+        for (char *p = buf; p < buf + n; ) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            if (ev->len && strcmp(ev->name, name) == 0) changed = 1;
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+        uint32_t next_id;
+        if (!changed || !follow_read_header(&fw, &next_id) || next_id <= fw.next_id) continue;
+        follow_emit_new(&fw);
+        fw.next_id = next_id;
+    }
+    close(fd);
+#else
+    print_error("Follow mode needs inotify (Linux)\n");
+#endif
+}
+
+/* Append a new item with an ADD history entry to an object (in memory) */
+Item* append_item(Project *proj, Object *obj, const char *text, const Timestamp *now) {
+    Item *item = calloc(1, sizeof(Item));
+    if (!item) return NULL;
+    item->ts = *now;
+    item->id = proj->next_id++;
+    strncpy(item->text, text, MAX_TEXT - 1);
+    item->text[MAX_TEXT - 1] = '\0';
+    item->hash = text_hash(item->text);
+    if (obj->items && item->ts.epoch < obj->items->ts.epoch) obj->unordered = 1;
+    item->next = obj->items;
+    obj->items = item;
+    if (obj->hashes) hashset_add(obj->hashes, item->hash);
+    termstats_update(obj->terms, item->text, 1);
+    tags_update(obj, item->text, item->id, 1);
+    touch_object(obj);
+    
+    // Add history entry
+    HistoryEntry *hist = calloc(1, sizeof(HistoryEntry));
+    if (hist) {
+        strcpy(hist->action, "ADD");
+        hist->ts = *now;
+        hist->id = item->id;
+        strncpy(hist->text, text, MAX_TEXT - 1);
+        hist->text[MAX_TEXT - 1] = '\0';
+        hist->next = obj->history;
+        obj->history = hist;
+    }
+    rollup_added(obj, item);
+    return item;
+}
+
+/* Add item to object. `dedupe` selects what happens when an item with the
+ * same normalized text already exists (DEDUPE_SKIP, DEDUPE_COUNT, DEDUPE_OFF). */
+void add_item(Config *cfg, const char *object_name, const char *text, int dedupe) {
+    int primary, counter;
+    load_config_data(cfg, &primary, &counter);
+    
+    if (primary < 0) {
+        print_error("No primary project set. Use 'funknotes primary <project>' first.\n");
+        return;
+    }
+    
+    char project_file[MAX_PATH];
+    if (!get_project_file(cfg, primary, project_file)) {
+        print_error("Primary project not found\n");
+        return;
+    }
+    
+    Project *proj = load_project_for_object(project_file, object_name);
+    if (!proj) return;
+    
+    Object *obj = find_object(proj, object_name);
+    if (!obj) {
+        // Object missing — prompt the user to create it (default Y)
+        int create = 1; // default yes
+        if (can_confirm()) {
+            printf("The object '%s' does not exist, create it? Y/n: ", object_name);
+            fflush(stdout);
+            create = read_answer(1);  // EOF keeps the default
+        } else {
+            // Non-interactive: default to creating the object
+            create = 1;
+        }
+
+        if (!create) {
+            print_error("Not creating object '%s'. Aborting add.\n", object_name);
+            free_project(proj);
+            return;
+        }
+
+        // Create the object
+        free_project(proj);
+        add_object(cfg, object_name);
+
+        // Re-load project file to pick up the newly created object
+        proj = load_project_for_object(project_file, object_name);
+        if (!proj) return;
         
-        if (strcmp(key, "name") == 0) {
-            strncpy(proj->name, value, MAX_TEXT - 1);
-            proj->name[MAX_TEXT - 1] = '\0';
-        } else if (strcmp(key, "index") == 0) {
-            proj->index = atoi(value);
-        } else if (strcmp(key, "item") == 0 && current_obj) {
-            // Format: timestamp|text
-            char *pipe = strchr(value, '|');
-            if (pipe) {
-                *pipe = '\0';
-                Item *item = calloc(1, sizeof(Item));
-                strncpy(item->timestamp, value, 63);
-                item->timestamp[63] = '\0';
-                strncpy(item->text, pipe + 1, MAX_TEXT - 1);
-                item->text[MAX_TEXT - 1] = '\0';
-                item->next = current_obj->items;
-                current_obj->items = item;
-            }
-        } else if (strcmp(key, "history") == 0 && current_obj) {
-            // Format: timestamp|action|text
-            char *pipe1 = strchr(value, '|');
-            if (pipe1) {
-                *pipe1 = '\0';
-                char *pipe2 = strchr(pipe1 + 1, '|');
-                if (pipe2) {
-                    *pipe2 = '\0';
-                    HistoryEntry *hist = calloc(1, sizeof(HistoryEntry));
-                    strncpy(hist->timestamp, value, 63);
-                    hist->timestamp[63] = '\0';
-                    strncpy(hist->action, pipe1 + 1, 31);
-                    hist->action[31] = '\0';
-                    strncpy(hist->text, pipe2 + 1, MAX_TEXT - 1);
-                    hist->text[MAX_TEXT - 1] = '\0';
-                    hist->next = current_obj->history;
-                    current_obj->history = hist;
-                }
+        obj = find_object(proj, object_name);
+        if (!obj) {
+            print_error("Failed to create object '%s'\n", object_name);
+            free_project(proj);
+            return;
+        }
+    }
+    
+    // Duplicate check against the object's content-hash set
+    int duplicate = 0;
+    if (dedupe != DEDUPE_OFF && hashset_contains(object_hashes(obj), text_hash(text))) {
+        if (dedupe == DEDUPE_SKIP) {
+            printf("Skipped duplicate item in %s\n", object_name);
+            free_project(proj);
+            return;
+        }
+        duplicate = 1;
+    }
+
+    Timestamp now;
+    get_timestamp(&now);
+    append_item(proj, obj, text, &now);
+    
+    if (save_project_file(project_file, proj)) {
+        printf("Added item to %s%s\n", object_name, duplicate ? " (duplicate of an existing item)" : "");
+    }
+    
+    free_project(proj);
+}
+
+/* Bulk-add one item per non-empty line of `path` ("-" = stdin) to an object
+ * in the primary project, creating the object if needed. The project is
+ * loaded and written once for the whole batch.
+ */
+void import_items(Config *cfg, const char *object_name, const char *path, int dedupe) {
+    int primary, counter;
+    load_config_data(cfg, &primary, &counter);
+
+    if (primary < 0) {
+        print_error("No primary project set. Use 'funknotes primary <project>' first.\n");
+        return;
+    }
+
+    char project_file[MAX_PATH];
+    if (!get_project_file(cfg, primary, project_file)) {
+        print_error("Primary project not found\n");
+        return;
+    }
+
+    FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!in) {
+        print_error("Cannot open '%s'\n", path);
+        return;
+    }
+
+    Project *proj = load_project_for_object(project_file, object_name);
+    if (!proj) { if (in != stdin) fclose(in); return; }
+
+    Object *obj = find_object(proj, object_name);
+    if (!obj) {
+        obj = calloc(1, sizeof(Object));
+        strncpy(obj->name, object_name, MAX_TEXT - 1);
+        obj->name[MAX_TEXT - 1] = '\0';
+        touch_object(obj);
+        obj->next = proj->objects;
+        proj->objects = obj;
+        printf("Created object '%s' in project '%s'\n", object_name, proj->name);
+    }
+
+    Timestamp now;
+    get_timestamp(&now);
+    HashSet *set = dedupe != DEDUPE_OFF ? object_hashes(obj) : NULL;
+    int added = 0, duplicates = 0;
+    char line[MAX_LINE];
+    while (fgets(line, sizeof(line), in)) {
+        size_t len = strlen(line);
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r')) line[--len] = '\0';
+        if (len == 0) continue;
+        if (set && hashset_contains(set, text_hash(line))) {
+            duplicates++;
+            if (dedupe == DEDUPE_SKIP) continue;
+        }
+        append_item(proj, obj, line, &now);
+        added++;
+    }
+    if (in != stdin) fclose(in);
+
+    if (added == 0) {
+        printf("No items imported into %s\n", object_name);
+    } else if (save_project_file(project_file, proj)) {
+        printf("Imported %d item%s into %s\n", added, added == 1 ? "" : "s", object_name);
+    } else {
+        print_error("Failed to write project file\n");
+    }
+    report_duplicates(dedupe, duplicates);
+
+    free_project(proj);
+}
+/* Load the primary project and find item #id in object_name. On success the
+ * caller owns *proj_out. */
+static Item* load_item_by_id(Config *cfg, const char *object_name, uint32_t id, char *project_file,
+                             Project **proj_out, Object **obj_out) {
+    if (!resolve_project_file(cfg, NULL, project_file)) return NULL;
+    Project *proj = load_project_for_object(project_file, object_name);
+    if (!proj) return NULL;
+    Object *obj = find_object(proj, object_name);
+    if (!obj) {
+        print_error("Object '%s' not found\n", object_name);
+        free_project(proj);
+        return NULL;
+    }
+    Item *item = find_item_by_id(obj, id);
+    if (!item) {
+        print_error("Item #%u not found in '%s'\n", id, object_name);
+        free_project(proj);
+        return NULL;
+    }
+    *proj_out = proj;
+    *obj_out = obj;
+    return item;
+}
+
+/* delete <object> #id: append a tombstone instead of rewriting the file */
+void delete_item_by_id(Config *cfg, const char *object_name, uint32_t id) {
+    char project_file[MAX_PATH];
+    Project *proj;
+    Object *obj;
+    Item *item = load_item_by_id(cfg, object_name, id, project_file, &proj, &obj);
+    if (!item) return;
+
+    if (can_confirm()) {
+        printf("Delete item #%u from '%s' (%s)? y/N: ", id, object_name, item->text);
+        fflush(stdout);
+        if (!read_answer(0)) {
+            print_error("Deletion cancelled\n");
+            free_project(proj);
+            return;
+        }
+    } else {
+        print_error("Non-interactive mode: deletion of item #%u aborted\n", id);
+        free_project(proj);
+        return;
+    }
+
+    Timestamp now;
+    get_timestamp(&now);
+    add_history(obj, "DELETE_ITEM", &now, item->text, item->id);
+    rollup_deleted(obj, item->text, &now);
+    HashSet dead;
+    memset(&dead, 0, sizeof(dead));
+    hashset_add(&dead, (uint64_t)id + 1);
+    remove_items_by_id(obj, &dead);
+    free(dead.keys);
+    free(dead.counts);
+    touch_object(obj);
+
+    char ts[32], record[64];
+    write_timestamp_field(&now, ts, sizeof(ts));
+    snprintf(record, sizeof(record), "tombstone=%u|%s\n", id, ts);
+    if (journal_append(project_file, proj, obj, record, 1)) {
+        printf("Deleted item #%u from '%s'\n", id, object_name);
+    } else {
+        print_error("Failed to write project file\n");
+    }
+    free_project(proj);
+}
+
+/* edit <object> #id <text>: append an update record with the new text */
+void edit_item_by_id(Config *cfg, const char *object_name, uint32_t id, const char *text) {
+    char project_file[MAX_PATH];
+    Project *proj;
+    Object *obj;
+    Item *item = load_item_by_id(cfg, object_name, id, project_file, &proj, &obj);
+    if (!item) return;
+
+    Timestamp now;
+    get_timestamp(&now);
+    rollup_edited(obj, item->text, text, &now);
+    edit_item_text(obj, item, text, &now);
+    touch_object(obj);
+    filter_add_text(proj->filter, item->text);
+
+    char ts[32], esc[MAX_ESCAPED + 1];
+    const char *new_text = item->text;
+    const char *flag = text_flag(&new_text, esc);
+    char *record = malloc(MAX_ESCAPED + 64);
+    write_timestamp_field(&now, ts, sizeof(ts));
+    snprintf(record, MAX_ESCAPED + 64, "update=%u|%s%s|%s\n", id, ts, flag, new_text);
+    if (journal_append(project_file, proj, obj, record, 1)) {
+        printf("Edited item #%u in %s\n", id, object_name);
+    } else {
+        print_error("Failed to write project file\n");
+    }
+    free(record);
+    free_project(proj);
+}
+
+
+/* Remove duplicate items (same normalized text) from every object of a
+ * project, or from one object, keeping the first occurrence of each.
+ */
+void dedupe_project(Config *cfg, const char *proj_ident, const char *object_name) {
+    char project_file[MAX_PATH];
+    if (!get_project_file_by_ident(cfg, proj_ident, project_file, NULL)) {
+        print_error("Project '%s' not found\n", proj_ident);
+        return;
+    }
+
+    Project *proj = load_project_file(project_file);
+    if (!proj) return;
+
+    if (object_name && !find_object(proj, object_name)) {
+        print_error("Object '%s' not found in project '%s'\n", object_name, proj_ident);
+        free_project(proj);
+        return;
+    }
+
+    // Mark every repeat of content already seen earlier in the same object
+    int objects = 0, total = 0;
+    for (Object *o = proj->objects; o; o = o->next) objects++;
+    char **marks = calloc(objects ? objects : 1, sizeof(char*));
+    int oi = 0;
+    for (Object *o = proj->objects; o; o = o->next, oi++) {
+        if (object_name && strcmp(o->name, object_name) != 0) continue;
+        int count;
+        Item **items = get_items_array(o, &count);
+        if (!items) continue;
+        HashSet seen = { 0 };
+        int dups = 0;
+        marks[oi] = calloc(count, 1);
+        for (int i = 0; i < count; i++) {
+            if (hashset_contains(&seen, items[i]->hash)) {
+                marks[oi][i] = 1;
+                dups++;
+            } else {
+                hashset_add(&seen, items[i]->hash);
+            }
+        }
+        free(seen.keys);
+        free(seen.counts);
+        free(items);
+        if (dups) printf("  %s: %d duplicate item%s\n", o->name, dups, dups == 1 ? "" : "s");
+        total += dups;
+    }
+
+    if (total == 0) {
+        printf("No duplicate items in '%s'\n", proj->name);
+    } else {
+        int confirmed = 0;
+        if (can_confirm()) {
+            printf("Remove %d duplicate item%s from '%s'? y/N: ", total, total == 1 ? "" : "s", proj->name);
+            fflush(stdout);
+            confirmed = read_answer(0);
+            if (!confirmed) print_error("Dedupe cancelled\n");
+        } else {
+            print_error("Non-interactive mode: dedupe aborted\n");
+        }
+        if (confirmed) {
+            oi = 0;
+            for (Object *o = proj->objects; o; o = o->next, oi++) {
+                if (marks[oi]) remove_marked_items(o, marks[oi], NULL);
+            }
+            if (save_project_file(project_file, proj)) {
+                printf("Removed %d duplicate item%s from '%s'\n", total, total == 1 ? "" : "s", proj->name);
+            } else {
+                print_error("Failed to write project file\n");
             }
         }
     }
+
+    for (oi = 0; oi < objects; oi++) free(marks[oi]);
+    free(marks);
+    free_project(proj);
+}
+
+/* Set primary project */
+void set_primary(Config *cfg, const char *ident) {
+    int primary, counter;
+    load_config_data(cfg, &primary, &counter);
+
+    char project_file[MAX_PATH];
+    int proj_idx = -1;
+    if (!get_project_file_by_ident(cfg, ident, project_file, &proj_idx)) {
+        print_error("Project '%s' not found\n", ident);
+        return;
+    }
+
+    Project *proj = load_project_shared(project_file);
+    if (proj) {
+        printf("Set primary project to '%s'\n", proj->name);
+        release_project(proj);
+    }
+
+    save_config_data(cfg, proj_idx, counter);
+}
+
+/* List all projects */
+void list_projects(Config *cfg) {
+    int primary, counter;
+    load_config_data(cfg, &primary, &counter);
     
-    fclose(f);
-    return proj;
+    DIR *dir = opendir(cfg->projects_dir);
+    if (!dir) {
+        printf("No projects found\n");
+        return;
+    }
+    
+    printf("\n=== FunkNotes Projects ===\n");
+    
+    out_begin();
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && out_ok()) {
+        if (is_project_entry(cfg->projects_dir, entry->d_name)) {
+            char path[MAX_PATH];
+            snprintf(path, MAX_PATH, "%s/%s", cfg->projects_dir, entry->d_name);
+            
+            Project *proj = load_project_overview(path);
+            if (proj) {
+                out_bytes("  [", 3);
+                out_int(proj->index);
+                out_bytes("] ", 2);
+                out_str(proj->name);
+                if (proj->index == primary) out_str(" (PRIMARY)");
+                if (is_compressed_path(entry->d_name)) out_str(" (archived)");
+                out_char('\n');
+                release_project(proj);
+            }
+        }
+    }
+    out_flush();
+    
+    closedir(dir);
+}
+
+// ===== Write Lock ===== //
+// Every command that may write holds an exclusive flock() on the home's
+// write.lock from start to exit, in-process and inside funknotesd alike, so
+// a load-modify-save never interleaves with another one. Read-only commands
+// skip it: saves rename a complete new file into place, and journal appends
+// keep readers out of the file they patch with a flock() of its own (see
+// journal_append). Shells let go of it while they wait for input.
+
+static int g_write_lock = -1;           // fd holding write.lock, or -1
+static char g_write_lock_home[MAX_PATH];
+
+/* Open and flock a home's write.lock; returns the fd holding it, or -1 if it
+ * is busy (nowait) or cannot be opened */
+static int lock_home(const char *home_dir, int nowait) {
+    char path[MAX_PATH];
+    snprintf(path, MAX_PATH, "%s/write.lock", home_dir);
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+    while (flock(fd, LOCK_EX | (nowait ? LOCK_NB : 0)) != 0) {
+        if (errno == EINTR) continue;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Take this home's write lock unless already held. Returns 0 only when
+ * nowait is set and another process holds it. */
+static int lock_writes(const char *home_dir, int nowait) {
+    if (g_write_lock >= 0) return 1;
+    if (home_dir != g_write_lock_home) snprintf(g_write_lock_home, MAX_PATH, "%s", home_dir);
+    g_write_lock = lock_home(home_dir, nowait);
+    return g_write_lock >= 0 || !nowait;
+}
+
+static void unlock_writes(void) {
+    if (g_write_lock < 0) return;
+    close(g_write_lock);
+    g_write_lock = -1;
+}
+
+/* Does this command only read? Everything else takes the write lock. */
+static int command_reads_only(int argc, char **argv) {
+    static const char *const readers[] = {
+        "show", "search", "projects", "tags", "stats", "diff", "tail", "help", "bench", "daemon", NULL
+    };
+    if (argc < 2) return 1;
+    for (int i = 0; readers[i]; i++) {
+        if (!strcmp(argv[1], readers[i])) return 1;
+    }
+    return 0;
+}
+
+// ===== Daemon (funknotesd) ===== //
+// Request: "FNQ2", u32 argc, then argc x (u32 len, bytes), then the client's
+// TZ the same way (len 0xffffffff when unset). The client's stdin, stdout,
+// stderr and working directory travel with the header as SCM_RIGHTS, so the
+// command reads, prints, resolves paths and formats local times exactly as
+// it would in-process. Reply: i32 exit code, or DAEMON_DECLINED if a writing
+// command found the write lock taken by a direct process; the client then
+// runs it itself (and waits for the lock) rather than stalling the daemon.
+
+#define DAEMON_MAGIC "FNQ2"
+#define DAEMON_MAX_ARGS 64
+#define DAEMON_MAX_ARG_LEN 65536
+#define DAEMON_NO_TZ 0xffffffffu
+#define DAEMON_DECLINED INT32_MIN
+
+int main(int argc, char *argv[]);
+
+static volatile sig_atomic_t g_daemon_stop = 0;
+
+static int write_full(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) { if (errno == EINTR) continue; return 0; }
+        p += n; len -= (size_t)n;
+    }
+    return 1;
+}
+
+static int read_full(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0) { if (errno == EINTR) continue; return 0; }
+        if (n == 0) return 0;
+        p += n; len -= (size_t)n;
+    }
+    return 1;
+}
+
+static int daemon_socket_addr(Config *cfg, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(cfg->socket_file) >= sizeof(addr->sun_path)) return 0;
+    strcpy(addr->sun_path, cfg->socket_file);
+    return 1;
+}
+
+/* Connect to a running daemon. Returns the socket fd or -1. */
+static int daemon_connect(Config *cfg) {
+    struct sockaddr_un addr;
+    if (!daemon_socket_addr(cfg, &addr)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Commands the daemon serves. Anything that opens an interactive shell or
+ * asks for a destructive confirmation runs in-process instead, so a pending
+ * prompt never blocks other clients. */
+static int daemon_can_serve(int argc, char **argv) {
+    if (argc < 2) return 0;
+    const char *cmd = argv[1];
+    if (!strcmp(cmd, "show")) {
+        // Follow mode runs until interrupted; it must not tie up the daemon
+        for (int i = 2; i < argc; i++) {
+            if (!strcmp(argv[i], "-f") || !strcmp(argv[i], "--follow")) return 0;
+        }
+        return 1;
+    }
+    if (!strcmp(cmd, "search") || !strcmp(cmd, "projects") || !strcmp(cmd, "tags") ||
+        !strcmp(cmd, "primary") || !strcmp(cmd, "help")) return 1;
+    if (!strcmp(cmd, "new")) return argc == 4 && !strcmp(argv[2], "project");
+    if (!strcmp(cmd, "add")) return argc >= 4 || (argc == 3 && !isatty(STDIN_FILENO));
+    if (!strcmp(cmd, "daemon")) return argc == 3 && !strcmp(argv[2], "stop");
+    return 0;
+}
+
+/* Send the command to funknotesd. Returns 1 and sets *exit_code when the
+ * daemon ran it, 0 if no daemon is reachable (caller runs it directly). */
+int daemon_forward(Config *cfg, int argc, char **argv, int *exit_code) {
+    if (getenv("FUNKNOTES_NO_DAEMON") || !daemon_can_serve(argc, argv)) return 0;
+    if (argc > DAEMON_MAX_ARGS) return 0;
+    int cwd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (cwd < 0) return 0;
+    int fd = daemon_connect(cfg);
+    if (fd < 0) {
+        close(cwd);
+        return 0;
+    }
+
+    fflush(stdout);
+    char header[8];
+    uint32_t n = (uint32_t)argc;
+    memcpy(header, DAEMON_MAGIC, 4);
+    memcpy(header + 4, &n, 4);
+
+    int fds[4] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO, cwd };
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+    struct iovec iov = { header, sizeof(header) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+
+    int ok = sendmsg(fd, &msg, 0) == (ssize_t)sizeof(header);
+    for (int i = 0; ok && i < argc; i++) {
+        uint32_t len = (uint32_t)strlen(argv[i]);
+        ok = len <= DAEMON_MAX_ARG_LEN && write_full(fd, &len, 4) && write_full(fd, argv[i], len);
+    }
+    const char *tz = getenv("TZ");
+    uint32_t tz_len = tz ? (uint32_t)strlen(tz) : DAEMON_NO_TZ;
+    ok = ok && (!tz || tz_len <= DAEMON_MAX_ARG_LEN) && write_full(fd, &tz_len, 4) &&
+         (!tz || write_full(fd, tz, tz_len));
+    close(cwd);
+    int32_t code;
+    if (ok && read_full(fd, &code, 4)) {
+        close(fd);
+        if (code == DAEMON_DECLINED) return 0;
+        *exit_code = code;
+        return 1;
+    }
+    close(fd);
+    // Request never reached the daemon (or it died mid-way); nothing was run
+    // if the header failed, so only fall back in that case.
+    if (!ok) return 0;
+    *exit_code = 1;
+    return 1;
+}
+
+/* Read one request from a client. Fills argv (caller frees), tz (caller
+ * frees; NULL when the client has no TZ) and the four passed descriptors.
+ * Returns argc, or -1 on a malformed request. */
+static int daemon_read_request(int fd, char **argv, char **tz, int *fds) {
+    char header[8];
+    char control[CMSG_SPACE(sizeof(int) * 4)];
+    struct iovec iov = { header, sizeof(header) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    fds[0] = fds[1] = fds[2] = fds[3] = -1;
+    *tz = NULL;
+    if (recvmsg(fd, &msg, 0) != (ssize_t)sizeof(header)) return -1;
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    if (cm && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS &&
+        cm->cmsg_len == CMSG_LEN(sizeof(int) * 4)) {
+        memcpy(fds, CMSG_DATA(cm), sizeof(int) * 4);
+    }
+    if (fds[0] < 0 || fds[3] < 0 || memcmp(header, DAEMON_MAGIC, 4) != 0) return -1;
+
+    uint32_t argc;
+    memcpy(&argc, header + 4, 4);
+    if (argc < 1 || argc > DAEMON_MAX_ARGS) return -1;
+    for (uint32_t i = 0; i < argc; i++) {
+        uint32_t len;
+        argv[i] = NULL;
+        if (!read_full(fd, &len, 4) || len > DAEMON_MAX_ARG_LEN) return -1;
+        argv[i] = malloc(len + 1);
+        if (!argv[i] || !read_full(fd, argv[i], len)) return -1;
+        argv[i][len] = '\0';
+    }
+    argv[argc] = NULL;
+    uint32_t tz_len;
+    if (!read_full(fd, &tz_len, 4)) return -1;
+    if (tz_len != DAEMON_NO_TZ) {
+        if (tz_len > DAEMON_MAX_ARG_LEN || !(*tz = malloc(tz_len + 1)) || !read_full(fd, *tz, tz_len)) return -1;
+        (*tz)[tz_len] = '\0';
+    }
+    return (int)argc;
+}
+
+static void daemon_on_signal(int sig) {
+    (void)sig;
+    g_daemon_stop = 1;
+}
+
+/* Point TZ at tz (unset when NULL) and reload the zone rules */
+static void daemon_set_tz(const char *tz) {
+    if (tz) setenv("TZ", tz, 1);
+    else unsetenv("TZ");
+    tzset();
+}
+
+/* Run funknotesd in the foreground until `funknotes daemon stop` or SIGTERM/SIGINT */
+int run_daemon(Config *cfg) {
+    struct sockaddr_un addr;
+    if (!daemon_socket_addr(cfg, &addr)) {
+        printf("Socket path too long: %s\n", cfg->socket_file);
+        return 1;
+    }
+    int probe = daemon_connect(cfg);
+    if (probe >= 0) {
+        close(probe);
+        printf("funknotesd is already running (%s)\n", cfg->socket_file);
+        return 1;
+    }
+    unlink(cfg->socket_file);  // stale socket from a crashed daemon
+
+    int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(lfd, 16) != 0) {
+        print_error("Failed to listen on %s: %s\n", cfg->socket_file, strerror(errno));
+        if (lfd >= 0) close(lfd);
+        return 1;
+    }
+    chmod(cfg->socket_file, 0600);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = daemon_on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("funknotesd listening on %s\n", cfg->socket_file);
+    fflush(stdout);
+
+    g_in_daemon = 1;
+    g_cache_enabled = 1;
+    // Unbuffered stdin so nothing read for one client can leak into the next
+    setvbuf(stdin, NULL, _IONBF, 0);
+    int saved[3] = { dup(STDIN_FILENO), dup(STDOUT_FILENO), dup(STDERR_FILENO) };
+    int saved_cwd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    char *own_tz = getenv("TZ") ? strdup(getenv("TZ")) : NULL;
+
+    while (!g_daemon_stop) {
+        int cfd = accept(lfd, NULL, NULL);
+        if (cfd < 0) continue;
+
+        char *args[DAEMON_MAX_ARGS + 1];
+        char *tz;
+        int fds[4];
+        memset(args, 0, sizeof(args));
+        int ac = daemon_read_request(cfd, args, &tz, fds);
+        int32_t code = 1;
+        if (ac > 0 && !command_reads_only(ac, args) && !lock_writes(cfg->home_dir, 1)) {
+            code = DAEMON_DECLINED;
+        } else if (ac > 0 && fchdir(fds[3]) == 0) {
+            daemon_set_tz(tz);
+            dup2(fds[0], STDIN_FILENO);
+            dup2(fds[1], STDOUT_FILENO);
+            dup2(fds[2], STDERR_FILENO);
+            clearerr(stdin);
+            code = main(ac, args);
+            fflush(stdout);
+            fflush(stderr);
+            clearerr(stdout);
+            for (int i = 0; i < 3; i++) dup2(saved[i], i);
+            daemon_set_tz(own_tz);
+            if (saved_cwd >= 0 && fchdir(saved_cwd) != 0) saved_cwd = -1;
+        }
+        unlock_writes();
+        for (int i = 0; i < 4; i++) if (fds[i] >= 0) close(fds[i]);
+        for (int i = 0; i <= DAEMON_MAX_ARGS && args[i]; i++) free(args[i]);
+        free(tz);
+        write_full(cfd, &code, 4);
+        close(cfd);
+    }
+
+    close(lfd);
+    if (saved_cwd >= 0) close(saved_cwd);
+    free(own_tz);
+    unlink(cfg->socket_file);
+    while (g_cache) cache_drop(&g_cache);
+    printf("funknotesd stopped\n");
+    return 0;
+}
+
+/* funknotes daemon [start|stop|status] */
+int daemon_command(Config *cfg, int argc, char **argv) {
+    const char *sub = argc >= 3 ? argv[2] : "start";
+    if (!strcmp(sub, "start")) return run_daemon(cfg);
+    if (!strcmp(sub, "stop")) {
+        if (g_in_daemon) {
+            g_daemon_stop = 1;
+            printf("Stopping funknotesd\n");
+        } else {
+            printf("funknotesd is not running\n");
+        }
+        return 0;
+    }
+    if (!strcmp(sub, "status")) {
+        int fd = daemon_connect(cfg);
+        if (fd >= 0) {
+            close(fd);
+            printf("funknotesd is running (%s)\n", cfg->socket_file);
+        } else {
+            printf("funknotesd is not running\n");
+        }
+        return 0;
+    }
+    print_error("Usage: funknotes daemon [start|stop|status]\n");
+    return 1;
+}
+
+// ===== Benchmarks ===== //
+
+static double now_seconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
 }
 
-/* Save project to text file */
-int save_project_file(const char *filename, Project *proj) {
-    FILE *f = fopen(filename, "w");
-    if (!f) return 0;
-    
-    fprintf(f, "name=%s\n", proj->name);
-    fprintf(f, "index=%d\n", proj->index);
-    fprintf(f, "\n");
-    
-    // Write objects (iterate in reverse to maintain order)
-    Object *obj = proj->objects;
-    if (obj) {
-        // Count objects
-        int obj_count = 0;
-        Object *tmp = obj;
-        while (tmp) { obj_count++; tmp = tmp->next; }
-        
-        // Create array to reverse order
-        Object **objs = malloc(sizeof(Object*) * obj_count);
-        tmp = obj;
-        for (int i = 0; i < obj_count; i++) {
-            objs[obj_count - 1 - i] = tmp;
-            tmp = tmp->next;
-        }
-        
-        // Write in original order
-        for (int i = 0; i < obj_count; i++) {
-            fprintf(f, "[object %s]\n", objs[i]->name);
-            
-            // Write items (reverse order)
-            Item *item = objs[i]->items;
-            if (item) {
-                int item_count = 0;
-                Item *tmp_item = item;
-                while (tmp_item) { item_count++; tmp_item = tmp_item->next; }
-                
-                Item **items = malloc(sizeof(Item*) * item_count);
-                tmp_item = item;
-                for (int j = 0; j < item_count; j++) {
-                    items[item_count - 1 - j] = tmp_item;
-                    tmp_item = tmp_item->next;
-                }
-                
-                for (int j = 0; j < item_count; j++) {
-                    fprintf(f, "item=%s|%s\n", items[j]->timestamp, items[j]->text);
-                }
-                
-                free(items);
-            }
-            
-            // Write history (reverse order)
-            HistoryEntry *hist = objs[i]->history;
-            if (hist) {
-                int hist_count = 0;
-                HistoryEntry *tmp_hist = hist;
-                while (tmp_hist) { hist_count++; tmp_hist = tmp_hist->next; }
-                
-                HistoryEntry **hists = malloc(sizeof(HistoryEntry*) * hist_count);
-                tmp_hist = hist;
-                for (int j = 0; j < hist_count; j++) {
-                    hists[hist_count - 1 - j] = tmp_hist;
-                    tmp_hist = tmp_hist->next;
-                }
-                
-                for (int j = 0; j < hist_count; j++) {
-                    fprintf(f, "history=%s|%s|%s\n", hists[j]->timestamp, hists[j]->action, hists[j]->text);
-                }
-                
-                free(hists);
-            }
-            
-            fprintf(f, "\n");
+/* Run this binary with `args` and stdout discarded; returns exit status */
+static int bench_spawn(const char *self, char **args, int direct) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_RDWR);
+        if (devnull >= 0) {
+            dup2(devnull, STDOUT_FILENO);
+            dup2(devnull, STDIN_FILENO);
         }
-        
-        free(objs);
+        if (direct) setenv("FUNKNOTES_NO_DAEMON", "1", 1);
+        execv(self, args);
+        _exit(127);
     }
-    
-    fclose(f);
-    return 1;
+    int status = 0;
+    if (pid > 0) waitpid(pid, &status, 0);
+    return status;
 }
 
-/* Create new project */
-void new_project(Config *cfg, const char *name) {
-    if (strcmp(name, "projects") == 0) {
-        printf("Can't create project named 'projects' (protected name)\n");
-        return;
+/* Compare per-invocation latency of `funknotes <cmd...>` via the daemon vs direct */
+int bench_daemon(Config *cfg, const char *self, int runs, int argc, char **cmd) {
+    int fd = daemon_connect(cfg);
+    if (fd < 0) {
+        printf("funknotesd is not running; start it with 'funknotes daemon &' first\n");
+        return 1;
     }
-    int primary, counter;
-    load_config_data(cfg, &primary, &counter);
-    
-    counter++;
-    
-    char project_file[MAX_PATH];
-    snprintf(project_file, MAX_PATH, "%s/%d_%s.txt", 
-             cfg->projects_dir, counter, name);
-    
+    close(fd);
+
+    char *args[DAEMON_MAX_ARGS + 2];
+    args[0] = (char *)self;
+    char *dflt = "projects";
+    int ac = 0;
+    if (argc == 0) { args[1] = dflt; ac = 1; }
+    for (int i = 0; i < argc && i < DAEMON_MAX_ARGS; i++) args[++ac] = cmd[i];
+    args[ac + 1] = NULL;
+
+    double t[2];
+    for (int mode = 0; mode < 2; mode++) {
+        double start = now_seconds();
+        for (int i = 0; i < runs; i++) bench_spawn(self, args, mode == 1);
+        t[mode] = (now_seconds() - start) / runs;
+    }
+    printf("bench daemon: %d runs of '%s", runs, args[1]);
+    for (int i = 2; i <= ac; i++) printf(" %s", args[i]);
+    printf("'\n");
+    printf("  client (daemon): %8.3f ms/op\n", t[0] * 1e3);
+    printf("  direct:          %8.3f ms/op\n", t[1] * 1e3);
+    // Below 1x the socket round trip costs more than the parse it saves
+    if (t[0] > 0) printf("  speedup:         %8.2fx%s\n", t[1] / t[0], t[1] < t[0] ? " (client slower)" : "");
+    return 0;
+}
+
+/* Fill proj with `count` generated items spread over four objects, each
+ * with its ADD history */
+static void bench_generate(Project *gen, long count) {
+    memset(gen, 0, sizeof(*gen));
+    snprintf(gen->name, MAX_TEXT, "BENCH");
+    Timestamp ts;
+    get_timestamp(&ts);
+    for (int o = 0; o < 4; o++) {
+        Object *obj = calloc(1, sizeof(Object));
+        if (!obj) break;
+        snprintf(obj->name, MAX_TEXT, "OBJECT%d", o + 1);
+        obj->next = gen->objects;
+        gen->objects = obj;
+    }
+    for (long i = 0; i < count && gen->objects; i++) {
+        Object *obj = gen->objects;
+        for (long k = i % 4; k > 0 && obj->next; k--) obj = obj->next;
+        Item *item = calloc(1, sizeof(Item));
+        if (!item) break;
+        item->ts = ts;
+        item->ts.epoch += i - count;
+        item->id = (uint32_t)i + 1;
+        snprintf(item->text, MAX_TEXT, "bench note %ld: the quick brown fox jumps over the lazy dog", i);
+        item->hash = text_hash(item->text);
+        item->next = obj->items;
+        obj->items = item;
+        add_history(obj, "ADD", &item->ts, item->text, item->id);
+    }
+    gen->next_id = (uint32_t)count + 1;
+}
+
+/* Parse buf with the block parser into a project */
+static Project* bench_parse_once(char *buf, size_t len, double *secs) {
+    FILE *f = fmemopen(buf, len, "r");
     Project *proj = calloc(1, sizeof(Project));
-    strncpy(proj->name, name, MAX_TEXT - 1);
-    proj->name[MAX_TEXT - 1] = '\0';
-    proj->index = counter;
-    
-    if (save_project_file(project_file, proj)) {
-        printf("Created project '%s' with index %d\n", name, counter);
-    } else {
-        printf("Error creating project file\n");
+    if (!f || !proj) {
+        if (f) fclose(f);
+        free(proj);
+        return NULL;
     }
-    
-    free_project(proj);
-    save_config_data(cfg, primary, counter);
+    proj->index = -1;
+    Object *current = NULL;
+    double t0 = now_seconds();
+    parse_project_lines(f, proj, &current, 0);
+    *secs += now_seconds() - t0;
+    fclose(f);
+    finish_load(proj);
+    return proj;
 }
 
-/* Get project file by index */
-int get_project_file(Config *cfg, int index, char *filename) {
-    DIR *dir = opendir(cfg->projects_dir);
-    if (!dir) return 0;
-    
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL) {
-        if (strstr(entry->d_name, ".txt")) {
-            char path[MAX_PATH];
-            snprintf(path, MAX_PATH, "%s/%s", cfg->projects_dir, entry->d_name);
-            
-            Project *proj = load_project_file(path);
-            if (proj) {
-                if (proj->index == index) {
-                    strcpy(filename, path);
-                    free_project(proj);
-                    closedir(dir);
-                    return 1;
-                }
-                free_project(proj);
-            }
+/* Serialize a project into memory, for comparing parse results */
+static char* bench_serialize(Project *proj, size_t *len) {
+    char *out = NULL;
+    FILE *f = open_memstream(&out, len);
+    if (!f) return NULL;
+    write_project(f, proj);
+    fclose(f);
+    return out;
+}
+
+/* funknotes bench parse [<project>] [runs]: block parser throughput on a
+ * project file (or 100k generated items in four objects), and whether what
+ * it loads saves and parses back to the same project. To compare against an
+ * older parser, run the same bench from a build of that revision. */
+int bench_parse(Config *cfg, const char *ident, int runs) {
+    char *buf = NULL;
+    size_t len = 0;
+    if (ident) {
+        char project_file[MAX_PATH];
+        if (!resolve_project_file(cfg, ident, project_file)) return 1;
+        if (is_directory(project_file)) {
+            print_error("bench parse reads single-file projects; migrate '%s' with --file first\n", ident);
+            return 1;
         }
+        buf = read_project_bytes(project_file, &len);
+    } else {
+        Project gen;
+        bench_generate(&gen, 100000);
+        buf = bench_serialize(&gen, &len);
+        free_project_objects(gen.objects);
     }
-    
-    closedir(dir);
-    return 0;
+    if (!buf) {
+        print_error("Failed to read the benchmark input\n");
+        return 1;
+    }
+
+    long records = 0;
+    for (const char *p = buf, *end = buf + len; p < end; ) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        if (!nl) nl = end;
+        if (nl > p) records++;
+        p = nl + 1;
+    }
+
+    double secs = 0;
+    char *out[2] = {NULL, NULL};
+    size_t out_len[2] = {0, 0};
+    for (int r = 0; r < runs; r++) {
+        Project *proj = bench_parse_once(buf, len, &secs);
+        if (!proj) break;
+        if (r == 0) out[0] = bench_serialize(proj, &out_len[0]);
+        free_project(proj);
+    }
+    free(buf);
+    // Round trip: what was loaded, saved and parsed again saves the same
+    if (out[0]) {
+        double unused = 0;
+        Project *again = bench_parse_once(out[0], out_len[0], &unused);
+        if (again) out[1] = bench_serialize(again, &out_len[1]);
+        free_project(again);
+    }
+
+    double mb = len / (1024.0 * 1024.0);
+    double t = secs / runs;
+    printf("Parse of %ld records (%.1f MB), %d run%s:\n", records, mb, runs, runs == 1 ? "" : "s");
+    printf("  %-16s %8.3f ms  %10.0f records/s  %8.1f MB/s\n", "block parser:", t * 1e3, records / t, mb / t);
+    int same = out[0] && out[1] && out_len[0] == out_len[1] && memcmp(out[0], out[1], out_len[0]) == 0;
+    printf("  round trip %s (%zu bytes re-serialized)\n", same ? "identical" : "DIFFERS", out_len[0]);
+    free(out[0]);
+    free(out[1]);
+    return same ? 0 : 1;
 }
 
-/* Get project file by name or numeric identifier. If ident is numeric, treat as index.
- * On success fills `filename` with the path and sets *out_index (if non-NULL).
- * Returns 1 on found, 0 otherwise.
- */
-int get_project_file_by_ident(Config *cfg, const char *ident, char *filename, int *out_index) {
-    // Check if ident is a number (all digits)
-    int is_number = 1;
-    for (size_t i = 0; i < strlen(ident); ++i) {
-        if (ident[i] < '0' || ident[i] > '9') { is_number = 0; break; }
+/* funknotes bench save [<project>] [runs]: buffered writer throughput on a
+ * project (or 100k generated items) written to /dev/null, and whether its
+ * output parses and saves back byte-identical. To compare against an older
+ * writer, run the same bench from a build of that revision. */
+int bench_save(Config *cfg, const char *ident, int runs) {
+    Project *proj;
+    if (ident) {
+        char project_file[MAX_PATH];
+        if (!resolve_project_file(cfg, ident, project_file)) return 1;
+        proj = load_project_file(project_file);
+    } else {
+        proj = calloc(1, sizeof(Project));
+        if (proj) bench_generate(proj, 100000);
+    }
+    if (!proj) {
+        print_error("Failed to load the benchmark project\n");
+        return 1;
+    }
+    FILE *sink = fopen("/dev/null", "w");
+    if (!sink) {
+        print_error("Failed to open /dev/null\n");
+        free_project(proj);
+        return 1;
     }
 
-    if (is_number) {
-        int idx = atoi(ident);
-        if (out_index) *out_index = idx;
-        return get_project_file(cfg, idx, filename);
+    // Reference output; the first save also settles checkpoints, so every
+    // timed run does the same work
+    char *out[2] = {NULL, NULL};
+    size_t out_len[2] = {0, 0};
+    out[0] = bench_serialize(proj, &out_len[0]);
+    if (out[0]) {
+        double unused = 0;
+        Project *again = bench_parse_once(out[0], out_len[0], &unused);
+        if (again) out[1] = bench_serialize(again, &out_len[1]);
+        free_project(again);
+    }
+    long records = 0;
+    for (const char *p = out[0], *end = out[0] + out_len[0]; out[0] && p < end; ) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        if (!nl) nl = end;
+        if (nl > p) records++;
+        p = nl + 1;
     }
 
-    DIR *dir = opendir(cfg->projects_dir);
-    if (!dir) return 0;
+    double t0 = now_seconds();
+    for (int r = 0; r < runs; r++) {
+        write_project(sink, proj);
+        fflush(sink);
+    }
+    double t = (now_seconds() - t0) / runs;
+    fclose(sink);
+    free_project(proj);
 
+    double mb = out_len[0] / (1024.0 * 1024.0);
+    printf("Save of %ld records (%.1f MB), %d run%s:\n", records, mb, runs, runs == 1 ? "" : "s");
+    printf("  %-16s %8.3f ms  %10.0f records/s  %8.1f MB/s\n", "buffered writer:", t * 1e3, records / t, mb / t);
+    int same = out[0] && out[1] && out_len[0] == out_len[1] && memcmp(out[0], out[1], out_len[0]) == 0;
+    printf("  round trip %s (%zu bytes)\n", same ? "byte-identical" : "DIFFERS", out_len[0]);
+    free(out[0]);
+    free(out[1]);
+    return same ? 0 : 1;
+}
+
+/* Average seconds per load_project_file() of `path` over `runs` loads */
+static double bench_load(const char *path, int runs) {
+    double start = now_seconds();
+    for (int i = 0; i < runs; i++) free_project(load_project_file(path));
+    return (now_seconds() - start) / runs;
+}
+
+/* Compression ratio against save/load cost for one project or all of them */
+int bench_compress(Config *cfg, const char *ident, int runs) {
+    const char *tmpdir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    char plain[MAX_PATH], packed[MAX_PATH];
+    snprintf(plain, MAX_PATH, "%s/funknotes_bench_%d.txt", tmpdir, (int)getpid());
+    snprintf(packed, MAX_PATH, "%s/funknotes_bench_%d.fnz", tmpdir, (int)getpid());
+
+    DIR *dir = opendir(cfg->projects_dir);
+    if (!dir) return 1;
+    printf("%-24s %12s %12s %7s %10s %10s %10s %10s\n", "project", "plain B", "fnz B", "ratio",
+           "save ms", "save.fnz", "load ms", "load.fnz");
+    long total_plain = 0, total_packed = 0;
     struct dirent *entry;
     while ((entry = readdir(dir)) != NULL) {
-        if (strstr(entry->d_name, ".txt")) {
-            char path[MAX_PATH];
-            snprintf(path, MAX_PATH, "%s/%s", cfg->projects_dir, entry->d_name);
+        if (!is_project_filename(entry->d_name)) continue;
+        char path[MAX_PATH];
+        snprintf(path, MAX_PATH, "%s/%s", cfg->projects_dir, entry->d_name);
+        Project *proj = load_project_file(path);
+        if (!proj) continue;
+        char idx[32];
+        snprintf(idx, sizeof(idx), "%d", proj->index);
+        if (ident && strcmp(ident, proj->name) != 0 && strcmp(ident, idx) != 0) {
+            free_project(proj);
+            continue;
+        }
 
-            Project *proj = load_project_file(path);
-            if (proj) {
-                if (strcmp(proj->name, ident) == 0) {
-                    if (out_index) *out_index = proj->index;
-                    strcpy(filename, path);
-                    free_project(proj);
-                    closedir(dir);
-                    return 1;
-                }
-                free_project(proj);
-            }
+        double t0 = now_seconds();
+        int ok = save_project_file(plain, proj);
+        double t1 = now_seconds();
+        ok = ok && save_project_file(packed, proj);
+        double t2 = now_seconds();
+        if (ok) {
+            long a = file_size(plain), b = file_size(packed);
+            total_plain += a;
+            total_packed += b;
+            printf("%-24.24s %12ld %12ld %6.2fx %10.3f %10.3f %10.3f %10.3f\n", proj->name, a, b,
+                   b > 0 ? (double)a / b : 0.0, (t1 - t0) * 1e3, (t2 - t1) * 1e3,
+                   bench_load(plain, runs) * 1e3, bench_load(packed, runs) * 1e3);
         }
+        free_project(proj);
     }
-
     closedir(dir);
+    remove(plain);
+    remove(packed);
+    if (total_packed > 0) {
+        printf("total: %ld -> %ld bytes (%.2fx), load times averaged over %d runs\n",
+               total_plain, total_packed, (double)total_plain / total_packed, runs);
+    }
     return 0;
 }
 
-/* Find object in project */
-Object* find_object(Project *proj, const char *object_name) {
-    Object *obj = proj->objects;
-    while (obj) {
-        if (strcmp(obj->name, object_name) == 0) return obj;
-        obj = obj->next;
+/* funknotes bench <kind> [options] */
+/* Time dumping `count` generated items through printf (the old listing
+ * path) and through the output buffer, with stdout sent to /dev/null */
+int bench_output(long count) {
+    Object obj;
+    memset(&obj, 0, sizeof(obj));
+    snprintf(obj.name, MAX_TEXT, "BENCH");
+    Timestamp ts;
+    get_timestamp(&ts);
+    ts.epoch -= count;
+    for (long i = 0; i < count; i++) {
+        Item *item = calloc(1, sizeof(Item));
+        if (!item) break;
+        item->ts = ts;
+        item->ts.epoch += i;
+        snprintf(item->text, MAX_TEXT, "bench note %ld: the quick brown fox jumps over the lazy dog", i);
+        item->next = obj.items;
+        obj.items = item;
     }
-    return NULL;
-}
 
-/* Count items in object */
-int count_items(Object *obj) {
-    int count = 0;
-    Item *item = obj->items;
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    if (saved < 0 || devnull < 0) {
+        print_error("Cannot open /dev/null\n");
+        return 1;
+    }
+    dup2(devnull, STDOUT_FILENO);
+
+    double t0 = now_seconds();
+    int n;
+    Item **items = get_items_array(&obj, &n);
+    for (int i = 0; i < n; i++) {
+        char stamp[32];
+        format_timestamp(&items[i]->ts, stamp, sizeof(stamp));
+        printf("%d. [%s] %s\n", i + 1, stamp, items[i]->text);
+    }
+    free(items);
+    fflush(stdout);
+    double t_printf = now_seconds() - t0;
+
+    t0 = now_seconds();
+    print_items(&obj, NULL);
+    double t_buffered = now_seconds() - t0;
+    uint64_t bytes = g_out.written;
+
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    close(devnull);
+
+    double mb = bytes / (1024.0 * 1024.0);
+    printf("Output of %d items (%.1f MB) to /dev/null:\n", n, mb);
+    printf("  printf per item:  %7.3f s  %10.0f items/s  %7.1f MB/s\n", t_printf, n / t_printf, mb / t_printf);
+    printf("  buffered writer:  %7.3f s  %10.0f items/s  %7.1f MB/s\n", t_buffered, n / t_buffered, mb / t_buffered);
+    printf("  speedup: %.1fx\n", t_printf / t_buffered);
+
+    Item *item = obj.items;
     while (item) {
-        count++;
-        item = item->next;
+        Item *next = item->next;
+        free(item);
+        item = next;
     }
-    return count;
+    return 0;
 }
 
-/* Get item by 1-based index (returns NULL if not found) */
-Item* get_item_by_index(Object *obj, int index) {
-    // Count total items first
-    int total = count_items(obj);
-    if (index < 1 || index > total) return NULL;
-    
-    // Items are stored in reverse order, so we need to traverse from end
-    int target = total - index;  // Convert to 0-based from start
-    Item *item = obj->items;
-    for (int i = 0; i < target; i++) {
-        if (!item) return NULL;
-        item = item->next;
+int bench_checksum(Config *cfg, const char *ident, int runs);
+
+int bench_command(Config *cfg, int argc, char **argv) {
+    char self[MAX_PATH];
+    ssize_t n = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (n > 0) self[n] = '\0';
+    else snprintf(self, sizeof(self), "%s", argv[0]);
+
+    if (argc >= 3 && !strcmp(argv[2], "daemon")) {
+        int runs = 200;
+        int first = 3;
+        if (argc >= 4 && atoi(argv[3]) > 0) { runs = atoi(argv[3]); first = 4; }
+        return bench_daemon(cfg, self, runs, argc - first, argv + first);
     }
-    return item;
+    if (argc >= 3 && !strcmp(argv[2], "compress")) {
+        const char *ident = argc >= 4 ? argv[3] : NULL;
+        int runs = argc >= 5 && atoi(argv[4]) > 0 ? atoi(argv[4]) : 20;
+        return bench_compress(cfg, ident, runs);
+    }
+    if (argc >= 3 && !strcmp(argv[2], "output")) {
+        long count = argc >= 4 && atol(argv[3]) > 0 ? atol(argv[3]) : 1000000;
+        return bench_output(count);
+    }
+    if (argc >= 3 && !strcmp(argv[2], "parse")) {
+        const char *ident = argc >= 4 ? argv[3] : NULL;
+        int runs = argc >= 5 && atoi(argv[4]) > 0 ? atoi(argv[4]) : 5;
+        return bench_parse(cfg, ident, runs);
+    }
+    if (argc >= 3 && !strcmp(argv[2], "save")) {
+        const char *ident = argc >= 4 ? argv[3] : NULL;
+        int runs = argc >= 5 && atoi(argv[4]) > 0 ? atoi(argv[4]) : 5;
+        return bench_save(cfg, ident, runs);
+    }
+    if (argc >= 3 && !strcmp(argv[2], "checksum")) {
+        const char *ident = argc >= 4 ? argv[3] : NULL;
+        int runs = argc >= 5 && atoi(argv[4]) > 0 ? atoi(argv[4]) : 10;
+        return bench_checksum(cfg, ident, runs);
+    }
+    print_error("Usage: funknotes bench daemon [runs] [command...]\n");
+    printf("       funknotes bench compress [<project>] [runs]\n");
+    printf("       funknotes bench output [items]\n");
+    printf("       funknotes bench parse [<project>] [runs]\n");
+    printf("       funknotes bench save [<project>] [runs]\n");
+    printf("       funknotes bench checksum [<project>] [runs]\n");
+    return 1;
 }
 
-/* Get all items as array (caller must free) */
-Item** get_items_array(Object *obj, int *count) {
-    *count = count_items(obj);
-    if (*count == 0) return NULL;
-    
-    Item **items = malloc(sizeof(Item*) * (*count));
-    Item *item = obj->items;
-    for (int i = *count - 1; i >= 0; i--) {
-        items[i] = item;
-        item = item->next;
+// ===== Archive ===== //
+
+/* Rewrite a project file as compressed (.fnz) or plain (.txt). The new file
+ * is written under a temporary name, read back, then renamed into place
+ * before the old one is removed. Returns 1 on success.
+ */
+int convert_project_file(const char *path, int compress) {
+    if (is_compressed_path(path) == compress) return 1;
+    size_t len = strlen(path);
+    if (len < 4 || len + 2 >= MAX_PATH) return 0;
+    char dest[MAX_PATH], tmp[MAX_PATH];
+    snprintf(dest, MAX_PATH, "%.*s%s", (int)(len - 4), path, compress ? ".fnz" : ".txt");
+    // Hidden temp name in the same directory; it keeps the real suffix so
+    // open_project_write() picks the right codec, and scans skip dotfiles
+    const char *slash = strrchr(dest, '/');
+    size_t dir_len = slash ? (size_t)(slash - dest) + 1 : 0;
+    snprintf(tmp, MAX_PATH, "%.*s.%s", (int)dir_len, dest, dest + dir_len);
+
+    Project *proj = load_project_file(path);
+    if (!proj) return 0;
+    int ok = save_project_file(tmp, proj);
+    if (ok) {
+        Project *check = load_project_file(tmp);
+        ok = check && check->index == proj->index && strcmp(check->name, proj->name) == 0;
+        free_project(check);
     }
-    return items;
+    free_project(proj);
+    if (!ok || rename(tmp, dest) != 0) {
+        remove(tmp);
+        return 0;
+    }
+    remove(path);
+    return 1;
 }
 
-/* Add object to project */
-void add_object(Config *cfg, const char *object_name) {
-    int primary, counter;
-    load_config_data(cfg, &primary, &counter);
-    
-    if (primary < 0) {
-        printf("No primary project set. Use 'funknotes primary <project>' first.\n");
+/* funknotes archive <project> | --idle <age> ; funknotes unarchive <project> */
+void archive_command(Config *cfg, const char *ident, int compress) {
+    char project_file[MAX_PATH];
+    int proj_idx = -1;
+    if (!get_project_file_by_ident(cfg, ident, project_file, &proj_idx)) {
+        print_error("Project '%s' not found\n", ident);
         return;
     }
-    
-    char project_file[MAX_PATH];
-    if (!get_project_file(cfg, primary, project_file)) {
-        printf("Primary project not found\n");
+    if (is_directory(project_file)) {
+        printf("Project '%s' uses the directory layout; run 'funknotes migrate %s --file' first\n", ident, ident);
         return;
     }
-    
-    Project *proj = load_project_file(project_file);
-    if (!proj) return;
-    
-    if (find_object(proj, object_name)) {
-        printf("Object '%s' already exists\n", object_name);
-        free_project(proj);
+    if (is_compressed_path(project_file) == compress) {
+        printf("Project '%s' is already %s\n", ident, compress ? "archived" : "uncompressed");
         return;
     }
-    
-    Object *obj = calloc(1, sizeof(Object));
-    strncpy(obj->name, object_name, MAX_TEXT - 1);
-    obj->name[MAX_TEXT - 1] = '\0';
-    obj->next = proj->objects;
-    proj->objects = obj;
-    
-    if (save_project_file(project_file, proj)) {
-        printf("Created object '%s' in project '%s'\n", 
-               object_name, proj->name);
+    long before = file_size(project_file);
+    if (!convert_project_file(project_file, compress)) {
+        print_error("Failed to %s project '%s'\n", compress ? "archive" : "unarchive", ident);
+        return;
     }
-    
-    free_project(proj);
+    char dest[MAX_PATH];
+    snprintf(dest, MAX_PATH, "%.*s%s", (int)(strlen(project_file) - 4), project_file, compress ? ".fnz" : ".txt");
+    long after = file_size(dest);
+    printf("%s project '%s' (%ld -> %ld bytes)\n", compress ? "Archived" : "Unarchived", ident, before, after);
 }
 
-/* Delete an object from the primary project */
-void delete_object(Config *cfg, const char *object_name) {
+/* Archive every plain project not modified since `cutoff`, except the primary */
+void archive_idle_projects(Config *cfg, int64_t cutoff) {
     int primary, counter;
     load_config_data(cfg, &primary, &counter);
-
-    if (primary < 0) {
-        printf("No primary project set. Use 'funknotes primary <project>' first.\n");
-        return;
+
+    DIR *dir = opendir(cfg->projects_dir);
+    if (!dir) return;
+    int archived = 0;
+    long saved = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len <= 4 || strcmp(entry->d_name + len - 4, ".txt") != 0) continue;
+        char path[MAX_PATH];
+        snprintf(path, MAX_PATH, "%s/%s", cfg->projects_dir, entry->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0 || (int64_t)st.st_mtime >= cutoff) continue;
+        if (primary >= 0 && atoi(entry->d_name) == primary) continue;
+        long before = st.st_size;
+        if (convert_project_file(path, 1)) {
+            char dest[MAX_PATH];
+            snprintf(dest, MAX_PATH, "%.*s.fnz", (int)(strlen(path) - 4), path);
+            saved += before - file_size(dest);
+            printf("  archived %s\n", entry->d_name);
+            archived++;
+        }
     }
+    closedir(dir);
+    printf("Archived %d idle project%s (%ld bytes saved)\n", archived, archived == 1 ? "" : "s", saved);
+}
 
+/* funknotes migrate <project> --dir|--file: switch a project between the
+ * single-file and directory layouts. The new copy is built under a hidden
+ * name, read back and renamed into place before the old one is removed.
+ */
+void migrate_project_layout(Config *cfg, const char *ident, int to_dir) {
     char project_file[MAX_PATH];
-    if (!get_project_file(cfg, primary, project_file)) {
-        printf("Primary project not found\n");
+    int proj_idx = -1;
+    if (!get_project_file_by_ident(cfg, ident, project_file, &proj_idx)) {
+        print_error("Project '%s' not found\n", ident);
         return;
     }
-
-    Project *proj = load_project_file(project_file);
-    if (!proj) return;
-
-    Object *obj = find_object(proj, object_name);
-    if (!obj) {
-        printf("Object '%s' not found\n", object_name);
-        free_project(proj);
+    if (is_directory(project_file) == to_dir) {
+        printf("Project '%s' already uses the %s layout\n", ident, to_dir ? "directory" : "single-file");
         return;
     }
-
-    // Confirm deletion with user (default: No)
-    if (isatty(STDIN_FILENO)) {
-        printf("Delete object '%s'? y/N: ", object_name);
-        fflush(stdout);
-        char resp[8];
-        if (!fgets(resp, sizeof(resp), stdin) || (resp[0] != 'y' && resp[0] != 'Y')) {
-            printf("Deletion cancelled\n");
-            free_project(proj);
-            return;
-        }
-    } else {
-        // Non-interactive: do not delete by default
-        printf("Non-interactive mode: deletion of object '%s' aborted\n", object_name);
-        free_project(proj);
+    if (is_compressed_path(project_file)) {
+        printf("Project '%s' is archived; run 'funknotes unarchive %s' first\n", ident, ident);
         return;
     }
 
-    // Remove the object from linked list
-    if (proj->objects == obj) {
-        proj->objects = obj->next;
-    } else {
-        Object *prev = proj->objects;
-        while (prev && prev->next != obj) prev = prev->next;
-        if (prev) prev->next = obj->next;
-    }
-    
-    // Free object's items and history
-    Item *item = obj->items;
-    while (item) {
-        Item *next = item->next;
-        free(item);
-        item = next;
-    }
-    HistoryEntry *hist = obj->history;
-    while (hist) {
-        HistoryEntry *next = hist->next;
-        free(hist);
-        hist = next;
-    }
-    free(obj);
+    char dest[MAX_PATH], tmp[MAX_PATH];
+    size_t len = strlen(project_file);
+    if (to_dir) snprintf(dest, MAX_PATH, "%.*s", (int)(len - 4), project_file);
+    else snprintf(dest, MAX_PATH, "%s.txt", project_file);
+    const char *slash = strrchr(dest, '/');
+    size_t dir_len = slash ? (size_t)(slash - dest) + 1 : 0;
+    snprintf(tmp, MAX_PATH, "%.*s.%s", (int)dir_len, dest, dest + dir_len);
 
-    if (save_project_file(project_file, proj)) {
-        printf("Deleted object '%s' from project\n", object_name);
+    Project *proj = load_project_file(project_file);
+    if (!proj) return;
+    int objects = 0;
+    for (Object *o = proj->objects; o; o = o->next) objects++;
+
+    remove_project_path(tmp);
+    int ok = to_dir ? save_project_dir(tmp, proj, 1) : save_project_file(tmp, proj);
+    if (ok) {
+        Project *check = load_project_file(tmp);
+        int check_objects = 0;
+        for (Object *o = check ? check->objects : NULL; o; o = o->next) check_objects++;
+        ok = check && check->index == proj->index && check_objects == objects;
+        free_project(check);
     }
-
     free_project(proj);
+    if (!ok || rename(tmp, dest) != 0) {
+        remove_project_path(tmp);
+        print_error("Failed to migrate project '%s'\n", ident);
+        return;
+    }
+    remove_project_path(project_file);
+    printf("Migrated project '%s' to the %s layout (%d object%s)\n", ident,
+           to_dir ? "directory" : "single-file", objects, objects == 1 ? "" : "s");
 }
 
-/* Delete a project file by index */
-void delete_project(Config *cfg, const char *ident) {
-    int primary, counter;
-    load_config_data(cfg, &primary, &counter);
+/* Bytes on disk for a project, summing every file in the directory layout */
+static long project_size(const char *path) {
+    if (!is_directory(path)) return file_size(path);
+    DIR *dir = opendir(path);
+    if (!dir) return -1;
+    long total = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        char file[MAX_PATH];
+        snprintf(file, MAX_PATH, "%s/%s", path, entry->d_name);
+        long size = file_size(file);
+        if (size > 0) total += size;
+    }
+    closedir(dir);
+    return total;
+}
 
+/* funknotes compact <project>: rewrite a project with its journal of
+ * tombstones and edits folded in. Writes also do this on their own once the
+ * journal passes COMPACT_MIN_RECORDS and a quarter of the items.
+ */
+void compact_project(Config *cfg, const char *ident) {
     char project_file[MAX_PATH];
     int proj_idx = -1;
     if (!get_project_file_by_ident(cfg, ident, project_file, &proj_idx)) {
-        printf("Project '%s' not found\n", ident);
+        print_error("Project '%s' not found\n", ident);
         return;
     }
-
-    // Confirm before removing the file
-    printf("Delete project '%s' (index %d)? y/N: ", ident, proj_idx);
-    fflush(stdout);
-    char resp[8];
-    if (!fgets(resp, sizeof(resp), stdin) || (resp[0] != 'y' && resp[0] != 'Y')) {
-        printf("Deletion cancelled\n");
+    Project *proj = load_project_file(project_file);
+    if (!proj) {
+        print_error("Failed to load project '%s'\n", ident);
+        return;
+    }
+    int records = 0;
+    for (JournalEntry *e = proj->journal; e; e = e->next) records++;
+    if (records == 0) {
+        printf("Project '%s' has nothing to compact\n", ident);
+        free_project(proj);
         return;
     }
-    // Remove the file only if confirmed
-    if (remove(project_file) == 0) {
-        printf("Deleted project '%s' (index %d)\n", ident, proj_idx);
 
-        // If deleted project was primary, unset primary
-        if (primary == proj_idx) {
-            save_config_data(cfg, -1, counter);
-            printf("Primary project was deleted; primary unset.\n");
-        }
+    long before = project_size(project_file);
+    int ok;
+    if (is_directory(project_file)) {
+        for (Object *o = proj->objects; o; o = o->next) o->dirty = 1;
+        ok = save_project_dir(project_file, proj, 1);
     } else {
-        printf("Failed to delete project file '%s'\n", project_file);
+        ok = save_project_file(project_file, proj);
     }
+    free_project(proj);
+    if (!ok) {
+        print_error("Failed to compact project '%s'\n", ident);
+        return;
+    }
+    printf("Compacted project '%s': folded %d journal record%s (%ld -> %ld bytes)\n", ident,
+           records, records == 1 ? "" : "s", before, project_size(project_file));
 }
 
-/* Delete a specific item (1-based index) from an object in the primary project */
-void delete_item_from_object(Config *cfg, const char *object_name, int item_index) {
+/* Print an object's retention policy */
+static void print_retention(const Object *obj) {
+    if (obj->retain_items) printf("Object '%s' keeps its newest %d items hot", obj->name, obj->retain_items);
+    else if (obj->retain_days) printf("Object '%s' keeps the last %d day%s hot", obj->name, obj->retain_days, obj->retain_days == 1 ? "" : "s");
+    else printf("Object '%s' has no retention policy", obj->name);
+    printf(" (%d cold item%s)\n", obj->cold, obj->cold == 1 ? "" : "s");
+}
+
+/* funknotes retain <object> [<N>|<N>d|off]: show or set how much of an
+ * object in the primary project stays in the project file. Setting a
+ * policy applies it at once, with the cold tier read back in so a looser
+ * policy (or off) returns items to the hot tier.
+ */
+void retain_command(Config *cfg, const char *object_name, const char *policy) {
+    int items = 0, days = 0;
+    if (policy && strcmp(policy, "off") != 0) {
+        char *end;
+        long n = strtol(policy, &end, 10);
+        if (end == policy || n < 1 || n > INT32_MAX || (*end && strcmp(end, "d") != 0)) {
+            print_error("Invalid policy '%s' (keep the newest <N> items, the last <N>d days, or off)\n", policy);
+            return;
+        }
+        if (*end) days = (int)n;
+        else items = (int)n;
+    }
+
     int primary, counter;
     load_config_data(cfg, &primary, &counter);
-
     if (primary < 0) {
-        printf("No primary project set. Use 'funknotes primary <project>' first.\n");
+        print_error("No primary project set. Use 'funknotes primary <project>' first.\n");
         return;
     }
-
     char project_file[MAX_PATH];
     if (!get_project_file(cfg, primary, project_file)) {
-        printf("Primary project not found\n");
+        print_error("Primary project not found\n");
         return;
     }
 
-    Project *proj = load_project_file(project_file);
+    Project *proj = policy ? load_project_for_object(project_file, object_name) : load_project_overview(project_file);
     if (!proj) return;
-
     Object *obj = find_object(proj, object_name);
     if (!obj) {
-        printf("Object '%s' not found\n", object_name);
-        free_project(proj);
+        print_error("Object '%s' not found\n", object_name);
+        release_project(proj);
         return;
     }
-
-    int item_count = count_items(obj);
-    if (item_index < 1 || item_index > item_count) {
-        printf("Item %d not found in object '%s'\n", item_index, object_name);
-        free_project(proj);
+    if (!policy) {
+        print_retention(obj);
+        release_project(proj);
         return;
     }
 
-    // Confirm deletion
-    if (isatty(STDIN_FILENO)) {
-        printf("Delete item %d from '%s'? y/N: ", item_index, object_name);
-        fflush(stdout);
-        char resp[8];
-        if (!fgets(resp, sizeof(resp), stdin) || (resp[0] != 'y' && resp[0] != 'Y')) {
-            printf("Deletion cancelled\n");
-            free_project(proj);
-            return;
+    fold_cold_tier(project_file, proj);
+    obj->retain_items = items;
+    obj->retain_days = days;
+    obj->dirty = 1;
+    if (save_project_file(project_file, proj)) print_retention(obj);
+    free_project(proj);
+}
+
+// ===== Line Editing & Completion ===== //
+// The shells read lines through read_line(): on a terminal it edits in raw
+// mode and completes words on Tab from prefix tries that are built once per
+// shell session (commands, catalog project names and indices, and objects
+// of the primary project). Without a terminal it falls back to fgets().
+
+#define MAX_COMPLETIONS 256
+
+typedef struct TrieNode {
+    char c;
+    int terminal;                 // a word ends here
+    struct TrieNode *child;       // children sorted by c
+    struct TrieNode *sibling;
+} TrieNode;
+
+static void trie_insert(TrieNode *root, const char *word) {
+    TrieNode *node = root;
+    for (const char *p = word; *p; p++) {
+        TrieNode **link = &node->child;
+        while (*link && (unsigned char)(*link)->c < (unsigned char)*p) link = &(*link)->sibling;
+        if (!*link || (*link)->c != *p) {
+            TrieNode *n = calloc(1, sizeof(TrieNode));
+            if (!n) return;
+            n->c = *p;
+            n->sibling = *link;
+            *link = n;
         }
-    } else {
-        printf("Non-interactive mode: deletion of item %d aborted\n", item_index);
-        free_project(proj);
-        return;
+        node = *link;
     }
+    node->terminal = 1;
+}
 
-    // Get items as array to find the one to delete
-    int count;
-    Item **items = get_items_array(obj, &count);
-    Item *del_item = items[item_index - 1];
-    char del_text[MAX_TEXT];
-    strncpy(del_text, del_item->text, MAX_TEXT - 1);
-    del_text[MAX_TEXT - 1] = '\0';
+static void trie_free_children(TrieNode *node) {
+    TrieNode *child = node->child;
+    while (child) {
+        TrieNode *next = child->sibling;
+        trie_free_children(child);
+        free(child);
+        child = next;
+    }
+    node->child = NULL;
+}
 
-    // Remove item from linked list (items are in reverse order)
-    int target_idx = count - item_index;
-    if (target_idx == 0) {
-        // First item in list
-        obj->items = del_item->next;
-    } else {
-        Item *prev = obj->items;
-        for (int i = 0; i < target_idx - 1; i++) {
-            if (!prev) break;
-            prev = prev->next;
+/* Depth-first walk below node, adding word (of length len so far) for each
+ * terminal to cands, in sorted order */
+static void trie_collect(const TrieNode *node, char *word, size_t len, char **cands, int *n) {
+    if (node->terminal && *n < MAX_COMPLETIONS) {
+        word[len] = '\0';
+        cands[(*n)++] = strdup(word);
+    }
+    if (len + 1 >= MAX_TEXT) return;
+    for (const TrieNode *c = node->child; c && *n < MAX_COMPLETIONS; c = c->sibling) {
+        word[len] = c->c;
+        trie_collect(c, word, len + 1, cands, n);
+    }
+}
+
+/* Append every word starting with prefix to cands */
+static void trie_complete(const TrieNode *root, const char *prefix, char **cands, int *n) {
+    const TrieNode *node = root;
+    for (const char *p = prefix; *p && node; p++) {
+        node = node->child;
+        while (node && node->c != *p) node = node->sibling;
+    }
+    if (!node) return;
+    char word[MAX_TEXT];
+    snprintf(word, sizeof(word), "%s", prefix);
+    trie_collect(node, word, strlen(word), cands, n);
+}
+
+static const char *const shell_commands[] = {
+    "add", "archive", "bench", "clear", "compact", "daemon", "dedupe", "delete", "diff", "drop",
+    "edit", "exit", "fsck", "help", "import", "merge", "migrate", "new", "open", "primary", "projects",
+    "q", "quit", "retain", "search", "show", "snapshot", "stats", "sync", "tags", "unarchive", NULL
+};
+static const char *const object_shell_commands[] = { "clear", "delete", "drop", "exit", "q", "quit", "show", NULL };
+static const char *const delete_shell_commands[] = { "clear", "delete", "drop", "exit", "q", "quit", NULL };
+static const char *const delete_mode_commands[] = { "clear", "drop", "exit", "q", "quit", NULL };
+
+/* Commands whose arguments are projects, not objects */
+static const char *const project_commands[] = {
+    "archive", "compact", "dedupe", "fsck", "migrate", "primary", "unarchive", NULL
+};
+
+typedef struct {
+    TrieNode commands;   // first word
+    TrieNode keywords;   // second word of new/delete/merge
+    TrieNode projects;   // catalog names and indices
+    TrieNode objects;    // objects of the primary project
+    int projects_aware;  // the funknotes shell: complete projects too
+} Completion;
+
+static int word_in(const char *word, const char *const *list) {
+    for (; *list; list++) if (strcmp(word, *list) == 0) return 1;
+    return 0;
+}
+
+/* (Re)build the project and object tries. Names come from the catalog's
+ * file names and the primary project's header, so nothing is parsed in full. */
+void completion_refresh(Completion *comp, Config *cfg) {
+    trie_free_children(&comp->projects);
+    trie_free_children(&comp->objects);
+
+    int primary, counter;
+    load_config_data(cfg, &primary, &counter);
+    if (comp->projects_aware) {
+        DIR *dir = opendir(cfg->projects_dir);
+        struct dirent *entry;
+        while (dir && (entry = readdir(dir)) != NULL) {
+            if (!is_project_entry(cfg->projects_dir, entry->d_name)) continue;
+            // <index>_<name>[.txt|.fnz]
+            char name[MAX_TEXT];
+            const char *under = strchr(entry->d_name, '_');
+            if (!under) continue;
+            snprintf(name, sizeof(name), "%.*s", (int)(under - entry->d_name), entry->d_name);
+            trie_insert(&comp->projects, name);
+            snprintf(name, sizeof(name), "%s", under + 1);
+            char *dot = strrchr(name, '.');
+            if (dot) *dot = '\0';
+            trie_insert(&comp->projects, name);
         }
-        if (prev && prev->next) {
-            prev->next = prev->next->next;
+        if (dir) closedir(dir);
+    }
+
+    char project_file[MAX_PATH];
+    if (primary >= 0 && get_project_file(cfg, primary, project_file)) {
+        Project *proj = load_project_overview(project_file);
+        for (Object *obj = proj ? proj->objects : NULL; obj; obj = obj->next) {
+            trie_insert(&comp->objects, obj->name);
         }
+        if (proj) release_project(proj);
     }
-    free(del_item);
-    free(items);
+}
 
-    // Add history entry
-    char timestamp[64];
-    get_timestamp(timestamp, sizeof(timestamp));
-    HistoryEntry *hist = calloc(1, sizeof(HistoryEntry));
-    strcpy(hist->action, "DELETE_ITEM");
-    strncpy(hist->timestamp, timestamp, 63);
-    hist->timestamp[63] = '\0';
-    strncpy(hist->text, del_text, MAX_TEXT - 1);
-    hist->text[MAX_TEXT - 1] = '\0';
-    hist->next = obj->history;
-    obj->history = hist;
+void completion_init(Completion *comp, Config *cfg, const char *const *commands, int projects_aware) {
+    memset(comp, 0, sizeof(*comp));
+    comp->projects_aware = projects_aware;
+    for (; *commands; commands++) trie_insert(&comp->commands, *commands);
+    if (projects_aware) {
+        trie_insert(&comp->keywords, "object");
+        trie_insert(&comp->keywords, "project");
+        trie_insert(&comp->keywords, "projects");
+    }
+    completion_refresh(comp, cfg);
+}
 
-    // Write back
-    if (save_project_file(project_file, proj)) {
-        printf("Deleted item %d from '%s'\n", item_index, object_name);
+void completion_free(Completion *comp) {
+    trie_free_children(&comp->commands);
+    trie_free_children(&comp->keywords);
+    trie_free_children(&comp->projects);
+    trie_free_children(&comp->objects);
+}
+
+static int cmp_str(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Candidates for the word at buf[start..end), chosen by the words before it.
+ * Returns the count; cands are sorted, unique and malloc'd. */
+static int completion_candidates(const Completion *comp, const char *buf, size_t start, size_t end, char **cands) {
+    char prefix[MAX_TEXT], first[MAX_TEXT] = "", second[MAX_TEXT] = "";
+    snprintf(prefix, sizeof(prefix), "%.*s", (int)(end - start), buf + start);
+    int word = 0;
+    for (size_t i = 0; i < start; ) {
+        while (i < start && buf[i] == ' ') i++;
+        size_t w = i;
+        while (i < start && buf[i] != ' ') i++;
+        if (i == w) break;
+        if (word == 0) snprintf(first, sizeof(first), "%.*s", (int)(i - w), buf + w);
+        if (word == 1) snprintf(second, sizeof(second), "%.*s", (int)(i - w), buf + w);
+        word++;
+    }
+
+    int n = 0;
+    if (word == 0) {
+        trie_complete(&comp->commands, prefix, cands, &n);
+    } else if (comp->projects_aware && (word_in(first, project_commands) ||
+               (word >= 2 && (!strcmp(second, "project") || !strcmp(second, "projects"))))) {
+        trie_complete(&comp->projects, prefix, cands, &n);
     } else {
-        printf("Failed to write project file\n");
+        if (word == 1 && (!strcmp(first, "new") || !strcmp(first, "delete") || !strcmp(first, "merge"))) {
+            trie_complete(&comp->keywords, prefix, cands, &n);
+        }
+        trie_complete(&comp->objects, prefix, cands, &n);
+        if (comp->projects_aware) trie_complete(&comp->projects, prefix, cands, &n);
     }
 
-    free_project(proj);
+    qsort(cands, n, sizeof(char*), cmp_str);
+    int out = 0;
+    for (int i = 0; i < n; i++) {
+        if (out > 0 && strcmp(cands[out-1], cands[i]) == 0) free(cands[i]);
+        else cands[out++] = cands[i];
+    }
+    return out;
 }
 
-/* Delete multiple items from an object. `index_list` can be comma-separated numbers and ranges like "1,3,5-7" */
-void delete_items_from_object(Config *cfg, const char *object_name, const char *index_list) {
-    int primary, counter;
-    load_config_data(cfg, &primary, &counter);
+/* Redraw the edit line and put the terminal cursor at pos */
+static void redraw_line(const char *prompt, const char *buf, size_t len, size_t pos) {
+    printf("\r%s%.*s\033[K", prompt, (int)len, buf);
+    if (len > pos) printf("\033[%dD", (int)(len - pos));
+    fflush(stdout);
+}
 
-    if (primary < 0) {
-        printf("No primary project set. Use 'funknotes primary <project>' first.\n");
-        return;
-    }
+/* Insert text at *pos */
+static void insert_text(char *buf, size_t size, size_t *len, size_t *pos, const char *text) {
+    size_t n = strlen(text);
+    if (*len + n >= size) n = size - 1 - *len;
+    memmove(buf + *pos + n, buf + *pos, *len - *pos);
+    memcpy(buf + *pos, text, n);
+    *len += n;
+    *pos += n;
+    buf[*len] = '\0';
+}
 
-    char project_file[MAX_PATH];
-    if (!get_project_file(cfg, primary, project_file)) {
-        printf("Primary project not found\n");
-        return;
+/* Complete the word before the cursor: a unique match is inserted with a
+ * trailing space, several extend to their common prefix, and a second Tab
+ * lists them. */
+static void complete_word(const Completion *comp, const char *prompt, char *buf, size_t size,
+                          size_t *len, size_t *pos, int list) {
+    size_t start = *pos;
+    while (start > 0 && buf[start-1] != ' ') start--;
+    char *cands[MAX_COMPLETIONS];
+    int n = completion_candidates(comp, buf, start, *pos, cands);
+    size_t have = *pos - start;
+    if (n == 0) {
+        putchar('\a');
+    } else if (n == 1) {
+        insert_text(buf, size, len, pos, cands[0] + have);
+        if (*pos == *len) insert_text(buf, size, len, pos, " ");
+    } else {
+        size_t common = strlen(cands[0]);
+        for (int i = 1; i < n; i++) {
+            size_t k = 0;
+            while (k < common && cands[i][k] == cands[0][k]) k++;
+            common = k;
+        }
+        if (common > have) {
+            char ext[MAX_TEXT];
+            snprintf(ext, sizeof(ext), "%.*s", (int)(common - have), cands[0] + have);
+            insert_text(buf, size, len, pos, ext);
+        } else if (list) {
+            putchar('\n');
+            for (int i = 0; i < n; i++) printf("%s%s", cands[i], i + 1 < n ? "  " : "\n");
+            if (n == MAX_COMPLETIONS) printf("(more not shown)\n");
+        } else {
+            putchar('\a');
+        }
     }
+    for (int i = 0; i < n; i++) free(cands[i]);
+    redraw_line(prompt, buf, *len, *pos);
+}
 
-    // Parse index_list into a set of integers
-    int *indexes = NULL;
-    int idx_count = 0;
+static int read_input_line(const char *prompt, char *buf, size_t size, const Completion *comp);
+
+/* Print prompt and read one line into buf (newline stripped on a terminal,
+ * kept by the fgets fallback like before). Returns 0 on end of input, which
+ * Ctrl+C and Ctrl+D on an empty line also signal at a terminal. The write
+ * lock is let go while waiting, so an idle shell holds up no other writer. */
+int read_line(const char *prompt, char *buf, size_t size, const Completion *comp) {
+    int held = g_write_lock >= 0;
+    unlock_writes();
+    int ok = read_input_line(prompt, buf, size, comp);
+    if (held) lock_writes(g_write_lock_home, 0);
+    return ok;
+}
 
-    char *s = strdup(index_list);
-    char *tok = strtok(s, ",");
-    while (tok) {
-        // Trim
-        while (*tok == ' ') tok++;
-        char *dash = strchr(tok, '-');
-        if (dash) {
-            // range a-b
-            *dash = '\0';
-            int a = atoi(tok);
-            int b = atoi(dash + 1);
-            if (a <= 0 || b <= 0) { tok = strtok(NULL, ","); continue; }
-            if (a > b) { int t=a;a=b;b=t; }
-            for (int v = a; v <= b; ++v) {
-                indexes = realloc(indexes, sizeof(int) * (idx_count + 1));
-                indexes[idx_count++] = v;
+static int read_input_line(const char *prompt, char *buf, size_t size, const Completion *comp) {
+    printf("%s", prompt);
+    fflush(stdout);
+    struct termios orig;
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &orig) != 0) {
+        return fgets(buf, (int)size, stdin) != NULL;
+    }
+    struct termios raw = orig;
+    raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+    raw.c_iflag &= ~(IXON | ICRNL);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+
+    size_t len = 0, pos = 0;
+    int ok = 1, tabs = 0;
+    buf[0] = '\0';
+    for (;;) {
+        unsigned char c;
+        if (read(STDIN_FILENO, &c, 1) != 1) { ok = 0; break; }
+        tabs = c == '\t' ? tabs + 1 : 0;
+        if (c == '\r' || c == '\n') {
+            break;
+        } else if (c == 3 || (c == 4 && len == 0)) {          // Ctrl+C, Ctrl+D
+            ok = 0;
+            break;
+        } else if (c == '\t') {
+            if (comp) complete_word(comp, prompt, buf, size, &len, &pos, tabs > 1);
+            continue;
+        } else if (c == 127 || c == 8) {                      // Backspace
+            if (pos == 0) continue;
+            memmove(buf + pos - 1, buf + pos, len - pos);
+            pos--;
+            buf[--len] = '\0';
+        } else if (c == 4) {                                  // Ctrl+D: delete under cursor
+            if (pos == len) continue;
+            memmove(buf + pos, buf + pos + 1, len - pos - 1);
+            buf[--len] = '\0';
+        } else if (c == 1) {                                  // Ctrl+A
+            pos = 0;
+        } else if (c == 5) {                                  // Ctrl+E
+            pos = len;
+        } else if (c == 11) {                                 // Ctrl+K
+            len = pos;
+            buf[len] = '\0';
+        } else if (c == 21) {                                 // Ctrl+U
+            memmove(buf, buf + pos, len - pos);
+            len -= pos;
+            pos = 0;
+            buf[len] = '\0';
+        } else if (c == 23) {                                 // Ctrl+W
+            size_t start = pos;
+            while (start > 0 && buf[start-1] == ' ') start--;
+            while (start > 0 && buf[start-1] != ' ') start--;
+            memmove(buf + start, buf + pos, len - pos);
+            len -= pos - start;
+            pos = start;
+            buf[len] = '\0';
+        } else if (c == 27) {                                 // Arrows, Home/End, Delete
+            unsigned char seq[3];
+            if (read(STDIN_FILENO, seq, 1) != 1 || (seq[0] != '[' && seq[0] != 'O')) continue;
+            if (read(STDIN_FILENO, seq + 1, 1) != 1) continue;
+            if (seq[1] == 'C' && pos < len) pos++;
+            else if (seq[1] == 'D' && pos > 0) pos--;
+            else if (seq[1] == 'H') pos = 0;
+            else if (seq[1] == 'F') pos = len;
+            else if (seq[1] >= '0' && seq[1] <= '9') {
+                if (read(STDIN_FILENO, seq + 2, 1) != 1 || seq[2] != '~') continue;
+                if ((seq[1] == '1' || seq[1] == '7')) pos = 0;
+                else if (seq[1] == '4' || seq[1] == '8') pos = len;
+                else if (seq[1] == '3' && pos < len) {
+                    memmove(buf + pos, buf + pos + 1, len - pos - 1);
+                    buf[--len] = '\0';
+                }
             }
+        } else if (c >= 32 && len + 1 < size) {
+            char s[2] = { (char)c, '\0' };
+            insert_text(buf, size, &len, &pos, s);
         } else {
-            int v = atoi(tok);
-            if (v > 0) {
-                indexes = realloc(indexes, sizeof(int) * (idx_count + 1));
-                indexes[idx_count++] = v;
-            }
+            continue;
         }
-        tok = strtok(NULL, ",");
+        redraw_line(prompt, buf, len, pos);
     }
-    free(s);
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig);
+    if (ok) putchar('\n');   // callers print their own goodbye on end of input
+    fflush(stdout);
+    return ok;
+}
 
-    if (idx_count == 0) {
-        printf("No valid indexes provided\n");
-        free(indexes);
-        return;
+// ===== Batch ===== //
+// funknotes batch [file|-] runs one command per line in this process. Every
+// project a command touches is loaded once and stays resident; saves only
+// mark it pending, and pending projects are written once at the end (staged
+// under hidden names, then renamed into place). Commands that rename or
+// remove project files themselves are refused.
+
+typedef struct BatchProject {
+    char path[MAX_PATH];
+    Project *proj;
+    struct BatchProject *next;
+} BatchProject;
+
+static BatchProject *g_batch_projects = NULL;
+
+/* The resident copy of a project, loaded in full on first use. A --cold
+ * line folds the cold tier into it, as load_project_file() does. */
+static Project* batch_project(const char *filename) {
+    for (BatchProject *b = g_batch_projects; b; b = b->next) {
+        if (strcmp(b->path, filename) != 0) continue;
+        if (g_cold) fold_cold_tier(filename, b->proj);
+        return b->proj;
     }
+    Project *proj = load_project_disk(filename);
+    if (!proj) return NULL;
+    if (g_cold) fold_cold_tier(filename, proj);
+    BatchProject *b = calloc(1, sizeof(BatchProject));
+    if (!b) return proj;
+    snprintf(b->path, MAX_PATH, "%s", filename);
+    proj->pinned = 1;
+    b->proj = proj;
+    b->next = g_batch_projects;
+    g_batch_projects = b;
+    return proj;
+}
 
-    // Deduplicate and sort descending
-    // Simple O(n^2) dedupe since counts are expected small
-    for (int i = 0; i < idx_count; ++i) {
-        for (int j = i + 1; j < idx_count; ) {
-            if (indexes[i] == indexes[j]) {
-                // remove j
-                for (int k = j; k < idx_count - 1; ++k) indexes[k] = indexes[k+1];
-                idx_count--; indexes = realloc(indexes, sizeof(int) * idx_count);
-            } else j++;
-        }
+/* Write every pending project (unless discard) and drop the resident copies.
+ * Single-file projects are all staged before any is renamed, so a failed
+ * write leaves every file as it was. Returns the number written, -1 on error. */
+static int batch_finish(int discard) {
+    int written = 0, ok = 1;
+    for (BatchProject *b = g_batch_projects; b && ok && !discard; b = b->next) {
+        if (!b->proj->pending || is_directory(b->path)) continue;
+        char tmp[MAX_PATH];
+        project_temp_path(b->path, tmp);
+        ok = save_project_file(tmp, b->proj);
     }
-    // sort descending
-    for (int i = 0; i < idx_count; ++i) {
-        for (int j = i + 1; j < idx_count; ++j) {
-            if (indexes[j] > indexes[i]) { int t = indexes[i]; indexes[i] = indexes[j]; indexes[j] = t; }
+    for (BatchProject *b = g_batch_projects; b && !discard; b = b->next) {
+        if (!b->proj->pending) continue;
+        if (is_directory(b->path)) {
+            if (ok && save_project_dir(b->path, b->proj, 0)) written++;
+            else ok = 0;
+            continue;
         }
+        char tmp[MAX_PATH];
+        project_temp_path(b->path, tmp);
+        if (ok && rename(tmp, b->path) == 0) written++;
+        else remove(tmp);
+    }
+    while (g_batch_projects) {
+        BatchProject *next = g_batch_projects->next;
+        g_batch_projects->proj->pinned = 0;
+        free_project(g_batch_projects->proj);
+        free(g_batch_projects);
+        g_batch_projects = next;
     }
+    return ok ? written : -1;
+}
 
-    // Confirm deletion
-    if (isatty(STDIN_FILENO)) {
-        printf("Delete items %s from '%s'? y/N: ", index_list, object_name);
-        fflush(stdout);
-        char resp[8];
-        if (!fgets(resp, sizeof(resp), stdin) || (resp[0] != 'y' && resp[0] != 'Y')) {
-            printf("Deletion cancelled\n");
-            free(indexes);
-            return;
+/* Split a batch line into words in place: blanks separate and "..." or
+ * '...' quote. Lines starting with # are comments (#<id> arguments are not). */
+static int split_command_line(char *line, char **args, int max) {
+    int n = 0;
+    char *p = line;
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '#') return 0;
+    while (n < max) {
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+        if (!*p) break;
+        char *out = p;
+        args[n++] = p;
+        char quote = 0;
+        while (*p && (quote || (*p != ' ' && *p != '\t' && *p != '\r' && *p != '\n'))) {
+            if (!quote && (*p == '"' || *p == '\'')) quote = *p++;
+            else if (quote && *p == quote) { quote = 0; p++; }
+            else *out++ = *p++;
         }
-    } else {
-        printf("Non-interactive mode: deletion aborted\n");
-        free(indexes);
-        return;
+        if (*p) p++;
+        *out = '\0';
     }
+    return n;
+}
 
-    // Load project
-    Project *proj = load_project_file(project_file);
-    if (!proj) { free(indexes); return; }
+/* Commands that manage project files directly, or need a terminal: the
+ * refused form to report, or NULL if the command may run */
+static const char* batch_refuses(int ac, char **args) {
+    static const char *const refused[] = {
+        "archive", "batch", "bench", "compact", "daemon", "migrate", "open", "shell", "snapshot", "sync", "unarchive", NULL
+    };
+    if (word_in(args[0], refused)) return args[0];
+    if (ac >= 2 && strcmp(args[0], "delete") == 0 &&
+        (strcmp(args[1], "project") == 0 || strcmp(args[1], "projects") == 0)) return "delete project";
+    if (ac >= 2 && strcmp(args[0], "merge") == 0 && strcmp(args[1], "projects") == 0) return "merge projects";
+    // Without text, add opens the object shell
+    if (ac == 2 && strcmp(args[0], "add") == 0) return "add <object> without text";
+    return NULL;
+}
 
-    Object *obj = find_object(proj, object_name);
-    if (!obj) {
-        printf("Object '%s' not found\n", object_name);
-        free_project(proj); free(indexes); return;
+/* Entries of the projects directory, to undo project creation on rollback */
+static char** list_dir_names(const char *path, int *count) {
+    *count = 0;
+    DIR *dir = opendir(path);
+    if (!dir) return NULL;
+    char **names = NULL;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char **grown = realloc(names, sizeof(char*) * (*count + 1));
+        if (!grown) break;
+        names = grown;
+        names[(*count)++] = strdup(entry->d_name);
     }
+    closedir(dir);
+    return names;
+}
 
-    int item_count = count_items(obj);
-    if (item_count == 0) {
-        printf("No items in object '%s'\n", object_name);
-        free_project(proj); free(indexes); return;
+static char* read_file_contents(const char *path, size_t *len) {
+    *len = 0;
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    char *buf = NULL;
+    size_t cap = 0;
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        char *grown = realloc(buf, cap + n);
+        if (!grown) break;
+        buf = grown;
+        memcpy(buf + cap, chunk, n);
+        cap += n;
     }
+    fclose(f);
+    *len = cap;
+    return buf ? buf : strdup("");
+}
 
-    // Build mark array
-    char *mark = calloc(item_count, 1);
-    int any_marked = 0;
-    for (int i = 0; i < idx_count; ++i) {
-        int v = indexes[i];
-        if (v < 1 || v > item_count) continue;
-        mark[v-1] = 1; any_marked = 1;
+/* funknotes batch [file|-] [--yes] [--all-or-nothing]
+ * The script is read in full first; commands then see /dev/null on stdin, so
+ * confirmations are refused unless --yes answers them. With --all-or-nothing
+ * the first failing command stops the batch and nothing is written: pending
+ * projects are dropped, config.txt is restored and projects created by the
+ * batch are removed.
+ */
+int batch_command(Config *cfg, char *prog, int argc, char **argv) {
+    int all_or_nothing = extract_flag(&argc, argv, "--all-or-nothing");
+    g_assume_yes = extract_flag(&argc, argv, "--yes");
+    if (argc > 3) {
+        print_error("Usage: funknotes batch [file|-] [--yes] [--all-or-nothing]\n");
+        return 1;
     }
+    const char *source = argc == 3 ? argv[2] : "-";
 
-    if (!any_marked) {
-        printf("No matching items to delete\n");
-        free_project(proj); free(indexes); free(mark);
-        return;
+    FILE *in = strcmp(source, "-") == 0 ? stdin : fopen(source, "r");
+    if (!in) {
+        print_error("Cannot open '%s'\n", source);
+        return 1;
+    }
+    char **lines = NULL;
+    int line_count = 0;
+    char buf[MAX_LINE];
+    while (fgets(buf, sizeof(buf), in)) {
+        char **grown = realloc(lines, sizeof(char*) * (line_count + 1));
+        if (!grown) break;
+        lines = grown;
+        lines[line_count++] = strdup(buf);
+    }
+    if (in != stdin) fclose(in);
+
+    // Snapshot what a rollback has to restore
+    size_t config_len = 0;
+    char *config = all_or_nothing ? read_file_contents(cfg->config_file, &config_len) : NULL;
+    int before_count = 0;
+    char **before = all_or_nothing ? list_dir_names(cfg->projects_dir, &before_count) : NULL;
+
+    int saved_stdin = dup(STDIN_FILENO);
+    int devnull = open("/dev/null", O_RDONLY);
+    if (devnull >= 0) {
+        dup2(devnull, STDIN_FILENO);
+        close(devnull);
     }
 
-    // Get items as array
-    int count;
-    Item **items = get_items_array(obj, &count);
-    
-    // Delete marked items and add to history
-    char timestamp[64];
-    get_timestamp(timestamp, sizeof(timestamp));
-    
-    // Delete items in reverse order (from highest index to lowest)
-    for (int i = idx_count - 1; i >= 0; i--) {
-        int v = indexes[i];
-        if (v < 1 || v > item_count || !mark[v-1]) continue;
-        
-        Item *del_item = items[v - 1];
-        
-        // Add to history
-        HistoryEntry *hist = calloc(1, sizeof(HistoryEntry));
-        strcpy(hist->action, "DELETE_ITEM");
-        strncpy(hist->timestamp, timestamp, 63);
-        hist->timestamp[63] = '\0';
-        strncpy(hist->text, del_item->text, MAX_TEXT - 1);
-        hist->text[MAX_TEXT - 1] = '\0';
-        hist->next = obj->history;
-        obj->history = hist;
-        
-        // Remove from linked list (items are in reverse order)
-        int target_idx = count - v;
-        if (target_idx == 0) {
-            obj->items = del_item->next;
+    g_batch_active = 1;
+    int commands = 0, failed = 0, stopped_at = 0;
+    for (int i = 0; i < line_count; i++) {
+        char *args[DAEMON_MAX_ARGS];
+        int ac = split_command_line(lines[i], args, DAEMON_MAX_ARGS - 1);
+        if (ac == 0) continue;
+        commands++;
+        int ok;
+        g_command_failed = 0;
+        const char *refused = batch_refuses(ac, args);
+        if (refused) {
+            print_error("'%s' cannot run inside a batch\n", refused);
+            ok = 0;
         } else {
-            Item *prev = obj->items;
-            for (int j = 0; j < target_idx - 1; j++) {
-                if (!prev) break;
-                prev = prev->next;
-            }
-            if (prev && prev->next) {
-                prev->next = prev->next->next;
+            char *fake_argv[DAEMON_MAX_ARGS + 1];
+            fake_argv[0] = prog;
+            for (int j = 0; j < ac; j++) fake_argv[j+1] = args[j];
+            fake_argv[ac+1] = NULL;
+            ok = main(ac + 1, fake_argv) == 0 && !g_command_failed;
+        }
+        if (!ok) {
+            failed++;
+            printf("batch: line %d failed\n", i + 1);
+            if (all_or_nothing) {
+                stopped_at = i + 1;
+                break;
             }
         }
-        free(del_item);
     }
-    
-    free(items);
-    free(mark);
+    g_batch_active = 0;
 
-    // Write back
-    if (save_project_file(project_file, proj)) {
-        printf("Deleted specified items from '%s'\n", object_name);
+    if (saved_stdin >= 0) {
+        dup2(saved_stdin, STDIN_FILENO);
+        close(saved_stdin);
+        clearerr(stdin);
+    }
+
+    int written = batch_finish(stopped_at != 0);
+    if (stopped_at) {
+        // Undo what went to disk immediately: config changes and new projects
+        FILE *f = config ? fopen(cfg->config_file, "wb") : NULL;
+        if (f) {
+            fwrite(config, 1, config_len, f);
+            fclose(f);
+        }
+        int after_count = 0;
+        char **after = list_dir_names(cfg->projects_dir, &after_count);
+        for (int i = 0; i < after_count; i++) {
+            int existed = 0;
+            for (int j = 0; j < before_count && !existed; j++) existed = strcmp(after[i], before[j]) == 0;
+            if (!existed && is_project_entry(cfg->projects_dir, after[i])) {
+                char path[MAX_PATH];
+                snprintf(path, MAX_PATH, "%s/%s", cfg->projects_dir, after[i]);
+                remove_project_path(path);
+            }
+            free(after[i]);
+        }
+        free(after);
+        printf("Batch stopped at line %d; no changes written\n", stopped_at);
+    } else if (written < 0) {
+        print_error("Failed to write batch results; projects left unchanged\n");
     } else {
-        printf("Failed to write project file\n");
+        printf("Batch: %d command%s, %d failed, %d project%s written\n", commands, commands == 1 ? "" : "s",
+               failed, written, written == 1 ? "" : "s");
     }
 
-    free_project(proj);
+    for (int i = 0; i < line_count; i++) free(lines[i]);
+    free(lines);
+    for (int i = 0; i < before_count; i++) free(before[i]);
+    free(before);
+    free(config);
+    g_assume_yes = 0;
+    return failed || written < 0 ? 1 : 0;
 }
 
-/* Search items across objects (or within a single object when object_name != NULL)
- * kwc = number of keywords, kws = array of keyword strings
- * Matching: case-insensitive substring match for each keyword (AND semantics)
- */
-void search(Config *cfg, const char *object_name, int kwc, char **kws) {
-    int primary, counter;
-    load_config_data(cfg, &primary, &counter);
+// ===== Sync ===== //
+// funknotes sync <other-home> merges two funknotes homes project by project,
+// matched by name. Each home keeps sync/<peer>.txt with what both sides
+// looked like after their last sync: a mark (checksum of the header's
+// summaries and rollups), next_id, and every object's history length. A
+// project whose marks are unchanged on both sides is skipped after reading
+// its headers. Otherwise items with ids at or past the last next_id are new
+// and are copied across (unless the other side has the same text at the
+// same time), and history past the last length carries the deletes and
+// edits, which are applied to the items both sides already shared. History
+// entries name their item's id, so deletes and edits of items added since
+// the last sync are never matched against shared ones. Only a side that
+// received records is written. Ids stay local: a copied item
+// takes the receiving side's next id, so ids of items added on both sides
+// between syncs differ between the homes.
+
+#define SYNC_DIR "sync"
+
+typedef struct SyncObject {
+    char name[MAX_TEXT];
+    int history[2];         // history entries after the last sync: this home, the other
+    struct SyncObject *next;
+} SyncObject;
 
-    if (primary < 0) {
-        printf("No primary project set. Use 'funknotes primary <project>' first.\n");
-        return;
-    }
+typedef struct SyncEntry {
+    char name[MAX_TEXT];
+    uint32_t mark[2];       // header marks after the last sync
+    uint32_t next_id[2];    // items below these ids were on both sides
+    SyncObject *objects;
+    struct SyncEntry *next;
+} SyncEntry;
 
-    char project_file[MAX_PATH];
-    if (!get_project_file(cfg, primary, project_file)) {
-        printf("Primary project not found\n");
-        return;
+typedef struct SyncProject {
+    char name[MAX_TEXT];
+    char path[MAX_PATH];
+    uint32_t mark;
+    uint32_t next_id;
+    struct SyncProject *next;
+} SyncProject;
+
+/* Checksum of a header-loaded project's next_id, summaries and rollups:
+ * any saved change to the project changes it */
+static uint32_t project_mark(Project *proj) {
+    uint32_t crc = crc32c(0, &proj->next_id, sizeof(proj->next_id));
+    for (Object *obj = proj->objects; obj; obj = obj->next) {
+        char fields[SUMMARY_FIELDS_LEN + ROLLUP_FIELDS_LEN + 2];
+        int count = obj->item_count;
+        if (!obj->stub) obj->item_count = count_items(obj);
+        format_summary_fields(obj, fields);
+        obj->item_count = count;
+        if (obj->rollup.valid) format_rollup_fields(&obj->rollup, fields + SUMMARY_FIELDS_LEN);
+        crc = crc32c(crc, fields, strlen(fields));
+        crc = crc32c(crc, obj->name, strlen(obj->name) + 1);
     }
+    return crc;
+}
 
-    Project *proj = load_project_file(project_file);
-    if (!proj) return;
+static uint32_t project_file_mark(const char *path) {
+    Project *proj = load_project_header(path);
+    if (!proj) return 0;
+    uint32_t mark = project_mark(proj);
+    free_project(proj);
+    return mark;
+}
 
-    if (!proj->objects) {
-        printf("No objects in primary project\n");
+/* Name, path and mark of every project in a projects directory */
+static SyncProject* sync_list_projects(const char *projects_dir) {
+    SyncProject *list = NULL;
+    DIR *dir = opendir(projects_dir);
+    if (!dir) return NULL;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!is_project_entry(projects_dir, entry->d_name)) continue;
+        SyncProject *sp = calloc(1, sizeof(SyncProject));
+        if (!sp) break;
+        snprintf(sp->path, MAX_PATH, "%s/%s", projects_dir, entry->d_name);
+        Project *proj = load_project_header(sp->path);
+        if (!proj) { free(sp); continue; }
+        snprintf(sp->name, MAX_TEXT, "%s", proj->name);
+        sp->mark = project_mark(proj);
+        sp->next_id = proj->next_id;
         free_project(proj);
-        return;
+        sp->next = list;
+        list = sp;
     }
+    closedir(dir);
+    return list;
+}
 
-    // For each item we will test all keywords with strcasestr (AND semantics)
+static SyncProject* find_sync_project(SyncProject *list, const char *name) {
+    while (list && strcmp(list->name, name) != 0) list = list->next;
+    return list;
+}
 
-    if (object_name) {
-        Object *obj = find_object(proj, object_name);
-        if (!obj) {
-            printf("Object '%s' not found\n", object_name);
-            free_project(proj);
-            return;
+static void sync_state_path(const char *home_dir, const char *other, char *path) {
+    snprintf(path, MAX_PATH, "%s/" SYNC_DIR "/%08x.txt", home_dir, crc32c(0, other, strlen(other)));
+}
+
+/* The sync state home_dir keeps for `other`, or NULL before the first sync.
+ * With flip set the sides are swapped (reading the other home's copy). */
+static SyncEntry* sync_load_state(const char *home_dir, const char *other, int flip) {
+    char path[MAX_PATH], line[MAX_LINE];
+    sync_state_path(home_dir, other, path);
+    FILE *f = fopen(path, "r");
+    if (!f) return NULL;
+    SyncEntry *list = NULL;
+    int ours = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        char *eq = strchr(line, '=');
+        if (!eq) continue;
+        *eq = '\0';
+        char *value = eq + 1;
+        if (strcmp(line, "peer") == 0) {
+            ours = strcmp(value, other) == 0;
+        } else if (ours && strcmp(line, "project") == 0) {
+            SyncEntry *e = calloc(1, sizeof(SyncEntry));
+            int name_at = 0;
+            if (!e) break;
+            if (sscanf(value, "%x|%x|%u|%u|%n", &e->mark[flip], &e->mark[!flip],
+                       &e->next_id[flip], &e->next_id[!flip], &name_at) < 4 || !name_at) {
+                free(e);
+                continue;
+            }
+            snprintf(e->name, MAX_TEXT, "%s", value + name_at);
+            e->next = list;
+            list = e;
+        } else if (ours && list && strcmp(line, "object") == 0) {
+            SyncObject *so = calloc(1, sizeof(SyncObject));
+            int name_at = 0;
+            if (!so) break;
+            if (sscanf(value, "%d|%d|%n", &so->history[flip], &so->history[!flip], &name_at) < 2 || !name_at) {
+                free(so);
+                continue;
+            }
+            snprintf(so->name, MAX_TEXT, "%s", value + name_at);
+            so->next = list->objects;
+            list->objects = so;
         }
+    }
+    fclose(f);
+    return list;
+}
 
-        int count;
-        Item **items = get_items_array(obj, &count);
+static void free_sync_objects(SyncObject *so) {
+    while (so) {
+        SyncObject *next = so->next;
+        free(so);
+        so = next;
+    }
+}
 
-        for (int i = 0; i < count; i++) {
-            const char *txt = items[i]->text;
+static void free_sync_state(SyncEntry *e) {
+    while (e) {
+        SyncEntry *next = e->next;
+        free_sync_objects(e->objects);
+        free(e);
+        e = next;
+    }
+}
+
+typedef struct {
+    const char *other;
+    SyncEntry *entries;
+    int flip;
+} SyncStateFile;
+
+static void emit_sync_state(FILE *f, void *arg) {
+    SyncStateFile *s = arg;
+    fprintf(f, "peer=%s\n", s->other);
+    for (SyncEntry *e = s->entries; e; e = e->next) {
+        fprintf(f, "project=%08x|%08x|%u|%u|%s\n", e->mark[s->flip], e->mark[!s->flip],
+                e->next_id[s->flip], e->next_id[!s->flip], e->name);
+        for (SyncObject *so = e->objects; so; so = so->next) {
+            fprintf(f, "object=%d|%d|%s\n", so->history[s->flip], so->history[!s->flip], so->name);
+        }
+    }
+}
+
+static int sync_save_state(const char *home_dir, const char *other, SyncEntry *entries, int flip) {
+    char dir[MAX_PATH], path[MAX_PATH];
+    snprintf(dir, MAX_PATH, "%s/" SYNC_DIR, home_dir);
+    mkdir(dir, 0755);
+    sync_state_path(home_dir, other, path);
+    SyncStateFile s = { other, entries, flip };
+    return write_file_atomic(dir, strrchr(path, '/') + 1, emit_sync_state, &s);
+}
+
+static int history_length(const Object *obj) {
+    int n = 0;
+    for (const HistoryEntry *h = obj ? obj->history : NULL; h; h = h->next) n++;
+    return n;
+}
+
+/* Same item on both sides: same content hash, same timestamp */
+static uint64_t item_origin_key(const Item *item) {
+    uint64_t key = item->hash ^ ((uint64_t)item->ts.epoch * 0x9E3779B97F4A7C15ULL);
+    return key ? key : 1;
+}
+
+/* An item both sides had at the last sync, with this text */
+static Item* find_shared_item(Object *obj, uint32_t shared, const char *text, const HashSet *dead) {
+    for (Item *item = obj->items; item; item = item->next) {
+        if (item->id < shared && !hashset_contains(dead, (uint64_t)item->id + 1) && strcmp(item->text, text) == 0) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+/* Exchange one object's changes since the last sync: new items both ways,
+ * then deletes and edits of shared items. Counts records into received[]. */
+static void sync_object_pair(Project *p[2], Object *o[2], const SyncEntry *st, const SyncObject *so, int received[2]) {
+    Item **fresh[2];
+    HistoryEntry **changes[2];
+    int fresh_count[2] = {0, 0}, change_count[2] = {0, 0};
+    for (int s = 0; s < 2; s++) {
+        uint32_t shared = st ? st->next_id[s] : 0;
+        int n;
+        fresh[s] = get_items_array(o[s], &n);
+        for (int i = 0; i < n; i++) {
+            if (fresh[s][i]->id >= shared) fresh[s][fresh_count[s]++] = fresh[s][i];
+        }
+        // History past the last sync: the newest entries, flipped oldest first
+        int seen = so ? so->history[s] : 0;
+        int count = history_length(o[s]) - seen;
+        changes[s] = count > 0 ? malloc(sizeof(HistoryEntry*) * count) : NULL;
+        if (!changes[s]) count = 0;
+        HistoryEntry *h = o[s]->history;
+        for (int i = count - 1; i >= 0; i--, h = h->next) changes[s][i] = h;
+        change_count[s] = count;
+    }
 
-            int ok = 1;
-            for (int k = 0; k < kwc; k++) {
-                if (!strcasestr(txt, kws[k])) { ok = 0; break; }
+    for (int s = 0; s < 2; s++) {
+        int d = !s;
+        HashSet have;
+        memset(&have, 0, sizeof(have));
+        for (Item *item = o[d]->items; item; item = item->next) hashset_add(&have, item_origin_key(item));
+        for (int i = 0; i < fresh_count[s]; i++) {
+            Item *item = fresh[s][i];
+            uint64_t key = item_origin_key(item);
+            if (hashset_contains(&have, key)) continue;
+            append_item(p[d], o[d], item->text, &item->ts);
+            hashset_add(&have, key);
+            received[d]++;
+        }
+        free(have.keys);
+        free(have.counts);
+
+        // An edit is DELETE_ITEM of the old text followed by EDIT. Entries
+        // about items added since the last sync stay on their side: the
+        // item went across above with its current text, or not at all.
+        uint32_t shared = st ? st->next_id[d] : 0, added = st ? st->next_id[s] : 0;
+        HashSet dead;
+        memset(&dead, 0, sizeof(dead));
+        for (int i = 0; i < change_count[s]; i++) {
+            HistoryEntry *h = changes[s][i];
+            if (strcmp(h->action, "DELETE_ITEM") != 0) continue;
+            HistoryEntry *edit = i + 1 < change_count[s] && strcmp(changes[s][i + 1]->action, "EDIT") == 0 &&
+                                 changes[s][i + 1]->ts.epoch == h->ts.epoch ? changes[s][++i] : NULL;
+            if (h->id >= added) continue;
+            Item *item = find_shared_item(o[d], shared, h->text, &dead);
+            if (!item) continue;
+            if (edit) {
+                rollup_edited(o[d], item->text, edit->text, &edit->ts);
+                edit_item_text(o[d], item, edit->text, &edit->ts);
+            } else {
+                add_history(o[d], "DELETE_ITEM", &h->ts, item->text, item->id);
+                rollup_deleted(o[d], item->text, &h->ts);
+                hashset_add(&dead, (uint64_t)item->id + 1);
             }
+            touch_object(o[d]);
+            received[d]++;
+        }
+        if (dead.len) remove_items_by_id(o[d], &dead);
+        free(dead.keys);
+        free(dead.counts);
+    }
+    for (int s = 0; s < 2; s++) {
+        free(fresh[s]);
+        free(changes[s]);
+    }
+}
 
-            if (ok) {
-                printf("%s: [%s] %s\n", object_name, items[i]->timestamp, txt);
+static SyncObject* find_sync_object(const SyncEntry *st, const char *name) {
+    SyncObject *so = st ? st->objects : NULL;
+    while (so && strcmp(so->name, name) != 0) so = so->next;
+    return so;
+}
+
+/* Record both sides' objects and history lengths as the new sync point */
+static void sync_record_objects(SyncEntry *st, Project *p[2]) {
+    free_sync_objects(st->objects);
+    st->objects = NULL;
+    for (int s = 0; s < 2; s++) {
+        for (Object *obj = p[s]->objects; obj; obj = obj->next) {
+            if (s == 1 && find_object(p[0], obj->name)) continue;
+            SyncObject *so = calloc(1, sizeof(SyncObject));
+            if (!so) return;
+            snprintf(so->name, MAX_TEXT, "%s", obj->name);
+            so->history[0] = history_length(find_object(p[0], obj->name));
+            so->history[1] = history_length(find_object(p[1], obj->name));
+            so->next = st->objects;
+            st->objects = so;
+        }
+    }
+    st->next_id[0] = p[0]->next_id;
+    st->next_id[1] = p[1]->next_id;
+}
+
+/* Sync a project both homes have. Objects only one side has are created on
+ * the other, unless they were synced before (then the other side deleted
+ * them). Returns 0 if a side could not be loaded or written. */
+static int sync_project_pair(const char *path[2], SyncEntry *st, int received[2]) {
+    Project *p[2];
+    p[0] = load_project_file(path[0]);
+    p[1] = p[0] ? load_project_file(path[1]) : NULL;
+    if (!p[0] || !p[1]) {
+        free_project(p[0]);
+        return 0;
+    }
+    // Sync marks count history entries, so both tiers are read
+    fold_cold_tier(path[0], p[0]);
+    fold_cold_tier(path[1], p[1]);
+    for (int s = 0; s < 2; s++) {
+        for (Object *obj = p[s]->objects; obj; obj = obj->next) {
+            if (s == 1 && find_object(p[0], obj->name)) continue;
+            Object *o[2];
+            o[s] = obj;
+            o[!s] = find_object(p[!s], obj->name);
+            SyncObject *so = find_sync_object(st, obj->name);
+            if (!o[!s]) {
+                if (so) continue;
+                o[!s] = calloc(1, sizeof(Object));
+                if (!o[!s]) continue;
+                snprintf(o[!s]->name, MAX_TEXT, "%s", obj->name);
+                touch_object(o[!s]);
+                o[!s]->next = p[!s]->objects;
+                p[!s]->objects = o[!s];
+                received[!s]++;
             }
+            sync_object_pair(p, o, st, so, received);
         }
+    }
+    int ok = 1;
+    for (int s = 0; s < 2; s++) {
+        if (received[s] && !save_project_file(path[s], p[s])) {
+            print_error("Failed to write %s\n", path[s]);
+            ok = 0;
+        }
+    }
+    if (ok) sync_record_objects(st, p);
+    free_project(p[0]);
+    free_project(p[1]);
+    return ok;
+}
 
-        free(items);
+/* Copy a project one home lacks into its projects directory under the next
+ * index there. Returns the number of items copied, or -1. */
+static int sync_copy_project(const char *path, Config *dest, SyncEntry *st, char *dest_path) {
+    Project *proj = load_project_file(path);
+    if (!proj) return -1;
+    fold_cold_tier(path, proj);
+    int primary, counter;
+    load_config_data(dest, &primary, &counter);
+    proj->index = ++counter;
+    snprintf(dest_path, MAX_PATH, "%s/%d_%s.txt", dest->projects_dir, proj->index, proj->name);
+    int items = -1;
+    if (save_project_file(dest_path, proj)) {
+        save_config_data(dest, primary, counter);
+        Project *both[2] = { proj, proj };
+        sync_record_objects(st, both);
+        items = 0;
+        for (Object *obj = proj->objects; obj; obj = obj->next) items += count_items(obj);
+    }
+    free_project(proj);
+    return items;
+}
+
+/* funknotes sync <other-home>: exchange changes with another funknotes home
+ * (the directory holding .funknotes, or a .funknotes directory itself) */
+void sync_command(Config *cfg, const char *other) {
+    char real[MAX_PATH], probe[MAX_PATH], here[MAX_PATH];
+    Config peer;
+    if (!realpath(other, real)) {
+        print_error("Cannot open '%s': %s\n", other, strerror(errno));
+        return;
+    }
+    snprintf(probe, MAX_PATH, "%s/.funknotes/projects", real);
+    if (is_directory(probe)) {
+        snprintf(probe, MAX_PATH, "%s/.funknotes", real);
+        if (!realpath(probe, real)) return;
     } else {
-        // search all objects
-        Object *obj = proj->objects;
-        while (obj) {
-            int count;
-            Item **items = get_items_array(obj, &count);
-
-            for (int i = 0; i < count; i++) {
-                const char *txt = items[i]->text;
-
-                int ok = 1;
-                for (int k = 0; k < kwc; k++) {
-                    if (!strcasestr(txt, kws[k])) { ok = 0; break; }
-                }
+        snprintf(probe, MAX_PATH, "%s/projects", real);
+        if (!is_directory(probe)) {
+            print_error("No funknotes data in '%s'\n", other);
+            return;
+        }
+    }
+    if (!realpath(cfg->home_dir, here) || strcmp(here, real) == 0) {
+        print_error("'%s' is this funknotes home\n", other);
+        return;
+    }
+    config_paths(&peer, real);
+    // Writes go to both homes; don't wait on the other one, whose owner may be syncing back
+    int peer_lock = lock_home(peer.home_dir, 1);
+    if (peer_lock < 0) {
+        print_error("'%s' is busy (another funknotes is writing to it); try again\n", other);
+        return;
+    }
 
-                if (ok) {
-                    printf("%s: [%s] %s\n", obj->name, items[i]->timestamp, txt);
+    SyncEntry *state = sync_load_state(cfg->home_dir, real, 0);
+    if (!state) state = sync_load_state(peer.home_dir, here, 1);
+    SyncProject *lists[2] = { sync_list_projects(cfg->projects_dir), sync_list_projects(peer.projects_dir) };
+    Config *homes[2] = { cfg, &peer };
+    int totals[2] = {0, 0}, unchanged = 0, failed = 0;
+
+    for (int s = 0; s < 2; s++) {
+        for (SyncProject *sp = lists[s]; sp; sp = sp->next) {
+            SyncProject *match = find_sync_project(lists[!s], sp->name);
+            if (s == 1 && match) continue;
+            SyncEntry *st = state;
+            while (st && strcmp(st->name, sp->name) != 0) st = st->next;
+
+            if (!match) {
+                if (st) continue;  // synced before: deleted in the other home
+                st = calloc(1, sizeof(SyncEntry));
+                if (!st) break;
+                snprintf(st->name, MAX_TEXT, "%s", sp->name);
+                char dest_path[MAX_PATH];
+                int items = sync_copy_project(sp->path, homes[!s], st, dest_path);
+                if (items < 0) {
+                    print_error("Failed to copy project '%s'\n", sp->name);
+                    free(st);
+                    failed++;
+                    continue;
                 }
+                st->mark[s] = sp->mark;
+                st->mark[!s] = project_file_mark(dest_path);
+                st->next = state;
+                state = st;
+                totals[!s] += items;
+                printf("  %s: %s (%d item%s)\n", sp->name, s ? "copied here" : "copied there", items, items == 1 ? "" : "s");
+                continue;
             }
 
-            free(items);
-            obj = obj->next;
+            const SyncProject *pair[2];
+            pair[s] = sp;
+            pair[!s] = match;
+            if (st && st->mark[0] == pair[0]->mark && st->mark[1] == pair[1]->mark) {
+                unchanged++;
+                continue;
+            }
+            if (st && (st->next_id[0] > pair[0]->next_id || st->next_id[1] > pair[1]->next_id)) {
+                // Rolled back (snapshot restore) since the last sync: merge as if new
+                st->next_id[0] = st->next_id[1] = 0;
+                free_sync_objects(st->objects);
+                st->objects = NULL;
+            }
+            int fresh = !st;
+            if (fresh) {
+                st = calloc(1, sizeof(SyncEntry));
+                if (!st) break;
+                snprintf(st->name, MAX_TEXT, "%s", sp->name);
+            }
+            const char *paths[2] = { pair[0]->path, pair[1]->path };
+            int received[2] = {0, 0};
+            if (!sync_project_pair(paths, st, received)) {
+                if (fresh) free(st);
+                failed++;
+                continue;
+            }
+            st->mark[0] = received[0] ? project_file_mark(paths[0]) : pair[0]->mark;
+            st->mark[1] = received[1] ? project_file_mark(paths[1]) : pair[1]->mark;
+            if (fresh) {
+                st->next = state;
+                state = st;
+            }
+            totals[0] += received[0];
+            totals[1] += received[1];
+            if (received[0] || received[1]) printf("  %s: sent %d, received %d\n", sp->name, received[1], received[0]);
+            else unchanged++;
         }
     }
 
-    free_project(proj);
+    if (!sync_save_state(cfg->home_dir, real, state, 0) || !sync_save_state(peer.home_dir, here, state, 1)) {
+        print_error("Failed to record the sync point\n");
+        failed++;
+    }
+    printf("Synced with %s: %d record%s sent, %d received, %d project%s unchanged\n", real,
+           totals[1], totals[1] == 1 ? "" : "s", totals[0], unchanged, unchanged == 1 ? "" : "s");
+    for (int s = 0; s < 2; s++) {
+        while (lists[s]) {
+            SyncProject *next = lists[s]->next;
+            free(lists[s]);
+            lists[s] = next;
+        }
+    }
+    free_sync_state(state);
+    close(peer_lock);
+    if (failed) g_command_failed = 1;
 }
 
-/* Merge multiple projects into the last project identifier (target).
- * idents: array of project identifiers (name or index), count >= 2
- */
-void merge_projects(Config *cfg, int count, char **idents) {
-    if (count < 2) {
-        printf("Need at least two projects to merge: sources...,target\n");
-        return;
+// ===== Snapshots ===== //
+// funknotes snapshot create|list|restore keeps point-in-time copies of the
+// projects directory under snapshots/<name>/. Journal appends change
+// project files in place, so a snapshot never links to a live file; instead
+// each snapshot records the stat (size, mtime, inode) every file had when it
+// was taken, and a file whose stat has not changed since the previous
+// snapshot is hard linked to that snapshot's copy. Only changed files are
+// copied.
+
+#define SNAPSHOT_DIR "snapshots"
+#define SNAPSHOT_MANIFEST "snapshot.txt"
+
+typedef struct {
+    char path[MAX_PATH];    // relative to projects/
+    int64_t size;
+    int64_t mtime_sec;
+    long mtime_nsec;
+    uint64_t ino;
+} SnapshotFile;
+
+typedef struct {
+    SnapshotFile *files;
+    int count;
+    int cap;
+    Timestamp created;
+    int copied;
+    int64_t bytes;          // bytes copied (not linked) when the snapshot was taken
+} SnapshotManifest;
+
+static SnapshotFile* snapshot_add_file(SnapshotManifest *m) {
+    if (m->count == m->cap) {
+        int cap = m->cap ? m->cap * 2 : 32;
+        SnapshotFile *files = realloc(m->files, sizeof(SnapshotFile) * cap);
+        if (!files) return NULL;
+        m->files = files;
+        m->cap = cap;
     }
+    SnapshotFile *sf = &m->files[m->count++];
+    memset(sf, 0, sizeof(*sf));
+    return sf;
+}
 
-    // Resolve all project files
-    char **paths = malloc(sizeof(char*) * count);
-    int *indices = malloc(sizeof(int) * count);
-    char **names = malloc(sizeof(char*) * count);
-    for (int i = 0; i < count; ++i) {
-        paths[i] = malloc(MAX_PATH);
-        if (!get_project_file_by_ident(cfg, idents[i], paths[i], &indices[i])) {
-            printf("Project '%s' not found\n", idents[i]);
-            // cleanup
-            for (int j = 0; j <= i; j++) free(paths[j]);
-            free(paths); free(indices); free(names);
-            return;
-        }
-        // Read project name
-        Project *p = load_project_file(paths[i]);
-        if (p) {
-            names[i] = strdup(p->name);
-            free_project(p);
-        } else {
-            names[i] = strdup(idents[i]);
+static int cmp_snapshot_file(const void *a, const void *b) {
+    return strcmp(((const SnapshotFile *)a)->path, ((const SnapshotFile *)b)->path);
+}
+
+static const SnapshotFile* snapshot_find_file(const SnapshotManifest *m, const char *path) {
+    SnapshotFile key;
+    snprintf(key.path, MAX_PATH, "%s", path);
+    return m->count ? bsearch(&key, m->files, m->count, sizeof(SnapshotFile), cmp_snapshot_file) : NULL;
+}
+
+static int snapshot_stat_matches(const SnapshotFile *sf, const struct stat *st) {
+    return sf->size == (int64_t)st->st_size && sf->mtime_sec == (int64_t)ST_MTIM(*st).tv_sec &&
+           sf->mtime_nsec == (long)ST_MTIM(*st).tv_nsec && sf->ino == (uint64_t)st->st_ino;
+}
+
+static void snapshot_record_stat(SnapshotFile *sf, const struct stat *st) {
+    sf->size = (int64_t)st->st_size;
+    sf->mtime_sec = (int64_t)ST_MTIM(*st).tv_sec;
+    sf->mtime_nsec = (long)ST_MTIM(*st).tv_nsec;
+    sf->ino = (uint64_t)st->st_ino;
+}
+
+/* Every file of the live projects directory (one level into directory
+ * layout projects), with its stat; temporary files are skipped */
+static void snapshot_scan(const char *projects_dir, const char *sub, SnapshotManifest *m) {
+    char dir_path[MAX_PATH];
+    snprintf(dir_path, MAX_PATH, "%s%s%s", projects_dir, *sub ? "/" : "", sub);
+    DIR *dir = opendir(dir_path);
+    if (!dir) return;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        char path[MAX_PATH], rel[MAX_PATH];
+        struct stat st;
+        snprintf(rel, MAX_PATH, "%s%s%s", sub, *sub ? "/" : "", entry->d_name);
+        snprintf(path, MAX_PATH, "%s/%s", projects_dir, rel);
+        if (stat(path, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            if (!*sub) snapshot_scan(projects_dir, rel, m);
+            continue;
         }
+        if (!S_ISREG(st.st_mode)) continue;
+        SnapshotFile *sf = snapshot_add_file(m);
+        if (!sf) break;
+        snprintf(sf->path, MAX_PATH, "%s", rel);
+        snapshot_record_stat(sf, &st);
     }
+    closedir(dir);
+}
 
-    // Build prompt: sources -> target
-    int target_idx = count - 1;
-    printf("Merge ");
-    for (int i = 0; i < target_idx; ++i) {
-        printf("%s%s", names[i], i < target_idx-1 ? "," : " ");
+static int load_snapshot_manifest(const char *snap_dir, SnapshotManifest *m) {
+    char path[MAX_PATH], line[MAX_LINE];
+    memset(m, 0, sizeof(*m));
+    snprintf(path, MAX_PATH, "%s/" SNAPSHOT_MANIFEST, snap_dir);
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        if (strncmp(line, "file=", 5) == 0) {
+            SnapshotFile *sf = snapshot_add_file(m);
+            long long size, sec;
+            unsigned long long ino;
+            int name_at = 0;
+            if (!sf) break;
+            if (sscanf(line + 5, "%lld|%lld|%ld|%llu|%n", &size, &sec, &sf->mtime_nsec, &ino, &name_at) < 4 || !name_at) {
+                m->count--;
+                continue;
+            }
+            sf->size = size;
+            sf->mtime_sec = sec;
+            sf->ino = ino;
+            snprintf(sf->path, MAX_PATH, "%s", line + 5 + name_at);
+        } else if (strncmp(line, "created=", 8) == 0) {
+            parse_timestamp_field(line + 8, &m->created);
+        } else if (strncmp(line, "copied=", 7) == 0) {
+            long long bytes;
+            if (sscanf(line + 7, "%d|%lld", &m->copied, &bytes) == 2) m->bytes = bytes;
+        }
     }
-    printf("into %s? y/N: ", names[target_idx]);
-    fflush(stdout);
+    fclose(f);
+    if (m->count) qsort(m->files, m->count, sizeof(SnapshotFile), cmp_snapshot_file);
+    return 1;
+}
 
-    char resp[8];
-    if (!fgets(resp, sizeof(resp), stdin) || (resp[0] != 'y' && resp[0] != 'Y')) {
-        printf("Merge cancelled\n");
-        for (int i=0;i<count;++i) { free(paths[i]); free(names[i]); }
-        free(paths); free(indices); free(names);
-        return;
+static void emit_snapshot_manifest(FILE *f, void *arg) {
+    SnapshotManifest *m = arg;
+    char created[32];
+    write_timestamp_field(&m->created, created, sizeof(created));
+    fprintf(f, "created=%s\ncopied=%d|%lld\n", created, m->copied, (long long)m->bytes);
+    for (int i = 0; i < m->count; i++) {
+        const SnapshotFile *sf = &m->files[i];
+        fprintf(f, "file=%lld|%lld|%ld|%llu|%s\n", (long long)sf->size, (long long)sf->mtime_sec,
+                sf->mtime_nsec, (unsigned long long)sf->ino, sf->path);
     }
+}
 
-    // Load target
-    char *target_path = paths[target_idx];
-    Project *target = load_project_file(target_path);
-    if (!target) { printf("Failed to load target project\n"); goto cleanup; }
+/* Copy a file; returns the bytes copied, or -1 */
+static int64_t copy_file(const char *src, const char *dst) {
+    int in = open(src, O_RDONLY);
+    if (in < 0) return -1;
+    int out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) { close(in); return -1; }
+    char buf[1 << 16];
+    int64_t total = 0;
+    ssize_t n;
+    while ((n = read(in, buf, sizeof(buf))) > 0) {
+        if (write(out, buf, (size_t)n) != n) { n = -1; break; }
+        total += n;
+    }
+    close(in);
+    if (close(out) != 0 || n < 0) {
+        unlink(dst);
+        return -1;
+    }
+    return total;
+}
 
-    // For each source, merge
-    for (int s = 0; s < target_idx; ++s) {
-        char *spath = paths[s];
-        Project *source = load_project_file(spath);
-        if (!source) { printf("Warning: failed reading source %s\n", spath); continue; }
+/* Make the parent directory of a file inside root (one level deep) */
+static void snapshot_make_parent(const char *root, const char *rel) {
+    const char *slash = strchr(rel, '/');
+    if (!slash) return;
+    char dir[MAX_PATH];
+    snprintf(dir, MAX_PATH, "%s/%.*s", root, (int)(slash - rel), rel);
+    mkdir(dir, 0755);
+}
 
-        if (!source->objects) { free_project(source); continue; }
+/* Remove a snapshot or projects tree (files, and directories one level deep) */
+static void remove_tree(const char *path) {
+    DIR *d = opendir(path);
+    if (!d) return;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        char sub[MAX_PATH];
+        snprintf(sub, MAX_PATH, "%s/%s", path, entry->d_name);
+        remove_project_path(sub);
+    }
+    closedir(d);
+    rmdir(path);
+}
 
-        // For each object in source
-        Object *sobj = source->objects;
-        while (sobj) {
-            Object *next_sobj = sobj->next;
-            
-            // Find if target already has this object
-            Object *tobj = find_object(target, sobj->name);
-            
-            if (tobj) {
-                // Append items and history
-                // Get source items and history
-                Item *sitem = sobj->items;
-                while (sitem) {
-                    Item *next_sitem = sitem->next;
-                    sitem->next = tobj->items;
-                    tobj->items = sitem;
-                    sitem = next_sitem;
-                }
-                sobj->items = NULL;  // Clear so we don't free them
-                
-                HistoryEntry *shist = sobj->history;
-                while (shist) {
-                    HistoryEntry *next_shist = shist->next;
-                    shist->next = tobj->history;
-                    tobj->history = shist;
-                    shist = next_shist;
-                }
-                sobj->history = NULL;  // Clear so we don't free them
-                
-                // Free the source object (items/history already moved)
-                free(sobj);
-            } else {
-                // Copy object into target
-                sobj->next = target->objects;
-                target->objects = sobj;
-            }
-            
-            sobj = next_sobj;
-        }
-        
-        // Free source project (objects already moved or freed)
-        source->objects = NULL;
-        free_project(source);
+/* Name of the newest snapshot (names sort by time), or 0 if there is none */
+static int latest_snapshot(Config *cfg, char *name) {
+    char dir_path[MAX_PATH];
+    snprintf(dir_path, MAX_PATH, "%s/" SNAPSHOT_DIR, cfg->home_dir);
+    DIR *dir = opendir(dir_path);
+    if (!dir) return 0;
+    struct dirent *entry;
+    name[0] = '\0';
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        if (strcmp(entry->d_name, name) > 0) snprintf(name, MAX_TEXT, "%s", entry->d_name);
+    }
+    closedir(dir);
+    return name[0] != '\0';
+}
+
+/* Take a snapshot of the projects directory and config. The snapshot is
+ * built under a hidden name and renamed into place once complete. Fills
+ * name (MAX_TEXT) and returns 1 on success. */
+static int snapshot_take(Config *cfg, char *name, int *files, int *linked, int64_t *bytes) {
+    char root[MAX_PATH], prev_name[MAX_TEXT], prev_dir[MAX_PATH], tmp[MAX_PATH], final[MAX_PATH];
+    snprintf(root, MAX_PATH, "%s/" SNAPSHOT_DIR, cfg->home_dir);
+    mkdir(root, 0755);
+
+    SnapshotManifest prev, cur;
+    memset(&prev, 0, sizeof(prev));
+    memset(&cur, 0, sizeof(cur));
+    if (latest_snapshot(cfg, prev_name)) {
+        snprintf(prev_dir, MAX_PATH, "%s/%s", root, prev_name);
+        load_snapshot_manifest(prev_dir, &prev);
     }
 
-    // Write target back
-    if (save_project_file(target_path, target)) {
-        printf("Merged into %s\n", names[target_idx]);
-        // After successful merge, prompt to delete source projects
-        printf("Delete source projects? y/N: "); fflush(stdout);
-        char dresp[8];
-        if (fgets(dresp, sizeof(dresp), stdin) && (dresp[0] == 'y' || dresp[0] == 'Y')) {
-            for (int s = 0; s < target_idx; ++s) {
-                if (indices[s] > 0) {
-                    char idxbuf[32]; snprintf(idxbuf, sizeof(idxbuf), "%d", indices[s]);
-                    delete_project(cfg, idxbuf);
-                } else {
-                    delete_project(cfg, names[s]);
-                }
+    get_timestamp(&cur.created);
+    time_t now = (time_t)cur.created.epoch;
+    struct tm t;
+    localtime_r(&now, &t);
+    strftime(name, MAX_TEXT, "%Y%m%d-%H%M%S", &t);
+    snprintf(final, MAX_PATH, "%s/%s", root, name);
+    for (int n = 2; is_directory(final); n++) {
+        size_t len = strcspn(name, "_");
+        snprintf(name + len, MAX_TEXT - len, "_%d", n);
+        snprintf(final, MAX_PATH, "%s/%s", root, name);
+    }
+    snprintf(tmp, MAX_PATH, "%s/.%s.tmp", root, name);
+    remove_tree(tmp);
+    char projects[MAX_PATH];
+    snprintf(projects, MAX_PATH, "%s/projects", tmp);
+    if (mkdir(tmp, 0755) != 0 || mkdir(projects, 0755) != 0) {
+        free(prev.files);
+        return 0;
+    }
+
+    snapshot_scan(cfg->projects_dir, "", &cur);
+    qsort(cur.files, cur.count, sizeof(SnapshotFile), cmp_snapshot_file);
+    int ok = 1;
+    *linked = 0;
+    for (int i = 0; i < cur.count && ok; i++) {
+        const SnapshotFile *sf = &cur.files[i];
+        const SnapshotFile *old = snapshot_find_file(&prev, sf->path);
+        char src[MAX_PATH], dst[MAX_PATH];
+        snapshot_make_parent(projects, sf->path);
+        snprintf(dst, MAX_PATH, "%s/%s", projects, sf->path);
+        if (old && old->size == sf->size && old->mtime_sec == sf->mtime_sec &&
+            old->mtime_nsec == sf->mtime_nsec && old->ino == sf->ino) {
+            snprintf(src, MAX_PATH, "%s/projects/%s", prev_dir, sf->path);
+            if (link(src, dst) == 0) {
+                (*linked)++;
+                continue;
             }
         }
-    } else {
-        printf("Failed to write target project\n");
+        snprintf(src, MAX_PATH, "%s/%s", cfg->projects_dir, sf->path);
+        int64_t n = copy_file(src, dst);
+        if (n < 0) {
+            print_error("Failed to copy %s: %s\n", src, strerror(errno));
+            ok = 0;
+        }
+        cur.copied++;
+        cur.bytes += n;
     }
+    char config[MAX_PATH];
+    snprintf(config, MAX_PATH, "%s/config", tmp);
+    if (ok && access(cfg->config_file, F_OK) == 0 && copy_file(cfg->config_file, config) < 0) ok = 0;
+    if (ok) ok = write_file_atomic(tmp, SNAPSHOT_MANIFEST, emit_snapshot_manifest, &cur);
+    if (ok && rename(tmp, final) != 0) ok = 0;
+    if (!ok) remove_tree(tmp);
+    *files = cur.count;
+    *bytes = cur.bytes;
+    free(prev.files);
+    free(cur.files);
+    return ok;
+}
 
-    free_project(target);
+static void snapshot_create(Config *cfg) {
+    char name[MAX_TEXT];
+    int files, linked;
+    int64_t bytes;
+    if (!snapshot_take(cfg, name, &files, &linked, &bytes)) {
+        print_error("Failed to create a snapshot\n");
+        return;
+    }
+    printf("Created snapshot %s: %d file%s, %d copied (%lld bytes), %d unchanged\n", name,
+           files, files == 1 ? "" : "s", files - linked, (long long)bytes, linked);
+}
 
-cleanup:
-    for (int i=0;i<count;++i) { free(paths[i]); free(names[i]); }
-    free(paths); free(indices); free(names);
+static int cmp_names(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
 }
 
-/* Merge objects within a single project: provide project ident and comma-separated object list
- * Syntax: merge <project> <obj1,obj2,target>
- */
-void merge_objects_in_project(Config *cfg, const char *project_ident, const char *comma_list) {
-    // Resolve project
-    char project_file[MAX_PATH]; int proj_idx;
-    if (!get_project_file_by_ident(cfg, project_ident, project_file, &proj_idx)) {
-        printf("Project '%s' not found\n", project_ident);
+static void snapshot_list(Config *cfg) {
+    char root[MAX_PATH];
+    snprintf(root, MAX_PATH, "%s/" SNAPSHOT_DIR, cfg->home_dir);
+    DIR *dir = opendir(root);
+    char **names = NULL;
+    int count = 0, cap = 0;
+    struct dirent *entry;
+    while (dir && (entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        if (count == cap) {
+            cap = cap ? cap * 2 : 16;
+            char **grown = realloc(names, sizeof(char *) * cap);
+            if (!grown) break;
+            names = grown;
+        }
+        names[count++] = strdup(entry->d_name);
+    }
+    if (dir) closedir(dir);
+    if (count == 0) {
+        printf("No snapshots. Use 'funknotes snapshot create' to take one.\n");
+        free(names);
         return;
     }
-
-    // Split comma_list into tokens
-    char *cl = strdup(comma_list);
-    int parts = 0;
-    char *tok = strtok(cl, ",");
-    char **objs = NULL;
-    while (tok) {
-        objs = realloc(objs, sizeof(char*) * (parts+1));
-        objs[parts++] = strdup(tok);
-        tok = strtok(NULL, ",");
+    qsort(names, count, sizeof(char *), cmp_names);
+    printf("\n=== Snapshots ===\n");
+    for (int i = 0; i < count; i++) {
+        char snap_dir[MAX_PATH], when[32];
+        SnapshotManifest m;
+        snprintf(snap_dir, MAX_PATH, "%s/%s", root, names[i]);
+        if (load_snapshot_manifest(snap_dir, &m)) {
+            format_timestamp(&m.created, when, sizeof(when));
+            printf("  %s  %s  %d file%s, %d copied (%lld bytes)\n", names[i], when,
+                   m.count, m.count == 1 ? "" : "s", m.copied, (long long)m.bytes);
+        }
+        free(m.files);
+        free(names[i]);
     }
-    free(cl);
+    free(names);
+}
 
-    if (parts < 2) { printf("Need at least two objects to merge (sources,target)\n"); for (int i=0;i<parts;i++) free(objs[i]); free(objs); return; }
+/* Swap two directories in one step where the system allows it */
+static int swap_directories(const char *a, const char *b) {
+#if defined(__linux__) && defined(RENAME_EXCHANGE)
+    if (renameat2(AT_FDCWD, a, AT_FDCWD, b, RENAME_EXCHANGE) == 0) return 1;
+#elif defined(__APPLE__)
+    if (renamex_np(a, b, RENAME_SWAP) == 0) return 1;
+#endif
+    // No exchange: move a aside, then b into place
+    char aside[MAX_PATH];
+    snprintf(aside, MAX_PATH, "%s.swap", a);
+    if (rename(a, aside) != 0) return 0;
+    if (rename(b, a) != 0) {
+        rename(aside, a);
+        return 0;
+    }
+    return rename(aside, b) == 0;
+}
 
-    // Prompt y/N
-    printf("Merge ");
-    for (int i=0;i<parts-1;i++) { printf("%s%s", objs[i], i < parts-2 ? "," : " "); }
-    printf("into %s in project %s? y/N: ", objs[parts-1], project_ident);
+/* Replace the projects directory and config with a snapshot's. The current
+ * state is snapshotted first; the new projects directory is staged beside
+ * the live one (unchanged files are linked from it, others copied from the
+ * snapshot) and swapped in. */
+static void snapshot_restore(Config *cfg, const char *name) {
+    char snap_dir[MAX_PATH];
+    SnapshotManifest m;
+    snprintf(snap_dir, MAX_PATH, "%s/" SNAPSHOT_DIR "/%s", cfg->home_dir, name);
+    if (strchr(name, '/') || name[0] == '.' || !load_snapshot_manifest(snap_dir, &m)) {
+        print_error("Snapshot '%s' not found\n", name);
+        return;
+    }
+    if (!can_confirm()) {
+        print_error("Non-interactive mode: restore of snapshot '%s' aborted\n", name);
+        free(m.files);
+        return;
+    }
+    printf("Replace all projects with snapshot '%s'? y/N: ", name);
     fflush(stdout);
-    char resp[8];
-    if (!fgets(resp, sizeof(resp), stdin) || (resp[0] != 'y' && resp[0] != 'Y')) {
-        printf("Merge cancelled\n"); for (int i=0;i<parts;i++) free(objs[i]); free(objs); return;
+    if (!read_answer(0)) {
+        print_error("Restore cancelled\n");
+        free(m.files);
+        return;
     }
 
-    // Load project
-    Project *proj = load_project_file(project_file);
-    if (!proj) { printf("Failed to load project\n"); for (int i=0;i<parts;i++) free(objs[i]); free(objs); return; }
-
-    if (!proj->objects) { printf("No objects in project\n"); free_project(proj); for (int i=0;i<parts;i++) free(objs[i]); free(objs); return; }
-
-    const char *target = objs[parts-1];
-    Object *tobj = find_object(proj, target);
-    if (!tobj) { printf("Target object '%s' not found\n", target); free_project(proj); for (int i=0;i<parts;i++) free(objs[i]); free(objs); return; }
+    char saved[MAX_TEXT];
+    int files, linked;
+    int64_t bytes;
+    if (!snapshot_take(cfg, saved, &files, &linked, &bytes)) {
+        print_error("Failed to snapshot the current projects; nothing restored\n");
+        free(m.files);
+        return;
+    }
 
-    for (int s=0; s<parts-1; ++s) {
-        Object *sobj = find_object(proj, objs[s]);
-        if (!sobj) { printf("Source object '%s' not found, skipping\n", objs[s]); continue; }
-        
-        // Append items
-        Item *sitem = sobj->items;
-        while (sitem) {
-            Item *next_sitem = sitem->next;
-            sitem->next = tobj->items;
-            tobj->items = sitem;
-            sitem = next_sitem;
-        }
-        sobj->items = NULL;
-        
-        // Append history
-        HistoryEntry *shist = sobj->history;
-        while (shist) {
-            HistoryEntry *next_shist = shist->next;
-            shist->next = tobj->history;
-            tobj->history = shist;
-            shist = next_shist;
+    char staging[MAX_PATH];
+    snprintf(staging, MAX_PATH, "%s/.projects.restore", cfg->home_dir);
+    remove_tree(staging);
+    int ok = mkdir(staging, 0755) == 0;
+    int copied = 0;
+    for (int i = 0; i < m.count && ok; i++) {
+        const SnapshotFile *sf = &m.files[i];
+        char live[MAX_PATH], dst[MAX_PATH], src[MAX_PATH];
+        struct stat st;
+        snapshot_make_parent(staging, sf->path);
+        snprintf(live, MAX_PATH, "%s/%s", cfg->projects_dir, sf->path);
+        snprintf(dst, MAX_PATH, "%s/%s", staging, sf->path);
+        if (stat(live, &st) == 0 && snapshot_stat_matches(sf, &st) && link(live, dst) == 0) continue;
+        snprintf(src, MAX_PATH, "%s/projects/%s", snap_dir, sf->path);
+        if (copy_file(src, dst) < 0) {
+            print_error("Failed to copy %s: %s\n", src, strerror(errno));
+            ok = 0;
         }
-        sobj->history = NULL;
+        copied++;
     }
+    if (ok && !swap_directories(cfg->projects_dir, staging)) {
+        print_error("Failed to swap in the restored projects: %s\n", strerror(errno));
+        ok = 0;
+    }
+    remove_tree(staging);  // the replaced projects, or the unfinished restore
+    free(m.files);
+    if (!ok) return;
+
+    char config[MAX_PATH], tmp[MAX_PATH];
+    snprintf(config, MAX_PATH, "%s/config", snap_dir);
+    snprintf(tmp, MAX_PATH, "%s/.config.restore", cfg->home_dir);
+    if (access(config, F_OK) == 0 && (copy_file(config, tmp) < 0 || rename(tmp, cfg->config_file) != 0)) {
+        print_error("Failed to restore the config file\n");
+        unlink(tmp);
+    }
+    printf("Restored snapshot '%s' (%d file%s copied); the previous state is snapshot '%s'\n",
+           name, copied, copied == 1 ? "" : "s", saved);
+}
 
-    // Write back
-    if (save_project_file(project_file, proj)) {
-        printf("Merged objects into %s\n", target);
-
-        // Prompt whether to delete source objects
-        printf("Delete source objects? y/N: "); fflush(stdout);
-        char dresp[8];
-        if (fgets(dresp, sizeof(dresp), stdin) && (dresp[0] == 'y' || dresp[0] == 'Y')) {
-            for (int s = 0; s < parts-1; ++s) {
-                Object *sobj = find_object(proj, objs[s]);
-                if (sobj) {
-                    // Remove from linked list
-                    if (proj->objects == sobj) {
-                        proj->objects = sobj->next;
-                    } else {
-                        Object *prev = proj->objects;
-                        while (prev && prev->next != sobj) prev = prev->next;
-                        if (prev) prev->next = sobj->next;
-                    }
-                    // Free object (items/history already moved)
-                    free(sobj);
-                }
-            }
-            // Write again after deletions
-            if (save_project_file(project_file, proj)) {
-                printf("Deleted source objects and updated project file\n");
-            } else {
-                printf("Failed to write project file after deletions\n");
-            }
-        }
+/* funknotes snapshot create|list|restore <name> */
+int snapshot_command(Config *cfg, int argc, char **argv) {
+    if (argc == 3 && strcmp(argv[2], "create") == 0) {
+        snapshot_create(cfg);
+    } else if (argc == 3 && strcmp(argv[2], "list") == 0) {
+        snapshot_list(cfg);
+    } else if (argc == 4 && strcmp(argv[2], "restore") == 0) {
+        snapshot_restore(cfg, argv[3]);
     } else {
-        printf("Failed to write project file\n");
+        print_error("Usage: %s snapshot create|list|restore <name>\n", argv[0]);
     }
+    return g_command_failed;
+}
 
-    free_project(proj);
-    for (int i=0;i<parts;i++) free(objs[i]); free(objs);
+// ===== Tag Queries ===== //
+// tags and show --tag answer from the postings in the header: the objects
+// stay stubs, and only the objects holding a requested tag are loaded to
+// print its items.
+
+/* A project's header for a tag query. Files saved before tag postings are
+ * loaded in full and their postings built (the next save stores them). */
+static Project* load_tag_overview(const char *project_file) {
+    Project *proj = load_project_overview(project_file);
+    if (!proj) return NULL;
+    int stale = 0;
+    for (Object *obj = proj->objects; obj; obj = obj->next) stale |= obj->stub && (!obj->tags || g_cold);
+    if (!stale) return proj;
+    release_project(proj);
+    proj = load_project_shared(project_file);
+    for (Object *obj = proj ? proj->objects : NULL; obj; obj = obj->next) {
+        if (!obj->tags) tags_rebuild(obj);
+    }
+    return proj;
 }
 
-/* Show items of a specific object within a specific project (by name or index) */
-void show_object_in_project(Config *cfg, const char *proj_ident, const char *object_name) {
-    char project_file[MAX_PATH];
-    int proj_idx = -1;
-    if (!get_project_file_by_ident(cfg, proj_ident, project_file, &proj_idx)) {
-        printf("Project '%s' not found\n", proj_ident);
-        return;
+/* The postings of obj that a query matches: "#x" or "@x" exactly, a bare
+ * "x" both. Returns how many were found (at most 2). */
+static int find_tag_postings(Object *obj, const char *query, TagPosting **found) {
+    char tag[MAX_TAG + 2];
+    int n = 0;
+    if (!obj->tags) return 0;
+    if (query[0] == '#' || query[0] == '@') {
+        snprintf(tag, sizeof(tag), "%s", query);
+        for (char *c = tag + 1; *c; c++) *c = (char)tolower((unsigned char)*c);
+        if ((found[n] = tag_posting(obj->tags, tag, 0))) n++;
+        return n;
+    }
+    for (int s = 0; s < 2; s++) {
+        snprintf(tag, sizeof(tag), "%c%s", s ? '@' : '#', query);
+        for (char *c = tag + 1; *c; c++) *c = (char)tolower((unsigned char)*c);
+        if ((found[n] = tag_posting(obj->tags, tag, 0))) n++;
     }
+    return n;
+}
 
-    Project *proj = load_project_file(project_file);
+typedef struct {
+    const char *tag;
+    int count;
+} TagCount;
+
+static int cmp_tag_name(const void *a, const void *b) {
+    return strcmp(((const TagCount *)a)->tag, ((const TagCount *)b)->tag);
+}
+
+static int cmp_tag_count_desc(const void *a, const void *b) {
+    const TagCount *x = a, *y = b;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return strcmp(x->tag, y->tag);
+}
+
+/* funknotes tags [<project>]: every tag in a project with its item count */
+void tags_command(Config *cfg, const char *proj_ident) {
+    char project_file[MAX_PATH];
+    if (!resolve_project_file(cfg, proj_ident, project_file)) return;
+    Project *proj = load_tag_overview(project_file);
     if (!proj) return;
 
-    Object *obj = find_object(proj, object_name);
-    if (!obj) {
-        printf("Object '%s' not found in project '%s'\n", object_name, proj_ident);
-        free_project(proj);
+    int total = 0;
+    for (Object *obj = proj->objects; obj; obj = obj->next) total += obj->tags ? obj->tags->count : 0;
+    if (total == 0) {
+        printf("No tags in project '%s'\n", proj->name);
+        release_project(proj);
+        return;
+    }
+    TagCount *counts = malloc(sizeof(TagCount) * total);
+    if (!counts) {
+        release_project(proj);
         return;
     }
+    int n = 0;
+    for (Object *obj = proj->objects; obj; obj = obj->next) {
+        for (int i = 0; obj->tags && i < obj->tags->count; i++) {
+            counts[n].tag = obj->tags->postings[i].tag;
+            counts[n++].count = obj->tags->postings[i].count;
+        }
+    }
+    // The same tag in several objects: one line with the sum
+    qsort(counts, n, sizeof(TagCount), cmp_tag_name);
+    int merged = 0, width = 0;
+    for (int i = 0; i < n; i++) {
+        if (merged && strcmp(counts[merged - 1].tag, counts[i].tag) == 0) {
+            counts[merged - 1].count += counts[i].count;
+            continue;
+        }
+        counts[merged++] = counts[i];
+        int len = (int)strlen(counts[i].tag);
+        if (len > width) width = len;
+    }
+    qsort(counts, merged, sizeof(TagCount), cmp_tag_count_desc);
 
-    int item_count = count_items(obj);
+    printf("\n=== Tags in '%s' ===\n", proj->name);
+    for (int i = 0; i < merged; i++) {
+        printf("  %-*s  %d item%s\n", width, counts[i].tag, counts[i].count, counts[i].count == 1 ? "" : "s");
+    }
+    free(counts);
+    release_project(proj);
+}
 
-    if (item_count == 0) {
-        printf("\n=== %s/%s (empty) ===\n", proj->name, object_name);
-        free_project(proj);
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Print the items of obj whose ids are listed in the postings, by id */
+static void print_tagged_items(const char *proj_name, Object *obj, TagPosting **found, int nfound) {
+    int count = 0;
+    for (int i = 0; i < nfound; i++) count += found[i]->count;
+    uint32_t *ids = malloc(sizeof(uint32_t) * count);
+    if (!ids) return;
+    count = 0;
+    for (int i = 0; i < nfound; i++) {
+        memcpy(ids + count, found[i]->ids, sizeof(uint32_t) * found[i]->count);
+        count += found[i]->count;
+    }
+    qsort(ids, count, sizeof(uint32_t), cmp_u32);
+
+    printf("\n=== %s/%s ===\n", proj_name, obj->name);
+    int show_ids = g_show_ids;
+    g_show_ids = 1;  // positions are not known without the whole object in order
+    out_begin();
+    for (int i = 0; i < count && out_ok(); i++) {
+        if (i && ids[i] == ids[i - 1]) continue;
+        Item *item = find_item_by_id(obj, ids[i]);
+        if (item) out_item(item, 0);
+    }
+    out_flush();
+    g_show_ids = show_ids;
+    free(ids);
+}
+
+/* show [<project>] [<object>] --tag <tag>: the items carrying a tag. A lone
+ * argument that is not a project is an object in the primary project. */
+void show_tag(Config *cfg, const char *proj_ident, const char *object_name, const char *tag) {
+    char project_file[MAX_PATH];
+    if (proj_ident && !object_name && !get_project_file_by_ident(cfg, proj_ident, project_file, NULL)) {
+        object_name = proj_ident;
+        proj_ident = NULL;
+    }
+    if (!resolve_project_file(cfg, proj_ident, project_file)) return;
+    Project *proj = load_tag_overview(project_file);
+    if (!proj) return;
+    if (object_name && !find_object(proj, object_name)) {
+        print_error("Object '%s' not found\n", object_name);
+        release_project(proj);
         return;
     }
 
-    printf("\n=== %s/%s ===\n", proj->name, object_name);
-    int count;
-    Item **items = get_items_array(obj, &count);
+    int count, shown = 0;
+    Object **objs = objects_in_order(proj, &count);
+    Project *full = NULL;
+    int dir = is_directory(project_file);
     for (int i = 0; i < count; i++) {
-        printf("%d. [%s] %s\n", i + 1, items[i]->timestamp, items[i]->text);
+        TagPosting *found[2];
+        Object *obj = objs[i];
+        if (object_name && strcmp(obj->name, object_name) != 0) continue;
+        int nfound = find_tag_postings(obj, tag, found);
+        if (!nfound) continue;
+        shown++;
+        if (!obj->stub) {
+            print_tagged_items(proj->name, obj, found, nfound);
+        } else if (dir) {
+            // Directory layout: read just this object's file
+            Project *part = load_project_for_object(project_file, obj->name);
+            Object *loaded = part ? find_object(part, obj->name) : NULL;
+            if (loaded) print_tagged_items(proj->name, loaded, found, nfound);
+            free_project(part);
+        } else {
+            if (!full) full = load_project_shared(project_file);
+            Object *loaded = full ? find_object(full, obj->name) : NULL;
+            if (loaded) print_tagged_items(proj->name, loaded, found, nfound);
+        }
     }
-    free(items);
+    if (!shown) printf("No items tagged '%s' in project '%s'\n", tag, proj->name);
+    free(objs);
+    if (full) release_project(full);
+    release_project(proj);
+}
 
-    free_project(proj);
+// ===== Statistics ===== //
+// stats answers from the rollups in the header: the objects stay stubs and
+// no history is walked. Only projects saved before rollups existed are
+// loaded in full and counted (the next save stores their rollups).
+
+/* "Sun 2026-10-18" for a local day number */
+static void format_day(int32_t day, const char *fmt, char *buf, size_t size) {
+    time_t t = (time_t)day * 86400;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(buf, size, fmt, &tm);
 }
 
-/* Show objects of a project or items in an object.
- * If arg is NULL -> show objects in primary project.
- * If arg matches a project (name or index) -> show that project's objects.
- * Otherwise treat arg as an object name in the primary project and show its items.
- */
-void show(Config *cfg, const char *arg) {
-    int primary, counter;
-    load_config_data(cfg, &primary, &counter);
+/* Print one rollup (an object's, or the sum of a project's) with its
+ * buckets ending at r->day */
+static void print_rollup(const Rollup *r, int items, const Timestamp *now) {
+    int32_t today = r->day;
+    Timestamp first = { r->first, now->tz_offset };
+    char since[32];
+    format_day(local_day(&first), "%Y-%m-%d", since, sizeof(since));
+    printf("Items:    %d, average %.0f characters\n", items, items ? (double)r->chars / items : 0.0);
+    if (!r->first) {
+        printf("Changes:  none recorded\n");
+        return;
+    }
+    printf("Changes:  %u added, %u deleted, %u edited since %s\n", r->adds, r->deletes, r->edits, since);
+
+    long recent = 0;
+    for (int i = 0; i < ROLLUP_WEEKS; i++) recent += (long)r->week_adds[i] - r->week_deletes[i];
+    double weeks = (now->epoch - r->first) / (7 * 86400.0);
+    if (weeks < 1) weeks = 1;
+    long net = (long)r->adds - r->deletes;
+    printf("Growth:   %+ld over the last %d weeks (%+.1f/week), %+ld since %s (%+.1f/week)\n",
+           recent, ROLLUP_WEEKS, recent / (double)ROLLUP_WEEKS, net, since, net / weeks);
+
+    printf("\nLast %d days        added  deleted\n", ROLLUP_DAYS);
+    for (int i = 0; i < ROLLUP_DAYS; i++) {
+        char label[32];
+        format_day(today - i, "%a %Y-%m-%d", label, sizeof(label));
+        printf("  %-16s %7u  %7u\n", label, r->day_adds[i], r->day_deletes[i]);
+    }
+    printf("\nLast %d weeks       added  deleted\n", ROLLUP_WEEKS);
+    for (int i = 0; i < ROLLUP_WEEKS; i++) {
+        char label[32];
+        format_day((day_week(today) - i) * 7 - 3, "from %Y-%m-%d", label, sizeof(label));
+        printf("  %-16s %7u  %7u\n", label, r->week_adds[i], r->week_deletes[i]);
+    }
+}
+
+typedef struct {
+    const char *name;
+    uint32_t changes;
+} Activity;
+
+static int cmp_activity_desc(const void *a, const void *b) {
+    const Activity *x = a, *y = b;
+    return x->changes < y->changes ? 1 : x->changes > y->changes ? -1 : strcmp(x->name, y->name);
+}
 
+/* funknotes stats [<project>] [<object>]: item counts, adds and deletes
+ * per day and week, growth and average note length from the rollups; for a
+ * whole project also its most active objects. A lone argument that is not
+ * a project is an object in the primary project. */
+void stats_command(Config *cfg, const char *proj_ident, const char *object_name) {
     char project_file[MAX_PATH];
-    Project *proj = NULL;
+    if (proj_ident && !object_name && !get_project_file_by_ident(cfg, proj_ident, project_file, NULL)) {
+        object_name = proj_ident;
+        proj_ident = NULL;
+    }
+    if (!resolve_project_file(cfg, proj_ident, project_file)) return;
 
-    // If arg provided and matches a project identifier, show that project
-    if (arg && get_project_file_by_ident(cfg, arg, project_file, NULL)) {
+    Project *proj = load_project_overview(project_file);
+    if (!proj) return;
+    Object *only = NULL;
+    if (object_name && !(only = find_object(proj, object_name))) {
+        print_error("Object '%s' not found\n", object_name);
+        release_project(proj);
+        return;
+    }
+    // Files from before rollups: count them from the full project
+    int stale = 0;
+    for (Object *obj = proj->objects; obj; obj = obj->next) {
+        if ((!only || obj == only) && !obj->rollup.valid) stale |= obj->stub;
+    }
+    if (stale) {
+        release_project(proj);
         proj = load_project_file(project_file);
-        if (!proj) {
-            printf("Failed to load project '%s'\n", arg);
-            return;
-        }
+        if (!proj) return;
+        only = object_name ? find_object(proj, object_name) : NULL;
+    }
 
-        if (!proj->objects) {
-            printf("No objects in project '%s'\n", proj->name);
-            free_project(proj);
-            return;
-        }
+    Timestamp now;
+    get_timestamp(&now);
+    int32_t today = local_day(&now);
+    Rollup total;
+    memset(&total, 0, sizeof(total));
+    total.day = today;
+    int items = 0, count = 0;
+    for (Object *obj = proj->objects; obj; obj = obj->next) {
+        if (only && obj != only) continue;
+        if (!obj->rollup.valid) rollup_rebuild(obj);
+        rollup_merge(&total, &obj->rollup);
+        items += (obj->stub ? obj->item_count : count_items(obj)) + obj->cold;  // rollups count cold items too
+        count++;
+    }
 
-        printf("\n=== Objects in '%s' ===\n", proj->name);
-        Object *obj = proj->objects;
-        while (obj) {
-            int item_count = count_items(obj);
-            printf("  • %s (%d items)\n", obj->name, item_count);
-            obj = obj->next;
+    if (only) printf("\n=== Stats for '%s/%s' ===\n", proj->name, only->name);
+    else printf("\n=== Stats for '%s' (%d object%s) ===\n", proj->name, count, count == 1 ? "" : "s");
+    print_rollup(&total, items, &now);
+
+    if (!only && count > 1) {
+        // Most active objects: adds and deletes in the week buckets,
+        // realigned to end at today
+        Activity *act = malloc(sizeof(Activity) * count);
+        if (act) {
+            int n = 0;
+            for (Object *obj = proj->objects; obj; obj = obj->next, n++) {
+                Rollup r;
+                memset(&r, 0, sizeof(r));
+                r.day = today;
+                rollup_merge(&r, &obj->rollup);
+                act[n].name = obj->name;
+                act[n].changes = 0;
+                for (int w = 0; w < ROLLUP_WEEKS; w++) act[n].changes += r.week_adds[w] + r.week_deletes[w];
+            }
+            qsort(act, count, sizeof(Activity), cmp_activity_desc);
+            printf("\nMost active objects (last %d weeks)\n", ROLLUP_WEEKS);
+            for (int i = 0; i < count && i < 5 && act[i].changes; i++) {
+                printf("  %-24s %7u change%s\n", act[i].name, act[i].changes, act[i].changes == 1 ? "" : "s");
+            }
+            free(act);
         }
+    }
+    release_project(proj);
+}
+
+// ===== Integrity Check ===== //
+// fsck reads project files straight into memory and checks every crc= line
+// against the records before it. Records in a damaged (or unchecksummed)
+// run are kept only if they still parse and, for items, still match their
+// stored content hash; those plus every verified run make the salvage.
+
+enum { RUN_VERIFIED, RUN_DAMAGED, RUN_UNCHECKED };
 
-        free_project(proj);
-        return;
+typedef struct {
+    const char *label;      // file name shown in reports
+    const char *buf;
+    size_t len;
+    int declared;           // the header says sections carry checksums
+    int any_checksums;      // some file of the project had crc= lines
+    int report;             // print damaged ranges
+    int collect;            // gather intact records into salvage
+    char name[MAX_TEXT];    // project name from the name= line
+    int verified, damaged, unchecked;
+    long records, unreadable;
+    char *salvage;          // intact records (NULL: not collected)
+    size_t salvage_len, salvage_cap;
+} Fsck;
+
+static void fsck_keep(Fsck *fk, const char *line, size_t len) {
+    if (fk->salvage_len + len + 1 > fk->salvage_cap) {
+        size_t cap = fk->salvage_cap ? fk->salvage_cap * 2 : 1 << 16;
+        while (cap < fk->salvage_len + len + 1) cap *= 2;
+        char *grown = realloc(fk->salvage, cap);
+        if (!grown) return;
+        fk->salvage = grown;
+        fk->salvage_cap = cap;
     }
+    memcpy(fk->salvage + fk->salvage_len, line, len);
+    fk->salvage_len += len;
+    fk->salvage[fk->salvage_len++] = '\n';
+}
 
-    // Otherwise, operate on primary project
-    if (primary < 0) {
-        printf("No primary project set. Use 'funknotes primary <project>' first.\n");
-        return;
+/* Does a record outside any verified run still read as one? */
+static int fsck_record_ok(const char *line, size_t len) {
+    static const char *const keys[] = {
+        "name", "index", "layout", "next_object", "next_id", "checksums", "filter", "objects", "summary",
+        "rollup", "retain", "tags", "tag", "object", "item", "history", "checkpoint", "live", "tombstone", "update", NULL
+    };
+    if (len >= MAX_LINE || memchr(line, '\0', len)) return 0;
+    char rec[MAX_LINE];
+    memcpy(rec, line, len);
+    rec[len] = '\0';
+    if (rec[0] == '[') return strncmp(rec, "[object ", 8) == 0 && rec[len - 1] == ']';
+
+    char *value = strchr(rec, '=');
+    if (!value) return 0;
+    *value++ = '\0';
+    if (!word_in(rec, keys)) return 0;
+    int is_item = !strcmp(rec, "item");
+    if (!is_item && strcmp(rec, "history") && strcmp(rec, "tombstone") && strcmp(rec, "update")) return 1;
+
+    // Timestamped records: <id>|<ts>... for the journal, <ts>...|... otherwise
+    char *pipe = strchr(value, '|');
+    if (!pipe) return 0;
+    *pipe = '\0';
+    Timestamp ts;
+    if (rec[0] == 't' || rec[0] == 'u') {
+        char *end = strchr(pipe + 1, '|');
+        if (end) *end = '\0';
+        else if (rec[0] == 'u') return 0;
+        return parse_timestamp_field(pipe + 1, &ts);
     }
+    if (!parse_timestamp_field(value, &ts)) return 0;
+    if (!is_item) return strchr(pipe + 1, '|') != NULL;
+    char *hash = strchr(value, '#');
+    if (!hash) return 1;
+    char text[MAX_TEXT];
+    read_text_field(pipe, rec + len, text);
+    return strtoull(hash + 1, NULL, 16) == text_hash(text);
+}
 
-    if (!get_project_file(cfg, primary, project_file)) {
-        printf("Primary project not found\n");
-        return;
+/* Settle one run of records [start, end) starting at line first_line */
+static void fsck_run(Fsck *fk, size_t start, size_t end, int first_line, int verdict) {
+    if (verdict == RUN_VERIFIED) fk->verified++;
+    else if (verdict == RUN_UNCHECKED && !fk->declared) fk->unchecked++;  // written before checksums
+    else fk->damaged++;
+    if (verdict == RUN_VERIFIED && !fk->collect) return;
+
+    int line_no = first_line, last_line = first_line;
+    const char *section = NULL;
+    size_t section_len = 0;
+    if (verdict != RUN_VERIFIED && fk->declared && fk->report) {
+        // Which section the run belongs to, and where it ends
+        for (size_t pos = start; pos < end; line_no++) {
+            const char *line = fk->buf + pos;
+            const char *nl = memchr(line, '\n', end - pos);
+            size_t len = nl ? (size_t)(nl - line) : end - pos;
+            pos += len + 1;
+            if (len == 0) continue;
+            last_line = line_no;
+            if (!section && strncmp(line, "[object ", 8) == 0) { section = line; section_len = len; }
+        }
+        printf("  %s: lines %d-%d (bytes %zu-%zu) in %.*s: %s\n", fk->label, first_line, last_line,
+               start, end, section ? (int)section_len : 7, section ? section : "journal",
+               verdict == RUN_DAMAGED ? "checksum mismatch" : "no checksum (cut short?)");
     }
 
-    proj = load_project_file(project_file);
-    if (!proj) return;
-
-    // If no arg provided, show all objects in primary
-    if (!arg) {
-        if (!proj->objects) {
-            printf("No objects in project '%s'\n", proj->name);
-            free_project(proj);
-            return;
+    line_no = first_line;
+    for (size_t pos = start; pos < end; line_no++) {
+        const char *line = fk->buf + pos;
+        const char *nl = memchr(line, '\n', end - pos);
+        size_t len = nl ? (size_t)(nl - line) : end - pos;
+        pos += len + 1;
+        if (len == 0) continue;
+        if (verdict == RUN_VERIFIED || fsck_record_ok(line, len)) {
+            if (fk->collect) fsck_keep(fk, line, len);
+        } else {
+            fk->unreadable++;
+            if (fk->report) printf("  %s: line %d: unreadable record\n", fk->label, line_no);
         }
+    }
+}
 
-        printf("\n=== Objects in '%s' ===\n", proj->name);
-        Object *obj = proj->objects;
-        while (obj) {
-            int item_count = count_items(obj);
-            printf("  • %s (%d items)\n", obj->name, item_count);
-            obj = obj->next;
+/* Check one file held in fk->buf */
+static void fsck_buffer(Fsck *fk) {
+    const char *buf = fk->buf;
+    size_t len = fk->len;
+
+    // Runs are hashed in one go up to the next blank line or boundary
+    size_t pos = 0, run_start = 0, hashed = 0;
+    int line_no = 0, run_line = 0, run_open = 0, in_header = 1, in_journal = 0;
+    uint32_t crc = 0;
+    while (pos < len) {
+        const char *line = buf + pos;
+        const char *nl = memchr(line, '\n', len - pos);
+        size_t line_len = nl ? (size_t)(nl - line) : len - pos;
+        size_t next = nl ? pos + line_len + 1 : len;
+        line_no++;
+        if (line_len == 0) {
+            if (run_open) { crc = crc32c(crc, buf + hashed, pos - hashed); hashed = next; }
+            pos = next;
+            continue;
         }
 
-        free_project(proj);
-        return;
+        if (line_len > 4 && strncmp(line, "crc=", 4) == 0) {
+            fk->any_checksums = 1;
+            if (run_open) {
+                crc = crc32c(crc, buf + hashed, pos - hashed);
+                int match = (uint32_t)strtoul(line + 4, NULL, 16) == crc;
+                fsck_run(fk, run_start, pos, run_line, match ? RUN_VERIFIED : RUN_DAMAGED);
+            }
+            run_open = 0;
+            pos = next;
+            continue;
+        }
+        int journal = line_len > 7 && (strncmp(line, "tombstone=", 10) == 0 || strncmp(line, "update=", 7) == 0);
+        int section = line[0] == '[' && strncmp(line, "[object ", 8) == 0;
+        if (section || (journal && !in_journal)) {
+            if (run_open) fsck_run(fk, run_start, pos, run_line, RUN_UNCHECKED);
+            run_open = 0;
+            in_header = 0;
+        }
+        in_journal = journal;
+
+        if (in_header) {
+            // Header lines carry no checksum; they only have to read back
+            fk->records++;
+            if (line_len > 5 && strncmp(line, "name=", 5) == 0 && !fk->name[0]) {
+                snprintf(fk->name, MAX_TEXT, "%.*s", (int)(line_len - 5), line + 5);
+            } else if (line_len > 10 && strncmp(line, "checksums=", 10) == 0) {
+                fk->declared = fk->any_checksums = 1;
+            }
+            if (fsck_record_ok(line, line_len)) {
+                if (fk->collect) fsck_keep(fk, line, line_len);
+            } else {
+                fk->unreadable++;
+                if (fk->report) printf("  %s: line %d: unreadable record\n", fk->label, line_no);
+            }
+        } else {
+            if (!run_open) {
+                run_open = 1;
+                run_start = hashed = pos;
+                run_line = line_no;
+                crc = 0;
+            }
+            fk->records++;
+        }
+        pos = next;
     }
-
-    // If arg did not match a project, treat it as an object name in primary and show its items
-    Object *obj = find_object(proj, arg);
-    if (!obj) {
-        printf("Object '%s' not found\n", arg);
-        free_project(proj);
-        return;
+    if (run_open) fsck_run(fk, run_start, len, run_line, RUN_UNCHECKED);
+    if (len > 0 && buf[len - 1] != '\n' && fk->report) {
+        printf("  %s: line %d: cut short (no newline at the end)\n", fk->label, line_no);
     }
+}
 
-    int item_count = count_items(obj);
+/* Read and check one file; returns 0 if it could not be read. Plain files
+ * are mapped rather than copied. */
+static int fsck_file(Fsck *fk, const char *path, const char *label) {
+    size_t len = 0;
+    char *buf = NULL, *mapped = NULL;
+    long size = is_compressed_path(path) ? -1 : file_size(path);
+    if (size > 0) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return 0;
+        void *map = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map != MAP_FAILED) {
+            madvise(map, (size_t)size, MADV_SEQUENTIAL);
+            mapped = map;
+            len = (size_t)size;
+        }
+    }
+    if (!mapped) {
+        buf = read_project_bytes(path, &len);
+        if (!buf) return 0;
+    }
+    fk->label = label;
+    fk->buf = mapped ? mapped : buf;
+    fk->len = len;
+    fsck_buffer(fk);
+    if (mapped) munmap(mapped, len);
+    free(buf);
+    fk->buf = NULL;
+    return 1;
+}
 
-    if (item_count == 0) {
-        printf("\n=== %s (empty) ===\n", arg);
-        free_project(proj);
-        return;
+/* Check every file of a project (manifest first in the directory layout) */
+static int fsck_project_files(Fsck *fk, const char *path) {
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    if (!is_directory(path)) return fsck_file(fk, path, base);
+
+    char file[MAX_PATH], label[MAX_PATH];
+    snprintf(file, MAX_PATH, "%s/" MANIFEST_FILE, path);
+    snprintf(label, MAX_PATH, "%s/" MANIFEST_FILE, base);
+    if (!fsck_file(fk, file, label)) return 0;
+    DIR *dir = opendir(path);
+    if (!dir) return 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char *end;
+        strtol(entry->d_name, &end, 10);
+        if (end == entry->d_name || strcmp(end, ".txt") != 0) continue;
+        snprintf(file, MAX_PATH, "%s/%s", path, entry->d_name);
+        snprintf(label, MAX_PATH, "%s/%s", base, entry->d_name);
+        fsck_file(fk, file, label);
     }
+    closedir(dir);
+    return 1;
+}
 
-    printf("\n=== %s ===\n", arg);
+/* Make a salvaged object agree with its own items. An ADD still live in
+ * the history whose item was lost is dropped, and an item whose ADD was lost
+ * gets one. The derived state read from the header (rollup, tag postings,
+ * replay checkpoints) is discarded so the save rebuilds it. */
+static void salvage_reconcile(Object *obj) {
+    HashSet present;
+    memset(&present, 0, sizeof(present));
+    for (Item *item = obj->items; item; item = item->next) hashset_add(&present, item->hash);
+
+    int add_total = 0, live_count;
+    for (HistoryEntry *h = obj->history; h; h = h->next) add_total += history_is_add(h);
+    HistoryEntry **adds;
+    int *live = object_state_at(obj, INT64_MAX, &adds, &live_count);
+    char *orphan = calloc(add_total ? add_total : 1, 1);
+    for (int k = 0; orphan && k < live_count; k++) {
+        uint64_t hash = text_hash(adds[live[k]]->text);
+        if (hashset_contains(&present, hash)) hashset_remove(&present, hash);
+        else orphan[live[k]] = 1;
+    }
+    // The list runs newest first, ADD ordinals oldest first
+    HistoryEntry **link = &obj->history;
+    int ordinal = add_total;
+    while (orphan && *link) {
+        HistoryEntry *h = *link;
+        if (history_is_add(h) && orphan[--ordinal]) {
+            *link = h->next;
+            free(h);
+            continue;
+        }
+        link = &h->next;
+    }
     int count;
     Item **items = get_items_array(obj, &count);
     for (int i = 0; i < count; i++) {
-        printf("%d. [%s] %s\n", i + 1, items[i]->timestamp, items[i]->text);
+        if (!hashset_contains(&present, items[i]->hash)) continue;
+        hashset_remove(&present, items[i]->hash);
+        add_history(obj, "ADD", &items[i]->ts, items[i]->text, items[i]->id);
     }
     free(items);
+    free(orphan);
+    free(live);
+    free(adds);
+    free(present.keys);
+    free(present.counts);
+
+    free_checkpoints(obj->checkpoints);
+    obj->checkpoints = NULL;
+    obj->rollup.valid = 0;
+    tags_rebuild(obj);
+}
 
+/* Write the salvaged records of a damaged project next to it as
+ * <path>.salvaged, through the normal save so its summaries, rollups, tag
+ * postings and filter describe what was kept; returns the number of items
+ * kept, or -1 */
+static int fsck_salvage(Fsck *fk, const char *path, char *out) {
+    FILE *f = fk->salvage ? fmemopen(fk->salvage, fk->salvage_len, "r") : NULL;
+    if (!f) return -1;
+    Project *proj = read_project_stream(f);  // summaries whose section was lost go with it
+    fclose(f);
+    if (!proj) return -1;
+    int items = 0;
+    for (Object *obj = proj->objects; obj; obj = obj->next) {
+        salvage_reconcile(obj);
+        items += count_items(obj);
+    }
+    // Every object is loaded, so the save rebuilds the filter from scratch
+    proj->has_filter = 1;
+
+    snprintf(out, MAX_PATH, "%s.salvaged", path);
+    int ok = save_project_file(out, proj);
     free_project(proj);
+    return ok ? items : -1;
 }
 
-/* Add item to object */
-void add_item(Config *cfg, const char *object_name, const char *text) {
-    int primary, counter;
-    load_config_data(cfg, &primary, &counter);
-    
-    if (primary < 0) {
-        printf("No primary project set. Use 'funknotes primary <project>' first.\n");
-        return;
-    }
-    
-    char project_file[MAX_PATH];
-    if (!get_project_file(cfg, primary, project_file)) {
-        printf("Primary project not found\n");
-        return;
+/* Check one project; returns 1 if it is damaged */
+static int fsck_project(const char *path) {
+    Fsck fk;
+    memset(&fk, 0, sizeof(fk));
+    fk.report = 1;
+    fk.collect = 1;
+
+    if (!fsck_project_files(&fk, path)) {
+        print_error("Failed to read %s\n", path);
+        free(fk.salvage);
+        return 1;
     }
-    
-    Project *proj = load_project_file(project_file);
-    if (!proj) return;
-    
-    Object *obj = find_object(proj, object_name);
-    if (!obj) {
-        // Object missing — prompt the user to create it (default Y)
-        int create = 1; // default yes
-        if (isatty(STDIN_FILENO)) {
-            printf("The object '%s' does not exist, create it? Y/n: ", object_name);
-            fflush(stdout);
-            char resp[8];
-            if (fgets(resp, sizeof(resp), stdin)) {
-                if (resp[0] == 'n' || resp[0] == 'N') create = 0;
-            } else {
-                // EOF on stdin — keep default (create)
-                create = 1;
-            }
-        } else {
-            // Non-interactive: default to creating the object
-            create = 1;
-        }
+    const char *name = fk.name[0] ? fk.name : path;
 
-        if (!create) {
-            printf("Not creating object '%s'. Aborting add.\n", object_name);
-            free_project(proj);
-            return;
+    if (!fk.damaged && !fk.unreadable) {
+        if (fk.any_checksums) {
+            printf("Project '%s': ok, %d checksum%s verified over %ld records\n",
+                   name, fk.verified, fk.verified == 1 ? "" : "s", fk.records);
+        } else {
+            printf("Project '%s': ok, %ld records read back; it has no checksums yet (the next save adds them)\n",
+                   name, fk.records);
         }
+        free(fk.salvage);
+        return 0;
+    }
 
-        // Create the object
-        free_project(proj);
-        add_object(cfg, object_name);
+    print_error("Project '%s': %d damaged range%s, %ld unreadable record%s\n", name,
+                fk.damaged, fk.damaged == 1 ? "" : "s", fk.unreadable, fk.unreadable == 1 ? "" : "s");
+    char out[MAX_PATH];
+    int items = fsck_salvage(&fk, path, out);
+    if (items < 0) print_error("Failed to write salvaged records for '%s'\n", name);
+    else printf("Salvaged %d intact item%s into %s\n", items, items == 1 ? "" : "s", out);
+    free(fk.salvage);
+    return 1;
+}
 
-        // Re-load project file to pick up the newly created object
-        proj = load_project_file(project_file);
-        if (!proj) return;
-        
-        obj = find_object(proj, object_name);
-        if (!obj) {
-            printf("Failed to create object '%s'\n", object_name);
-            free_project(proj);
+/* funknotes fsck [<project>|--all]: verify checksums and record syntax,
+ * report damaged ranges and salvage what is intact */
+void fsck_command(Config *cfg, const char *ident) {
+    if (ident && strcmp(ident, "--all") == 0) {
+        DIR *dir = opendir(cfg->projects_dir);
+        if (!dir) {
+            printf("No projects found\n");
             return;
         }
+        int checked = 0, damaged = 0;
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (!is_project_entry(cfg->projects_dir, entry->d_name)) continue;
+            char path[MAX_PATH];
+            snprintf(path, MAX_PATH, "%s/%s", cfg->projects_dir, entry->d_name);
+            damaged += fsck_project(path);
+            checked++;
+        }
+        closedir(dir);
+        printf("Checked %d project%s, %d damaged\n", checked, checked == 1 ? "" : "s", damaged);
+        return;
     }
-    
-    char timestamp[64];
-    get_timestamp(timestamp, sizeof(timestamp));
-    
-    // Create new item
-    Item *item = calloc(1, sizeof(Item));
-    strncpy(item->timestamp, timestamp, 63);
-    item->timestamp[63] = '\0';
-    strncpy(item->text, text, MAX_TEXT - 1);
-    item->text[MAX_TEXT - 1] = '\0';
-    item->next = obj->items;
-    obj->items = item;
-    
-    // Add history entry
-    HistoryEntry *hist = calloc(1, sizeof(HistoryEntry));
-    strcpy(hist->action, "ADD");
-    strncpy(hist->timestamp, timestamp, 63);
-    hist->timestamp[63] = '\0';
-    strncpy(hist->text, text, MAX_TEXT - 1);
-    hist->text[MAX_TEXT - 1] = '\0';
-    hist->next = obj->history;
-    obj->history = hist;
-    
-    if (save_project_file(project_file, proj)) {
-        printf("Added item to %s\n", object_name);
-    }
-    
-    free_project(proj);
+    char project_file[MAX_PATH];
+    if (!resolve_project_file(cfg, ident, project_file)) return;
+    fsck_project(project_file);
 }
 
-/* Set primary project */
-void set_primary(Config *cfg, const char *ident) {
-    int primary, counter;
-    load_config_data(cfg, &primary, &counter);
-
-    char project_file[MAX_PATH];
-    int proj_idx = -1;
-    if (!get_project_file_by_ident(cfg, ident, project_file, &proj_idx)) {
-        printf("Project '%s' not found\n", ident);
-        return;
+/* funknotes bench checksum [<project>] [runs]: CRC32C throughput of the
+ * hardware and table paths, and fsck's verification rate on a project */
+int bench_checksum(Config *cfg, const char *ident, int runs) {
+    size_t size = 64 << 20;
+    unsigned char *buf = malloc(size);
+    if (!buf) {
+        print_error("Out of memory\n");
+        return 1;
     }
-
-    Project *proj = load_project_file(project_file);
-    if (proj) {
-        printf("Set primary project to '%s'\n", proj->name);
-        free_project(proj);
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < size; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        buf[i] = (unsigned char)(' ' + x % 95);
     }
-
-    save_config_data(cfg, proj_idx, counter);
-}
-
-/* List all projects */
-void list_projects(Config *cfg) {
-    int primary, counter;
-    load_config_data(cfg, &primary, &counter);
-    
-    DIR *dir = opendir(cfg->projects_dir);
-    if (!dir) {
-        printf("No projects found\n");
-        return;
+    crc32c(0, buf, 1);
+    int hw = crc32c_hw;
+    volatile uint32_t sink = 0;  // keeps the timed loops from being optimized away
+    for (int pass = hw ? 0 : 1; pass < 2; pass++) {
+        crc32c_hw = pass == 0;
+        double start = now_seconds();
+        for (int r = 0; r < runs; r++) sink ^= crc32c(0, buf, size);
+        double secs = now_seconds() - start;
+        printf("crc32c %-9s %8.2f GB/s\n", pass == 0 ? "hardware" : "table", (double)size * runs / secs / 1e9);
     }
-    
-    printf("\n=== FunkNotes Projects ===\n");
-    
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL) {
-        if (strstr(entry->d_name, ".txt")) {
-            char path[MAX_PATH];
-            snprintf(path, MAX_PATH, "%s/%s", cfg->projects_dir, entry->d_name);
-            
-            Project *proj = load_project_file(path);
-            if (proj) {
-                printf("  [%d] %s%s\n", proj->index, proj->name, 
-                       proj->index == primary ? " (PRIMARY)" : "");
-                free_project(proj);
-            }
+    crc32c_hw = hw;
+    free(buf);
+
+    if (ident) {
+        char project_file[MAX_PATH];
+        if (!resolve_project_file(cfg, ident, project_file)) return 1;
+        long bytes = project_size(project_file);
+        double start = now_seconds();
+        for (int r = 0; r < runs; r++) {
+            Fsck fk;
+            memset(&fk, 0, sizeof(fk));
+            fsck_project_files(&fk, project_file);
+            sink ^= (uint32_t)fk.verified;
         }
+        double secs = now_seconds() - start;
+        printf("fsck %-11s %8.2f GB/s (%ld bytes, %.3f ms per check)\n", ident,
+               (double)bytes * runs / secs / 1e9, bytes, secs * 1000 / runs);
     }
-    
-    closedir(dir);
+    return 0;
 }
 
 /* Show usage */
@@ -1540,11 +9381,26 @@ void show_usage(const char *prog) {
     printf("\nItem Commands:\n");
     printf("  %s add <object> <text>        Add item to an object\n", prog);
     printf("  %s add <object>               Enter object shell mode for <object>\n", prog);
+    printf("  %s import <object> [file|-]   Add one item per line (single load/save)\n", prog);
+    printf("    add/import/merge accept --dedupe[=skip|count|off] (default: count, i.e. add and report duplicates)\n");
+    printf("  %s dedupe <project> [<object>] Remove duplicate items, keeping the first copy\n", prog);
     printf("\nShow & Search:\n");
     printf("  %s show                       List objects in primary project\n", prog);
     printf("  %s show <project>             List objects in specified project\n", prog);
-    printf("  %s show <project> <object>    Show items in an object\n", prog);
+    printf("  %s show <project> <object>    Show items in an object (--ids: label items #<id>)\n", prog);
     printf("  %s search [<object>] <keywords...>  Search notes (case-insensitive, all keywords must match)\n", prog);
+    printf("  %s search --regex|--fuzzy [<object>] <pattern>  Regex (POSIX extended) or fuzzy subsequence search\n", prog);
+    printf("  %s search --top N [<object>] <keywords...>  Best N matches by relevance (BM25) and recency\n", prog);
+    printf("  %s search --all <keywords...>    Search every project (skips those whose filter rules the query out)\n", prog);
+    printf("    show/search accept --since <time> and --until <time> (YYYY-MM-DD[ HH:MM], @epoch, today, 3d, 12h)\n");
+    printf("    show/search/tags/diff accept --cold to include items 'retain' moved to the cold tier\n");
+    printf("  %s tail [-f] [-n N] [--after #id] [<project>] <object>  Last N items (default 10); -f keeps printing new ones, by #id\n", prog);
+    printf("    show [<project>] <object> -f is the same as tail -f\n");
+    printf("  %s show [<project>] <object> --at <time>  Show an object as it was at <time>\n", prog);
+    printf("  %s show [<project>] [<object>] --tag <tag>  Items carrying #tag or @person (a bare name matches both)\n", prog);
+    printf("  %s tags [<project>]           Tags and @people with their item counts\n", prog);
+    printf("  %s diff <object> <time1> <time2>  Items added/removed between two times\n", prog);
+    printf("  %s stats [<project>] [<object>]  Item counts, adds/deletes per day and week, growth, most active objects\n", prog);
     printf("\nMerge & Delete:\n");
     printf("  %s merge projects <proj1,proj2,...,target>   Merge multiple projects into target\n", prog);
     printf("  %s merge <project> <obj1,obj2,target>       Merge objects within a project\n", prog);
@@ -1552,30 +9408,68 @@ void show_usage(const char *prog) {
     printf("  %s delete projects <proj1,proj2,...>        Delete multiple projects\n", prog);
     printf("  %s delete object <name>                    Delete an object from primary\n", prog);
     printf("  %s delete <object> <index>                  Delete item(s) from object (1-based, supports ranges)\n", prog);
+    printf("  %s delete <object> --match <text>           Delete items containing text (also --regex/--fuzzy <pattern>)\n", prog);
+    printf("  %s delete <object> #<id>                    Delete an item by its stable id (see show --ids)\n", prog);
+    printf("  %s edit <object> #<id> <text>               Replace an item's text\n", prog);
     printf("\nShell & Interactive:\n");
     printf("  %s shell                       Enter interactive shell mode (REPL)\n", prog);
     printf("    In shell/object shell: exit with 'q', 'quit', 'exit', 'drop', or Ctrl+C.\n");
+    printf("    Tab completes commands, projects and objects; press it twice to list the choices.\n");
     printf("    In object shell: type 'delete' to enter delete mode, 'show' to refresh, 'clear' to clear screen.\n");
+    printf("\nDaemon & Maintenance:\n");
+    printf("  %s archive <project>           Compress a project (stays readable and writable)\n", prog);
+    printf("  %s archive --idle <age>        Compress every project untouched for <age> (e.g. 30d)\n", prog);
+    printf("  %s unarchive <project>         Store a project uncompressed again\n", prog);
+    printf("  %s migrate <project> --dir|--file  Switch to one file per object (or back to a single file)\n", prog);
+    printf("  %s batch [file|-] [--yes] [--all-or-nothing]  Run one command per line, writing each project once\n", prog);
+    printf("  %s compact <project>          Fold deleted-item tombstones and edits back into the project\n", prog);
+    printf("  %s retain <object> [<N>|<N>d|off]  Keep only the newest N items (or N days) in the project file; older ones go cold\n", prog);
+    printf("  %s fsck [<project>|--all]     Verify record checksums; damaged projects are salvaged to <file>.salvaged\n", prog);
+    printf("  %s sync <other-home>          Exchange notes added, edited or deleted since the last sync with another funknotes home\n", prog);
+    printf("  %s snapshot create|list|restore <name>  Point-in-time copies of all projects (unchanged files are shared)\n", prog);
+    printf("  %s daemon [start|stop|status]  Run funknotesd (keeps projects resident; commands are forwarded to it)\n", prog);
+    printf("  %s bench daemon [runs] [cmd...] Compare client vs direct latency\n", prog);
+    printf("  %s bench compress [<project>] [runs]  Compression ratio vs save/load time\n", prog);
+    printf("  %s bench output [items]        Listing throughput: printf vs buffered writer (default 1M items)\n", prog);
+    printf("  %s bench parse [<project>] [runs]  Block parser MB/s, records/s, and a save/parse round-trip check\n", prog);
+    printf("  %s bench save [<project>] [runs]  Buffered writer MB/s, records/s, and a save/parse round-trip check\n", prog);
+    printf("  %s bench checksum [<project>] [runs]  CRC32C throughput and fsck verification rate\n", prog);
     printf("\nFor advanced commands and details, see README.md.\n");
 }
 
 int main(int argc, char *argv[]) {
     Config cfg;
     init_config(&cfg);
+
+    // Invoked as funknotesd (e.g. via symlink): run the daemon in the foreground
+    const char *base = strrchr(argv[0], '/');
+    base = base ? base + 1 : argv[0];
+    if (!g_in_daemon && strcmp(base, "funknotesd") == 0) {
+        return run_daemon(&cfg);
+    }
     
     if (argc < 2) {
         show_usage(argv[0]);
         return 1;
     }
 
+    // Hand the command to a running funknotesd; fall back to direct file access
+    int forwarded_code;
+    if (!g_in_daemon && !g_batch_active && daemon_forward(&cfg, argc, argv, &forwarded_code)) {
+        return forwarded_code;
+    }
+    // Held until exit (the daemon, shells and batch let go of it themselves)
+    if (!command_reads_only(argc, argv)) lock_writes(cfg.home_dir, 0);
+    g_cold = extract_cold_flag(&argc, argv);
+
     // === SHELL MODE ===
     if (strcmp(argv[1], "shell") == 0) {
         printf("FunkNotes Shell Mode. Type funknotes commands, exit with 'q', 'quit', 'exit', 'drop', or Ctrl+C.\n\n");
         char line[2048];
+        Completion comp;
+        completion_init(&comp, &cfg, shell_commands, 1);
         while (1) {
-            printf("> ");
-            fflush(stdout);
-            if (!fgets(line, sizeof(line), stdin)) {
+            if (!read_line("> ", line, sizeof(line), &comp)) {
                 printf("\nExiting shell.\n");
                 break;
             }
@@ -1606,7 +9500,10 @@ int main(int argc, char *argv[]) {
             for (int i = 0; i < ac; i++) fake_argv[i+1] = args[i];
             int ret = main(ac+1, fake_argv);
             if (ret != 0) printf("(error code %d)\n", ret);
+            // The command may have added objects or projects, or moved the primary
+            completion_refresh(&comp, &cfg);
         }
+        completion_free(&comp);
         return 0;
     }
 
@@ -1616,12 +9513,12 @@ int main(int argc, char *argv[]) {
         int primary, counter;
         load_config_data(&cfg, &primary, &counter);
         if (primary < 0) {
-            printf("No primary project set. Use 'funknotes primary <project>' first.\n");
+            print_error("No primary project set. Use 'funknotes primary <project>' first.\n");
             return 1;
         }
         char project_file[MAX_PATH];
         if (!get_project_file(&cfg, primary, project_file)) {
-            printf("Primary project not found\n");
+            print_error("Primary project not found\n");
             return 1;
         }
         Project *proj = load_project_file(project_file);
@@ -1643,13 +9540,14 @@ int main(int argc, char *argv[]) {
             free_project(proj);
         }
         // Show items in object
-        show(&cfg, argv[2]);
+        show(&cfg, argv[2], NULL);
         printf("\nEnter text to add to '%s'. Type 'q', 'quit', 'exit', or Ctrl+C to leave.\n", argv[2]);
-        char line[2048];
+        char line[2048], prompt[MAX_TEXT + 16];
+        snprintf(prompt, sizeof(prompt), "%s> ", argv[2]);
+        Completion comp;
+        completion_init(&comp, &cfg, object_shell_commands, 0);
         while (1) {
-            printf("%s> ", argv[2]);
-            fflush(stdout);
-            if (!fgets(line, sizeof(line), stdin)) {
+            if (!read_line(prompt, line, sizeof(line), &comp)) {
                 printf("\nExiting object shell.\n");
                 break;
             }
@@ -1667,17 +9565,18 @@ int main(int argc, char *argv[]) {
                 break;
             }
             if (!strcasecmp(cmd, "show")) {
-                show(&cfg, argv[2]);
+                show(&cfg, argv[2], NULL);
                 continue;
             }
             if (!strcasecmp(cmd, "delete")) {
                 // Enter object delete shell
                 printf("Entering delete mode for '%s'. Type a number or range to delete items, or 'q', 'quit', 'exit', 'drop' to leave.\n", argv[2]);
-                char dline[2048];
+                char dline[2048], dprompt[MAX_TEXT + 16];
+                snprintf(dprompt, sizeof(dprompt), "%s(delete)> ", argv[2]);
+                Completion dcomp;
+                completion_init(&dcomp, &cfg, delete_mode_commands, 0);
                 while (1) {
-                    printf("%s(delete)> ", argv[2]);
-                    fflush(stdout);
-                    if (!fgets(dline, sizeof(dline), stdin)) {
+                    if (!read_line(dprompt, dline, sizeof(dline), &dcomp)) {
                         printf("\nExiting object delete shell.\n");
                         break;
                     }
@@ -1699,16 +9598,18 @@ int main(int argc, char *argv[]) {
                     } else {
                         int idx = atoi(dcmd);
                         if (idx <= 0) {
-                            printf("Invalid item index '%s'\n", dcmd);
+                            print_error("Invalid item index '%s'\n", dcmd);
                         } else {
                             delete_item_from_object(&cfg, argv[2], idx);
                         }
                     }
                 }
+                completion_free(&dcomp);
                 continue;
             }
-            add_item(&cfg, argv[2], cmd);
+            add_item(&cfg, argv[2], cmd, DEDUPE_COUNT);
         }
+        completion_free(&comp);
         return 0;
     }
 
@@ -1719,12 +9620,12 @@ int main(int argc, char *argv[]) {
             int primary, counter;
             load_config_data(&cfg, &primary, &counter);
             if (primary < 0) {
-                printf("No primary project set. Use 'funknotes primary <project>' first.\n");
+                print_error("No primary project set. Use 'funknotes primary <project>' first.\n");
                 return 1;
             }
             char project_file[MAX_PATH];
             if (!get_project_file(&cfg, primary, project_file)) {
-                printf("Primary project not found\n");
+                print_error("Primary project not found\n");
                 return 1;
             }
             Project *proj = load_project_file(project_file);
@@ -1732,21 +9633,16 @@ int main(int argc, char *argv[]) {
             Object *obj = find_object(proj, argv[2]);
             if (obj) {
                 // Object exists, enter shell mode to add items
-                int item_count = count_items(obj);
                 printf("\n=== %s ===\n", argv[2]);
-                int count;
-                Item **items = get_items_array(obj, &count);
-                for (int i = 0; i < count; i++) {
-                    printf("%d. [%s] %s\n", i + 1, items[i]->timestamp, items[i]->text);
-                }
-                free(items);
+                print_items(obj, NULL);
                 free_project(proj);
                 printf("\nEnter text to add to '%s'. Type 'q', 'quit', 'exit', or Ctrl+C to leave.\n", argv[2]);
-                char line[2048];
+                char line[2048], prompt[MAX_TEXT + 16];
+                snprintf(prompt, sizeof(prompt), "%s> ", argv[2]);
+                Completion comp;
+                completion_init(&comp, &cfg, object_shell_commands, 0);
                 while (1) {
-                    printf("%s> ", argv[2]);
-                    fflush(stdout);
-                    if (!fgets(line, sizeof(line), stdin)) {
+                    if (!read_line(prompt, line, sizeof(line), &comp)) {
                         printf("\nExiting object shell.\n");
                         break;
                     }
@@ -1765,8 +9661,9 @@ int main(int argc, char *argv[]) {
                         break;
                     }
                     // Add item to object
-                    add_item(&cfg, argv[2], cmd);
+                    add_item(&cfg, argv[2], cmd, DEDUPE_COUNT);
                 }
+                completion_free(&comp);
                 return 0;
             } else {
                 // Object does not exist, create it
@@ -1778,30 +9675,105 @@ int main(int argc, char *argv[]) {
             new_project(&cfg, argv[3]);
             return 0;
         } else {
-            printf("Usage: funknotes new <object> OR funknotes new project <name>\n");
+            print_error("Usage: funknotes new <object> OR funknotes new project <name>\n");
             return 1;
         }
     }
     else if (strcmp(argv[1], "primary") == 0 && argc == 3) {
         set_primary(&cfg, argv[2]);
     }
+    else if (strcmp(argv[1], "show") == 0 && argc >= 5 && strcmp(argv[argc-2], "--at") == 0) {
+        // show [<project>] <object> --at <time>
+        int64_t at;
+        if (!parse_time_arg(argv[argc-1], 1, &at)) {
+            print_error("Invalid time '%s' (e.g. 2025-01-31, 2025-01-31 14:00, yesterday, 3d, @1700000000)\n", argv[argc-1]);
+            return 1;
+        }
+        if (argc == 5) show_object_at(&cfg, NULL, argv[2], at);
+        else if (argc == 6) show_object_at(&cfg, argv[2], argv[3], at);
+        else show_usage(argv[0]);
+    }
+    else if (strcmp(argv[1], "tail") == 0 ||
+             (strcmp(argv[1], "show") == 0 && (extract_flag(&argc, argv, "-f") | extract_flag(&argc, argv, "--follow")))) {
+        // tail [-f] [-n N] [--after #id] [--ids] [<project>] <object>; show [<project>] <object> -f
+        int follow = strcmp(argv[1], "show") == 0 || extract_flag(&argc, argv, "-f");
+        g_show_ids = extract_flag(&argc, argv, "--ids") || follow;  // followed positions go stale
+        char *count = extract_value(&argc, argv, "-n");
+        char *after_arg = extract_value(&argc, argv, "--after");
+        int last_n = count ? atoi(count) : 10;
+        uint32_t after = 0;
+        if (last_n < 0 || (after_arg && !parse_item_id(after_arg, &after))) {
+            print_error("Invalid %s '%s'\n", after_arg ? "item id" : "count", after_arg ? after_arg : count);
+            return 1;
+        }
+        if (argc == 3) follow_object(&cfg, NULL, argv[2], last_n, after_arg != NULL, after, follow);
+        else if (argc == 4) follow_object(&cfg, argv[2], argv[3], last_n, after_arg != NULL, after, follow);
+        else show_usage(argv[0]);
+    }
+    else if (strcmp(argv[1], "tags") == 0 && argc <= 3) {
+        tags_command(&cfg, argc == 3 ? argv[2] : NULL);
+    }
     else if (strcmp(argv[1], "show") == 0) {
+        g_show_ids = extract_flag(&argc, argv, "--ids");
+        char *tag = extract_value(&argc, argv, "--tag");
+        if (tag) {
+            // show [<project>] [<object>] --tag <tag>
+            if (argc <= 4) show_tag(&cfg, argc >= 3 ? argv[2] : NULL, argc == 4 ? argv[3] : NULL, tag);
+            else show_usage(argv[0]);
+            return 0;
+        }
+        TimeRange range;
+        if (!extract_time_range(&argc, argv, &range)) return 1;
        if (argc == 2) {
-            show(&cfg, NULL);  // Show all objects in primary
+            show(&cfg, NULL, NULL);  // Show all objects in primary
         } else if (argc == 3) {
-            show(&cfg, argv[2]);  // Show objects in project or object in primary
+            show(&cfg, argv[2], &range);  // Show objects in project or object in primary
         } else if (argc == 4) {
             // show <project> <object>
-            show_object_in_project(&cfg, argv[2], argv[3]);
+            show_object_in_project(&cfg, argv[2], argv[3], &range);
         } else {
             show_usage(argv[0]);
         }
     }
+    else if (strcmp(argv[1], "edit") == 0 && argc >= 4) {
+        // edit <object> #id <text...> (or text on stdin)
+        uint32_t id;
+        if (!parse_item_id(argv[3], &id)) {
+            print_error("Invalid item id '%s' (use #<id>, see 'show <object> --ids')\n", argv[3]);
+            return 1;
+        }
+        char *text = argc == 4 ? read_stdin() : NULL;
+        if (!text && argc >= 5) {
+            char text_buf[MAX_TEXT] = "";
+            for (int i = 4; i < argc; i++) {
+                strncat(text_buf, argv[i], sizeof(text_buf) - strlen(text_buf) - 1);
+                if (i < argc - 1) strncat(text_buf, " ", sizeof(text_buf) - strlen(text_buf) - 1);
+            }
+            text = strdup(text_buf);
+        }
+        if (!text) {
+            printf("No text given for item #%u\n", id);
+            return 1;
+        }
+        edit_item_by_id(&cfg, argv[2], id, text);
+        free(text);
+    }
+    else if (strcmp(argv[1], "diff") == 0 && argc == 5) {
+        int64_t t1, t2;
+        if (!parse_time_arg(argv[3], 1, &t1) || !parse_time_arg(argv[4], 1, &t2)) {
+            print_error("Invalid time (e.g. 2025-01-31, 2025-01-31 14:00, yesterday, 3d, @1700000000)\n");
+            return 1;
+        }
+        diff_object(&cfg, argv[2], t1, t2);
+    }
     else if (strcmp(argv[1], "add") == 0 && argc >= 3) {
+        int dedupe;
+        if (!extract_dedupe_policy(&argc, argv, &dedupe)) return 1;
+        if (argc < 3) { show_usage(argv[0]); return 1; }
         char *text = read_stdin();
         if (text) {
             // Text from stdin
-            add_item(&cfg, argv[2], text);
+            add_item(&cfg, argv[2], text, dedupe);
             free(text);
         }
         else if (argc >= 4) {
@@ -1811,19 +9783,19 @@ int main(int argc, char *argv[]) {
                 strcat(text_buf, argv[i]);
                 if (i < argc - 1) strcat(text_buf, " ");
             }
-            add_item(&cfg, argv[2], text_buf);
+            add_item(&cfg, argv[2], text_buf, dedupe);
         }
         else {
             // Enter object shell mode for adding items interactively
             int primary, counter;
             load_config_data(&cfg, &primary, &counter);
             if (primary < 0) {
-                printf("No primary project set. Use 'funknotes primary <project>' first.\n");
+                print_error("No primary project set. Use 'funknotes primary <project>' first.\n");
                 return 1;
             }
             char project_file[MAX_PATH];
             if (!get_project_file(&cfg, primary, project_file)) {
-                printf("Primary project not found\n");
+                print_error("Primary project not found\n");
                 return 1;
             }
             Project *proj = load_project_file(project_file);
@@ -1846,13 +9818,14 @@ int main(int argc, char *argv[]) {
                 free_project(proj);
             }
             // Show items in object
-            show(&cfg, argv[2]);
+            show(&cfg, argv[2], NULL);
             printf("\nEnter text to add to '%s'. Type 'q', 'quit', 'exit', or Ctrl+C to leave.\n", argv[2]);
-            char line[2048];
+            char line[2048], prompt[MAX_TEXT + 16];
+            snprintf(prompt, sizeof(prompt), "%s> ", argv[2]);
+            Completion comp;
+            completion_init(&comp, &cfg, object_shell_commands, 0);
             while (1) {
-                printf("%s> ", argv[2]);
-                fflush(stdout);
-                if (!fgets(line, sizeof(line), stdin)) {
+                if (!read_line(prompt, line, sizeof(line), &comp)) {
                     printf("\nExiting object shell.\n");
                     break;
                 }
@@ -1869,51 +9842,75 @@ int main(int argc, char *argv[]) {
                     printf("Exiting object shell.\n");
                     break;
                 }
-                add_item(&cfg, argv[2], cmd);
+                add_item(&cfg, argv[2], cmd, dedupe);
             }
+            completion_free(&comp);
         }
     }
     else if (strcmp(argv[1], "search") == 0 && argc >= 3) {
-        // Determine whether first token is an object name in the primary project
-        int primary, counter;
-        load_config_data(&cfg, &primary, &counter);
-        if (primary < 0) {
-            printf("No primary project set. Use 'funknotes primary <project>' first.\n");
-        } else {
+        TimeRange range;
+        if (!extract_time_range(&argc, argv, &range)) return 1;
+        int mode = extract_match_mode(&argc, argv);
+        int top;
+        if (!extract_top(&argc, argv, &top)) return 1;
+        int all = extract_flag(&argc, argv, "--all");
+        const char *obj_name = NULL;
+        int kw_start = 2;
+        int ready = all;
+        if (!all) {
+            // Determine whether first token is an object name in the primary project
+            int primary, counter;
+            load_config_data(&cfg, &primary, &counter);
             char project_file[MAX_PATH];
-            if (!get_project_file(&cfg, primary, project_file)) {
-                printf("Primary project not found\n");
+            if (primary < 0) {
+                print_error("No primary project set. Use 'funknotes primary <project>' first.\n");
+            } else if (!get_project_file(&cfg, primary, project_file)) {
+                print_error("Primary project not found\n");
             } else {
-                Project *proj = load_project_file(project_file);
+                Project *proj = load_project_overview(project_file);
                 if (!proj) { show_usage(argv[0]); }
                 else {
-                    const char *maybe_obj = argv[2];
-                    const char *obj_name = NULL;
-                    int kw_start = 2;
-
-                    if (proj) {
-                        Object *tmp = find_object(proj, maybe_obj);
-                        if (tmp) {
-                            // first token is an object name
-                            obj_name = maybe_obj;
-                            kw_start = 3;
-                        }
-                        free_project(proj);
+                    if (find_object(proj, argv[2])) {
+                        // first token is an object name
+                        obj_name = argv[2];
+                        kw_start = 3;
                     }
+                    release_project(proj);
+                    ready = 1;
+                }
+            }
+        }
 
-                    if (kw_start > argc - 1) {
-                        // no keywords provided
-                        show_usage(argv[0]);
-                    } else {
-                        int kwc = argc - kw_start;
-                        char **kws = &argv[kw_start];
-                        search(&cfg, obj_name, kwc, kws);
-                    }
+        if (ready && kw_start > argc - 1) {
+            // no keywords provided
+            show_usage(argv[0]);
+        } else if (ready) {
+            int kwc = argc - kw_start;
+            char **kws = &argv[kw_start];
+            Matcher m;
+            int compiled;
+            if (mode == MATCH_KEYWORDS) {
+                matcher_init_keywords(&m, kwc, kws);
+                compiled = 1;
+            } else {
+                // Regex/fuzzy: remaining words form a single pattern
+                char pattern[MAX_TEXT] = "";
+                for (int i = 0; i < kwc; i++) {
+                    if (i) strncat(pattern, " ", sizeof(pattern) - strlen(pattern) - 1);
+                    strncat(pattern, kws[i], sizeof(pattern) - strlen(pattern) - 1);
                 }
+                compiled = matcher_compile(&m, mode, pattern);
+            }
+            if (compiled) {
+                if (all) search_all(&cfg, &m, &range, top);
+                else search(&cfg, obj_name, &m, &range, top);
+                matcher_free(&m);
             }
         }
     }
     else if (strcmp(argv[1], "merge") == 0) {
+        int dedupe;
+        if (!extract_dedupe_policy(&argc, argv, &dedupe)) return 1;
         // Two modes:
         // 1) funknotes merge proj1,proj2,proj3  (argc==3)
         // 2) funknotes merge <project> <obj1,obj2,target> (argc==4)
@@ -1930,13 +9927,13 @@ int main(int argc, char *argv[]) {
             }
             free(s);
             if (parts >= 2) {
-                merge_projects(&cfg, parts, idents);
+                merge_projects(&cfg, parts, idents, dedupe);
             } else {
                 show_usage(argv[0]);
             }
             for (int i=0;i<parts;i++) free(idents[i]); free(idents);
         } else if (argc == 4) {
-            merge_objects_in_project(&cfg, argv[2], argv[3]);
+            merge_objects_in_project(&cfg, argv[2], argv[3], dedupe);
         } else {
             show_usage(argv[0]);
         }
@@ -1944,9 +9941,35 @@ int main(int argc, char *argv[]) {
     else if (strcmp(argv[1], "projects") == 0) {
         list_projects(&cfg);
     }
+    else if (strcmp(argv[1], "import") == 0) {
+        int dedupe;
+        if (!extract_dedupe_policy(&argc, argv, &dedupe)) return 1;
+        if (argc == 3 || argc == 4) {
+            import_items(&cfg, argv[2], argc == 4 ? argv[3] : "-", dedupe);
+        } else {
+            print_error("Usage: funknotes import <object> [file|-] [--dedupe[=skip|count|off]]\n");
+            return 1;
+        }
+    }
+    else if (strcmp(argv[1], "dedupe") == 0 && (argc == 3 || argc == 4)) {
+        dedupe_project(&cfg, argv[2], argc == 4 ? argv[3] : NULL);
+    }
     else if (strcmp(argv[1], "delete") == 0) {
         // Enhanced: if argc == 3 and argv[2] is not a keyword, prompt for delete mode
-        if (argc == 4) {
+        if (argc == 5 && (strcmp(argv[3], "--match") == 0 || strcmp(argv[3], "--regex") == 0 ||
+                          strcmp(argv[3], "--fuzzy") == 0)) {
+            // delete <object> --match <text> | --regex <pattern> | --fuzzy <pattern>
+            Matcher m;
+            if (strcmp(argv[3], "--match") == 0) {
+                matcher_init_keywords(&m, 1, &argv[4]);
+                m.pattern = strdup(argv[4]);
+                delete_items_matching(&cfg, argv[2], &m);
+                matcher_free(&m);
+            } else if (matcher_compile(&m, strcmp(argv[3], "--regex") == 0 ? MATCH_REGEX : MATCH_FUZZY, argv[4])) {
+                delete_items_matching(&cfg, argv[2], &m);
+                matcher_free(&m);
+            }
+        } else if (argc == 4) {
             if (strcmp(argv[2], "project") == 0) {
                 delete_project(&cfg, argv[3]);
             } else if (strcmp(argv[2], "projects") == 0) {
@@ -1962,13 +9985,17 @@ int main(int argc, char *argv[]) {
                 }
             } else if (strcmp(argv[2], "object") == 0) {
                 delete_object(&cfg, argv[3]);
+            } else if (argv[3][0] == '#') {
+                uint32_t id;
+                if (parse_item_id(argv[3], &id)) delete_item_by_id(&cfg, argv[2], id);
+                else print_error("Invalid item id '%s'\n", argv[3]);
             } else {
                 if (strchr(argv[3], ',') || strchr(argv[3], '-')) {
                     delete_items_from_object(&cfg, argv[2], argv[3]);
                 } else {
                     int idx = atoi(argv[3]);
                     if (idx <= 0) {
-                        printf("Invalid item index '%s'\n", argv[3]);
+                        print_error("Invalid item index '%s'\n", argv[3]);
                     } else {
                         delete_item_from_object(&cfg, argv[2], idx);
                     }
@@ -1991,37 +10018,32 @@ int main(int argc, char *argv[]) {
                 int primary, counter;
                 load_config_data(&cfg, &primary, &counter);
                 if (primary < 0) {
-                    printf("No primary project set. Use 'funknotes primary <project>' first.\n");
+                    print_error("No primary project set. Use 'funknotes primary <project>' first.\n");
                     return 1;
                 }
                 char project_file[MAX_PATH];
                 if (!get_project_file(&cfg, primary, project_file)) {
-                    printf("Primary project not found\n");
+                    print_error("Primary project not found\n");
                     return 1;
                 }
                 Project *proj = load_project_file(project_file);
                 if (!proj) return 1;
                 Object *obj = find_object(proj, argv[2]);
                 if (!obj) {
-                    printf("Object '%s' not found\n", argv[2]);
+                    print_error("Object '%s' not found\n", argv[2]);
                     free_project(proj);
                     return 1;
                 }
-                int item_count = count_items(obj);
                 printf("\n=== %s ===\n", argv[2]);
-                int count;
-                Item **items = get_items_array(obj, &count);
-                for (int i = 0; i < count; i++) {
-                    printf("%d. [%s] %s\n", i + 1, items[i]->timestamp, items[i]->text);
-                }
-                free(items);
+                print_items(obj, NULL);
                 free_project(proj);
                 printf("\nType 'delete <index>' or 'delete <range>' (e.g. 'delete 2', 'delete 2-5'), or 'q', 'quit', 'exit', 'drop' to leave.\n");
-                char line[2048];
+                char line[2048], prompt[MAX_TEXT + 16];
+                snprintf(prompt, sizeof(prompt), "%s(delete)> ", argv[2]);
+                Completion comp;
+                completion_init(&comp, &cfg, delete_shell_commands, 0);
                 while (1) {
-                    printf("%s(delete)> ", argv[2]);
-                    fflush(stdout);
-                    if (!fgets(line, sizeof(line), stdin)) {
+                    if (!read_line(prompt, line, sizeof(line), &comp)) {
                         printf("\nExiting object delete shell.\n");
                         break;
                     }
@@ -2043,7 +10065,7 @@ int main(int argc, char *argv[]) {
                     if (tok && strcasecmp(tok, "delete") == 0) {
                         char *arg = strtok(NULL, " ");
                         if (!arg) {
-                            printf("Usage: delete <index> or delete <range>\n");
+                            print_error("Usage: delete <index> or delete <range>\n");
                             continue;
                         }
                         if (strchr(arg, ',') || strchr(arg, '-')) {
@@ -2051,7 +10073,7 @@ int main(int argc, char *argv[]) {
                         } else {
                             int idx = atoi(arg);
                             if (idx <= 0) {
-                                printf("Invalid item index '%s'\n", arg);
+                                print_error("Invalid item index '%s'\n", arg);
                             } else {
                                 delete_item_from_object(&cfg, argv[2], idx);
                             }
@@ -2063,13 +10085,14 @@ int main(int argc, char *argv[]) {
                         } else {
                             int idx = atoi(tok);
                             if (idx <= 0) {
-                                printf("Invalid item index '%s'\n", tok);
+                                print_error("Invalid item index '%s'\n", tok);
                             } else {
                                 delete_item_from_object(&cfg, argv[2], idx);
                             }
                         }
                     }
                 }
+                completion_free(&comp);
             } else {
                 printf("Aborted.\n");
             }
@@ -2077,6 +10100,52 @@ int main(int argc, char *argv[]) {
             show_usage(argv[0]);
         }
     }
+    else if (strcmp(argv[1], "archive") == 0 && argc == 4 && strcmp(argv[2], "--idle") == 0) {
+        int64_t cutoff;
+        if (!parse_time_arg(argv[3], 0, &cutoff)) {
+            print_error("Invalid age '%s' (e.g. 30d, 12w, 2025-01-01)\n", argv[3]);
+            return 1;
+        }
+        archive_idle_projects(&cfg, cutoff);
+    }
+    else if (strcmp(argv[1], "archive") == 0 && argc == 3) {
+        archive_command(&cfg, argv[2], 1);
+    }
+    else if (strcmp(argv[1], "unarchive") == 0 && argc == 3) {
+        archive_command(&cfg, argv[2], 0);
+    }
+    else if (strcmp(argv[1], "migrate") == 0 && argc == 4 &&
+             (strcmp(argv[3], "--dir") == 0 || strcmp(argv[3], "--file") == 0)) {
+        migrate_project_layout(&cfg, argv[2], strcmp(argv[3], "--dir") == 0);
+    }
+    else if (strcmp(argv[1], "batch") == 0) {
+        return batch_command(&cfg, argv[0], argc, argv);
+    }
+    else if (strcmp(argv[1], "retain") == 0 && (argc == 3 || argc == 4)) {
+        retain_command(&cfg, argv[2], argc == 4 ? argv[3] : NULL);
+    }
+    else if (strcmp(argv[1], "compact") == 0 && argc == 3) {
+        compact_project(&cfg, argv[2]);
+    }
+    else if (strcmp(argv[1], "stats") == 0 && argc <= 4) {
+        stats_command(&cfg, argc >= 3 ? argv[2] : NULL, argc == 4 ? argv[3] : NULL);
+    }
+    else if (strcmp(argv[1], "sync") == 0 && argc == 3) {
+        sync_command(&cfg, argv[2]);
+    }
+    else if (strcmp(argv[1], "snapshot") == 0) {
+        return snapshot_command(&cfg, argc, argv);
+    }
+    else if (strcmp(argv[1], "fsck") == 0 && argc <= 3) {
+        fsck_command(&cfg, argc == 3 ? argv[2] : NULL);
+        return g_command_failed;
+    }
+    else if (strcmp(argv[1], "daemon") == 0) {
+        return daemon_command(&cfg, argc, argv);
+    }
+    else if (strcmp(argv[1], "bench") == 0) {
+        return bench_command(&cfg, argc, argv);
+    }
     else if (strcmp(argv[1], "help") == 0) {
         show_usage(argv[0]);
     }